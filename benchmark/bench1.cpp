@@ -21,8 +21,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <stdlib.h>
 #include <chrono>
+#include <utility>
+#include <vector>
 #include "cpu/ppc/ppcemu.h"
+#include "cpu/ppc/ppcjit.h"
 #include "cpu/ppc/ppcmmu.h"
+#include "cpu/ppc/ppcpredecode.h"
 #include "devices/memctrl/mpc106.h"
 #include <thirdparty/loguru/loguru.hpp>
 
@@ -40,7 +44,7 @@ uint32_t cs_code[] = {
 
 
 int main(int argc, char** argv) {
-    int i;
+    uint32_t i;
 
     /* initialize logging */
     loguru::g_preamble_date    = false;
@@ -64,7 +68,7 @@ int main(int argc, char** argv) {
     ppc_cpu_init(grackle_obj, PPC_VER::MPC750, tbr_freq);
 
     /* load executable code into RAM at address 0 */
-    for (i = 0; i < sizeof(cs_code); i++) {
+    for (i = 0; i < sizeof(cs_code) / sizeof(cs_code[0]); i++) {
         mmu_write_vmem<uint32_t>(i*4, cs_code[i]);
     }
 
@@ -74,6 +78,8 @@ int main(int argc, char** argv) {
         mmu_write_vmem<uint8_t>(0x1000+i, rand() % 256);
     }
 
+    power_on = true;
+
     /* prepare benchmark code execution */
     ppc_state.pc = 0;
     ppc_state.gpr[3] = 0x1000; // buf
@@ -88,24 +94,40 @@ int main(int argc, char** argv) {
     auto start_time   = std::chrono::steady_clock::now();
     auto end_time     = std::chrono::steady_clock::now();
     auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
-    LOG_F(INFO, "Time elapsed (dry run): %lld ns", time_elapsed.count());
+    LOG_F(INFO, "Time elapsed (dry run): %lld ns", (long long)time_elapsed.count());
+
+    std::vector<std::pair<EXEC_MODE, const char*>> exec_modes = {
+        {interpreter, "interpreter"},
+#ifdef PPC_THREADED_INT
+        {threaded_int, "threaded interpreter"},
+#endif
+#ifdef PPC_JIT
+        {jit, "JIT"},
+#endif
+    };
+
+    for (auto& mode : exec_modes) {
+        exec_mode = mode.first;
+
+        LOG_F(INFO, "Execution mode: %s", mode.second);
 
-    for (i = 0; i < 5; i++) {
-        ppc_state.pc = 0;
-        ppc_state.gpr[3] = 0x1000; // buf
-        ppc_state.gpr[4] = 0x8000; // len
-        ppc_state.gpr[5] = 0;      // sum
+        for (i = 0; i < 5; i++) {
+            ppc_state.pc = 0;
+            ppc_state.gpr[3] = 0x1000; // buf
+            ppc_state.gpr[4] = 0x8000; // len
+            ppc_state.gpr[5] = 0;      // sum
 
-        auto start_time = std::chrono::steady_clock::now();
+            auto start_time = std::chrono::steady_clock::now();
 
-        ppc_exec_until(0xC4);
+            ppc_exec_until(0xC4);
 
-        auto end_time = std::chrono::steady_clock::now();
+            auto end_time = std::chrono::steady_clock::now();
 
-        LOG_F(INFO, "Checksum: 0x%08X", ppc_state.gpr[3]);
+            LOG_F(INFO, "Checksum: 0x%08X", ppc_state.gpr[3]);
 
-        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
-        LOG_F(INFO, "Time elapsed (run #%d): %lld ns", i, time_elapsed.count());
+            auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+            LOG_F(INFO, "Time elapsed (run #%u): %lld ns", i, (long long)time_elapsed.count());
+        }
     }
 
     delete(grackle_obj);
@@ -0,0 +1,134 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-21 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Framebuffer conversion benchmark.
+
+    Converts synthetic 1152x870 frames at each pixel depth with every
+    kernel set the host CPU supports and compares their throughput
+    against the scalar reference. The output of each kernel set is
+    checked against the reference as well, including odd row widths.
+ */
+
+#include <stdlib.h>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "devices/video/pixelconv.h"
+#include <thirdparty/loguru/loguru.hpp>
+
+constexpr int frame_width  = 1152;
+constexpr int frame_height = 870;
+constexpr int num_frames   = 20;
+constexpr int num_runs     = 5;
+
+static uint32_t palette[256];
+
+struct Depth {
+    const char*  name;
+    int          bytes_per_pixel;
+    PixelRowConv PixelConv::* kernel;
+};
+
+static const Depth depths[] = {
+    {"8bpp indexed", 1, &PixelConv::indexed_8bpp},
+    {"RGB555",       2, &PixelConv::rgb555},
+    {"RGB555 BE",    2, &PixelConv::rgb555_be},
+    {"RGB565",       2, &PixelConv::rgb565},
+    {"RGB888",       3, &PixelConv::rgb888},
+    {"ARGB8888",     4, &PixelConv::argb8888},
+    {"ARGB8888 BE",  4, &PixelConv::argb8888_be},
+};
+
+static void convert_frame(PixelRowConv kernel, const uint8_t* src, int src_pitch,
+                          uint8_t* dst, int width) {
+    for (int y = 0; y < frame_height; y++)
+        kernel(src + y * src_pitch, dst + y * frame_width * 4, width, palette);
+}
+
+int main(int argc, char** argv) {
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    srand(0xCAFEBABE);
+
+    for (int i = 0; i < 256; i++)
+        palette[i] = 0xFF000000U | (rand() & 0xFFFFFF);
+
+    // rows are padded like a real framebuffer
+    const int src_pitch = frame_width * 4 + 64;
+    std::vector<uint8_t> src(src_pitch * frame_height + 64);
+    for (auto& b : src)
+        b = rand() % 256;
+
+    std::vector<uint8_t> ref(frame_width * 4 * frame_height);
+    std::vector<uint8_t> dst(frame_width * 4 * frame_height);
+
+    std::vector<const PixelConv*> convs = get_supported_pixel_convs();
+
+    for (const Depth& depth : depths) {
+        double scalar_time = 0;
+
+        for (const PixelConv* conv : convs) {
+            PixelRowConv kernel = conv->*depth.kernel;
+            int mismatches = 0;
+
+            // compare against the reference, odd widths exercise the tails
+            for (int width = frame_width - 7; width <= frame_width; width++) {
+                std::memset(ref.data(), 0, ref.size());
+                std::memset(dst.data(), 0, dst.size());
+                convert_frame(pixel_conv_scalar.*depth.kernel, src.data() + 1,
+                              src_pitch, ref.data(), width);
+                convert_frame(kernel, src.data() + 1, src_pitch, dst.data(), width);
+                mismatches += std::memcmp(ref.data(), dst.data(), ref.size()) != 0;
+            }
+
+            double best_time = 1e30;
+
+            for (int i = 0; i < num_runs; i++) {
+                auto start_time = std::chrono::steady_clock::now();
+
+                for (int n = 0; n < num_frames; n++)
+                    convert_frame(kernel, src.data(), src_pitch, dst.data(), frame_width);
+
+                auto end_time     = std::chrono::steady_clock::now();
+                auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+                best_time = std::min(best_time, double(time_elapsed.count()) / num_frames);
+            }
+
+            if (conv == &pixel_conv_scalar)
+                scalar_time = best_time;
+
+            LOG_F(INFO, "%-12s %-6s: %8.1f us/frame, %6.1f Mpixels/s, %5.2fx scalar%s",
+                  depth.name, conv->name, best_time / 1000,
+                  frame_width * frame_height * 1000.0 / best_time,
+                  scalar_time / best_time, mismatches ? ", OUTPUT MISMATCH" : "");
+        }
+    }
+
+    return 0;
+}
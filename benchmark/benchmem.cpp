@@ -0,0 +1,169 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-21 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Guest memory access benchmark.
+
+    Measures the number of loads and stores per second when all accesses
+    hit the primary DTLB, both for direct MMU calls and for guest code.
+ */
+
+#include <stdlib.h>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include "cpu/ppc/ppcemu.h"
+#include "cpu/ppc/ppcjit.h"
+#include "cpu/ppc/ppcmmu.h"
+#include "cpu/ppc/ppcpredecode.h"
+#include "devices/memctrl/mpc106.h"
+#include <thirdparty/loguru/loguru.hpp>
+
+/* sum r4 * 2 words of the 32KB buffer at 0x8000 into r5, wrapping around */
+uint32_t loop_code[] = {
+    0x7C8903A6, // mtctr r4
+    0x80C30000, // lwz   r6,0(r3)
+    0x80E30004, // lwz   r7,4(r3)
+    0x7CA53214, // add   r5,r5,r6
+    0x38630008, // addi  r3,r3,8
+    0x7CA53A14, // add   r5,r5,r7
+    0x70637FF8, // andi. r3,r3,0x7FF8
+    0x60638000, // ori   r3,r3,0x8000
+    0x4200FFE4, // bdnz  0x04
+};
+
+constexpr uint32_t buf_addr  = 0x8000;
+constexpr uint32_t buf_size  = 0x8000;
+constexpr uint32_t num_iters = 1 << 22;
+constexpr int      num_runs  = 5;
+
+static double mega_per_sec(uint64_t count, std::chrono::nanoseconds time_elapsed) {
+    return count * 1000.0 / time_elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t i;
+
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    MPC106* grackle_obj = new MPC106;
+
+    /* we need some RAM */
+    if (!grackle_obj->add_ram_region(0, buf_addr + buf_size)) {
+        LOG_F(ERROR, "Could not create RAM region");
+        delete(grackle_obj);
+        return -1;
+    }
+
+    constexpr uint64_t tbr_freq = 16705000;
+
+    ppc_cpu_init(grackle_obj, PPC_VER::MPC750, tbr_freq);
+
+    /* load executable code into RAM at address 0 */
+    for (i = 0; i < sizeof(loop_code) / sizeof(loop_code[0]); i++) {
+        mmu_write_vmem<uint32_t>(i*4, loop_code[i]);
+    }
+
+    const uint32_t end_addr = sizeof(loop_code);
+
+    srand(0xCAFEBABE);
+
+    for (i = 0; i < buf_size; i++) {
+        mmu_write_vmem<uint8_t>(buf_addr + i, rand() % 256);
+    }
+
+    /* direct MMU calls */
+    for (i = 0; i < num_runs; i++) {
+        uint32_t sum = 0;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (uint32_t n = 0; n < num_iters * 2; n++) {
+            sum += mmu_read_vmem<uint32_t>(buf_addr + ((n << 2) & (buf_size - 4)));
+        }
+
+        auto end_time     = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+        LOG_F(INFO, "Direct loads (run #%u): %.1f M/s, checksum: 0x%08X", i,
+              mega_per_sec(num_iters * 2, time_elapsed), sum);
+    }
+
+    /* guest code */
+    power_on = true;
+
+    std::vector<std::pair<EXEC_MODE, const char*>> exec_modes = {
+        {interpreter, "interpreter"},
+#ifdef PPC_THREADED_INT
+        {threaded_int, "threaded interpreter"},
+#endif
+#ifdef PPC_JIT
+        {jit, "JIT"},
+#endif
+    };
+
+    for (auto& mode : exec_modes) {
+        exec_mode = mode.first;
+
+        LOG_F(INFO, "Execution mode: %s", mode.second);
+
+        for (i = 0; i < num_runs; i++) {
+            ppc_state.pc = 0;
+            ppc_state.gpr[3] = buf_addr;  // buf
+            ppc_state.gpr[4] = num_iters; // count
+            ppc_state.gpr[5] = 0;         // sum
+
+            auto start_time = std::chrono::steady_clock::now();
+
+            ppc_exec_until(end_addr);
+
+            auto end_time     = std::chrono::steady_clock::now();
+            auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+            LOG_F(INFO, "Guest loads (run #%u): %.1f M/s, checksum: 0x%08X", i,
+                  mega_per_sec(num_iters * 2, time_elapsed), ppc_state.gpr[5]);
+        }
+    }
+
+    /* direct MMU calls overwriting the buffer */
+    for (i = 0; i < num_runs; i++) {
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (uint32_t n = 0; n < num_iters * 2; n++) {
+            mmu_write_vmem<uint32_t>(buf_addr + ((n << 2) & (buf_size - 4)), n);
+        }
+
+        auto end_time     = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+        LOG_F(INFO, "Direct stores (run #%u): %.1f M/s", i,
+              mega_per_sec(num_iters * 2, time_elapsed));
+    }
+
+    delete(grackle_obj);
+
+    return 0;
+}
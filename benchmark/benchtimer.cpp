@@ -0,0 +1,126 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-21 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Timer manager benchmark.
+
+    Arms and cancels millions of one-shot timers the way device emulation
+    does, with a few cyclic timers (like video refresh) always pending,
+    and measures the cost of arming timers that expire and fire.
+ */
+
+#include <chrono>
+#include <vector>
+#include "core/timermanager.h"
+#include <thirdparty/loguru/loguru.hpp>
+
+constexpr uint32_t num_iters = 1 << 22;
+constexpr int      num_runs  = 5;
+constexpr int      num_cyclic = 16;
+
+static uint64_t virt_time_ns = 0;
+
+static double ns_per_op(std::chrono::nanoseconds time_elapsed) {
+    return double(time_elapsed.count()) / num_iters;
+}
+
+int main(int argc, char** argv) {
+    int i;
+
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    TimerManager* tm = TimerManager::get_instance();
+
+    tm->set_time_now_cb([]() { return virt_time_ns; });
+    tm->set_notify_changes_cb([]() {});
+
+    uint32_t num_fired = 0;
+
+    // background timers the device timers are sorted against
+    for (i = 0; i < num_cyclic; i++) {
+        tm->add_cyclic_timer(USECS_TO_NSECS(1000 + i * 100), [&num_fired]() { num_fired++; });
+    }
+
+    /* arm a one-shot timer and cancel it before it expires */
+    for (i = 0; i < num_runs; i++) {
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (uint32_t n = 0; n < num_iters; n++) {
+            uint32_t id = tm->add_oneshot_timer(USECS_TO_NSECS(10), [&num_fired]() { num_fired++; });
+            tm->cancel_timer(id);
+        }
+
+        auto end_time     = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+        LOG_F(INFO, "Arm + cancel (run #%d): %.1f ns", i, ns_per_op(time_elapsed));
+    }
+
+    /* keep several timers pending and cancel the oldest one */
+    for (i = 0; i < num_runs; i++) {
+        std::vector<uint32_t> ids(8);
+
+        for (auto& id : ids)
+            id = tm->add_oneshot_timer(USECS_TO_NSECS(10), [&num_fired]() { num_fired++; });
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (uint32_t n = 0; n < num_iters; n++) {
+            tm->cancel_timer(ids[n & 7]);
+            ids[n & 7] = tm->add_oneshot_timer(USECS_TO_NSECS(10 + (n & 15)),
+                                               [&num_fired]() { num_fired++; });
+        }
+
+        auto end_time     = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+        for (auto id : ids)
+            tm->cancel_timer(id);
+
+        LOG_F(INFO, "Rearm with 8 pending (run #%d): %.1f ns", i, ns_per_op(time_elapsed));
+    }
+
+    /* arm a one-shot timer and let it fire */
+    for (i = 0; i < num_runs; i++) {
+        num_fired = 0;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (uint32_t n = 0; n < num_iters; n++) {
+            tm->add_oneshot_timer(10, [&num_fired]() { num_fired++; });
+            virt_time_ns += 10;
+            tm->process_timers();
+        }
+
+        auto end_time     = std::chrono::steady_clock::now();
+        auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+        LOG_F(INFO, "Arm + fire (run #%d): %.1f ns, %u callbacks", i,
+              ns_per_op(time_elapsed), num_fired);
+    }
+
+    return 0;
+}
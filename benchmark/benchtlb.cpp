@@ -0,0 +1,165 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-21 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Primary TLB footprint benchmark.
+
+    Loads one word from each of a growing number of guest pages in
+    pseudo-random order. All accesses hit the primary DTLB, so the
+    slowdown with the number of pages comes from host cache misses
+    on the TLB arrays (and on the touched guest memory itself).
+ */
+
+#include <chrono>
+#include <utility>
+#include <vector>
+#include "cpu/ppc/ppcemu.h"
+#include "cpu/ppc/ppcjit.h"
+#include "cpu/ppc/ppcmmu.h"
+#include "devices/memctrl/mpc106.h"
+#include <thirdparty/loguru/loguru.hpp>
+
+/* visit r4 pages in the order page = (page * 5 + 1) & r9, sum into r5 */
+uint32_t loop_code[] = {
+    0x7C8903A6, // mtctr  r4
+    0x1C630005, // mulli  r3,r3,5
+    0x38630001, // addi   r3,r3,1
+    0x7C634838, // and    r3,r3,r9
+    0x54666026, // rlwinm r6,r3,12,0,19
+    0x50663532, // rlwimi r6,r3,6,20,25 (spread accesses over cache sets)
+    0x7CE6502E, // lwzx   r7,r6,r10
+    0x7CA53A14, // add    r5,r5,r7
+    0x4200FFE4, // bdnz   0x04
+};
+
+constexpr uint32_t buf_addr  = 0x100000;
+constexpr uint32_t max_pages = TLB_SIZE;
+constexpr uint32_t num_iters = 1 << 22;
+constexpr int      num_runs  = 3;
+
+static const uint32_t page_counts[] = {16, 256, 1024, max_pages};
+
+static double ns_per_access(std::chrono::nanoseconds time_elapsed) {
+    return double(time_elapsed.count()) / num_iters;
+}
+
+static inline uint32_t page_ea(uint32_t page) {
+    return buf_addr + (page << PAGE_SIZE_BITS) + ((page & 0x3F) << 6);
+}
+
+int main(int argc, char** argv) {
+    uint32_t i;
+
+    /* initialize logging */
+    loguru::g_preamble_date    = false;
+    loguru::g_preamble_time    = false;
+    loguru::g_preamble_thread  = false;
+
+    loguru::g_stderr_verbosity = 0;
+    loguru::init(argc, argv);
+
+    MPC106* grackle_obj = new MPC106;
+
+    /* code at 0, max_pages of data at buf_addr */
+    if (!grackle_obj->add_ram_region(0, 0x2000000)) {
+        LOG_F(ERROR, "Could not create RAM region");
+        delete(grackle_obj);
+        return -1;
+    }
+
+    constexpr uint64_t tbr_freq = 16705000;
+
+    ppc_cpu_init(grackle_obj, PPC_VER::MPC750, tbr_freq);
+
+    /* load executable code into RAM at address 0 */
+    for (i = 0; i < sizeof(loop_code) / sizeof(loop_code[0]); i++) {
+        mmu_write_vmem<uint32_t>(i*4, loop_code[i]);
+    }
+
+    const uint32_t end_addr = sizeof(loop_code);
+
+    for (uint32_t page = 0; page < max_pages; page++) {
+        mmu_write_vmem<uint32_t>(page_ea(page), page * 0x9E3779B1);
+    }
+
+    /* direct MMU calls */
+    for (uint32_t num_pages : page_counts) {
+        for (i = 0; i < num_runs; i++) {
+            uint32_t sum = 0, page = 0;
+
+            auto start_time = std::chrono::steady_clock::now();
+
+            for (uint32_t n = 0; n < num_iters; n++) {
+                page = (page * 5 + 1) & (num_pages - 1);
+                sum += mmu_read_vmem<uint32_t>(page_ea(page));
+            }
+
+            auto end_time     = std::chrono::steady_clock::now();
+            auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+            LOG_F(INFO, "Direct loads, %4d pages (run #%u): %.2f ns, checksum: 0x%08X",
+                  num_pages, i, ns_per_access(time_elapsed), sum);
+        }
+    }
+
+    /* guest code */
+    power_on = true;
+
+    std::vector<std::pair<EXEC_MODE, const char*>> exec_modes = {
+        {interpreter, "interpreter"},
+#ifdef PPC_THREADED_INT
+        {threaded_int, "threaded interpreter"},
+#endif
+#ifdef PPC_JIT
+        {jit, "JIT"},
+#endif
+    };
+
+    for (auto& mode : exec_modes) {
+        exec_mode = mode.first;
+
+        LOG_F(INFO, "Execution mode: %s", mode.second);
+
+        for (uint32_t num_pages : page_counts) {
+            for (i = 0; i < num_runs; i++) {
+                ppc_state.pc = 0;
+                ppc_state.gpr[3]  = 0;             // page
+                ppc_state.gpr[4]  = num_iters;     // count
+                ppc_state.gpr[5]  = 0;             // sum
+                ppc_state.gpr[9]  = num_pages - 1; // page mask
+                ppc_state.gpr[10] = buf_addr;      // buf
+
+                auto start_time = std::chrono::steady_clock::now();
+
+                ppc_exec_until(end_addr);
+
+                auto end_time     = std::chrono::steady_clock::now();
+                auto time_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+
+                LOG_F(INFO, "Guest loads, %4d pages (run #%u): %.2f ns, checksum: 0x%08X",
+                      num_pages, i, ns_per_access(time_elapsed), ppc_state.gpr[5]);
+            }
+        }
+    }
+
+    delete(grackle_obj);
+
+    return 0;
+}
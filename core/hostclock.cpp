@@ -0,0 +1,124 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <core/hostclock.h>
+#include <core/mathutils.h>
+#include <loguru.hpp>
+
+#include <chrono>
+#include <time.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HOST_CLOCK_TSC
+#endif
+
+#define TSC_CALIBRATION_NS  10000000 // 10 ms
+
+static bool     clock_initialized = false;
+static bool     use_tsc = false;
+static uint64_t tsc_base;
+static uint64_t tsc_ns_base;
+static uint64_t tsc_ns_mult;    // nanoseconds per tick, 32.32 fixed point
+
+static uint64_t sys_clock_ns() {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#ifdef HOST_CLOCK_TSC
+static bool tsc_is_invariant() {
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+}
+
+static bool tsc_calibrate() {
+    using namespace std::chrono;
+
+    auto     start_time = steady_clock::now();
+    uint64_t start_tsc  = __rdtsc();
+    auto     end_time   = start_time;
+    uint64_t end_tsc;
+
+    do {
+        end_time = steady_clock::now();
+        end_tsc  = __rdtsc();
+    } while (end_time - start_time < nanoseconds(TSC_CALIBRATION_NS));
+
+    uint64_t elapsed_ns = duration_cast<nanoseconds>(end_time - start_time).count();
+    uint64_t ticks      = end_tsc - start_tsc;
+
+    // reject anything outside 100 MHz..20 GHz
+    if (ticks < elapsed_ns / 10 || ticks > elapsed_ns * 20)
+        return false;
+
+    tsc_ns_mult = uint64_t((double(elapsed_ns) / double(ticks)) * 4294967296.0);
+    tsc_base    = end_tsc;
+    tsc_ns_base = sys_clock_ns();
+
+    LOG_F(INFO, "Host clock: TSC at %.3f MHz", double(ticks) * 1000.0 / elapsed_ns);
+    return true;
+}
+#endif
+
+void host_clock_init() {
+    if (clock_initialized)
+        return;
+
+#ifdef HOST_CLOCK_TSC
+    use_tsc = tsc_is_invariant() && tsc_calibrate();
+#endif
+
+    clock_initialized = true;
+}
+
+uint64_t host_clock_ns() {
+#ifdef HOST_CLOCK_TSC
+    if (use_tsc) {
+        uint64_t hi, lo;
+        _u64xu64(__rdtsc() - tsc_base, tsc_ns_mult, hi, lo);
+        return tsc_ns_base + ((hi << 32) | (lo >> 32));
+    }
+#endif
+    return sys_clock_ns();
+}
+
+const char* host_clock_name() {
+    if (use_tsc)
+        return "TSC";
+#ifdef CLOCK_MONOTONIC
+    return "CLOCK_MONOTONIC";
+#else
+    return "steady_clock";
+#endif
+}
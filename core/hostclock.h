@@ -0,0 +1,44 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Cheap monotonic host clock.
+
+    Reads the CPU time stamp counter when the host guarantees it to tick
+    at a constant rate, converted to nanoseconds with a factor calibrated
+    against the system clock at startup. Otherwise falls back to
+    CLOCK_MONOTONIC where available, or std::chrono::steady_clock.
+ */
+
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <cinttypes>
+
+// Selects and calibrates the clock source. Safe to call more than once.
+extern void host_clock_init();
+
+// Returns nanoseconds since an arbitrary point in the past.
+extern uint64_t host_clock_ns();
+
+// Returns the name of the selected clock source.
+extern const char* host_clock_name();
+
+#endif // HOST_CLOCK_H
@@ -0,0 +1,120 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/** @file Platform-independent part of the host event manager. */
+
+#include <core/hostevents.h>
+#include <loguru.hpp>
+
+EventManager* EventManager::event_manager;
+
+void EventManager::queue_input(const InputEvent& event)
+{
+    // keep the order of motion and other input
+    this->flush_mouse_motion();
+
+    if (!this->input_queue.push(event))
+        this->dropped_events++;
+}
+
+void EventManager::queue_mouse_motion(int32_t xrel, int32_t yrel)
+{
+    // consecutive motions reach the guest as one
+    if (!this->motion_pending) {
+        this->pending_motion.flags = MOUSE_EVENT_MOTION;
+        this->pending_motion.xrel  = 0;
+        this->pending_motion.yrel  = 0;
+        this->motion_pending = true;
+    }
+    this->pending_motion.xrel += xrel;
+    this->pending_motion.yrel += yrel;
+    this->mouse_motions++;
+}
+
+void EventManager::flush_mouse_motion()
+{
+    if (!this->motion_pending)
+        return;
+
+    InputEvent ie;
+    ie.type  = INPUT_EVENT_MOUSE;
+    ie.mouse = this->pending_motion;
+
+    // set before the push: deliver_input() may take the motion
+    // and clear the flag before push() returns
+    this->motion_queued = true;
+
+    // leave it pending if there's no room, later motion adds to it
+    if (this->input_queue.push(ie))
+        this->motion_pending = false;
+    else
+        this->motion_queued = false;
+}
+
+void EventManager::deliver_input()
+{
+    InputEvent ie;
+
+    while (this->input_queue.pop(ie)) {
+        if (ie.type == INPUT_EVENT_MOUSE) {
+            if (ie.mouse.flags == MOUSE_EVENT_MOTION)
+                this->motion_queued = false;
+            this->_mouse_signal.emit(ie.mouse);
+        } else {
+            this->_keyboard_signal.emit(ie.keyboard);
+        }
+    }
+
+    // perform post-processing
+    this->_post_signal.emit();
+}
+
+void EventManager::call_on_host(const std::function<void()>& func)
+{
+    if (!this->host_loop_on || std::this_thread::get_id() == this->host_thread) {
+        func();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lk(this->host_call_mutex);
+
+    // one call at a time
+    this->host_call_cv.wait(lk, [this]{ return this->host_call == nullptr; });
+
+    HostCall call = {&func, false};
+    this->host_call = &call;
+    this->wake_host_loop();
+
+    this->host_call_cv.wait(lk, [&call]{ return call.done; });
+}
+
+void EventManager::run_host_call()
+{
+    std::lock_guard<std::mutex> lk(this->host_call_mutex);
+
+    if (this->host_call) {
+        (*this->host_call->func)();
+        this->host_call->done = true;
+        this->host_call = nullptr;
+        this->host_call_cv.notify_all();
+    }
+}
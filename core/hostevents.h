@@ -23,8 +23,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define EVENT_MANAGER_H
 
 #include <core/coresignal.h>
+#include <core/mpscqueue.h>
 
+#include <atomic>
 #include <cinttypes>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// capacity of the queue between the host thread and the emulated devices
+#define INPUT_QUEUE_SIZE        256
+
+// longest time the host thread waits for host events
+#define HOST_LOOP_TIMEOUT_MS    10
 
 class WindowEvent {
 public:
@@ -63,6 +75,21 @@ public:
     uint16_t keys_state;
 };
 
+enum : uint32_t {
+    INPUT_EVENT_MOUSE,
+    INPUT_EVENT_KEYBOARD,
+};
+
+class InputEvent {
+public:
+    InputEvent()  = default;
+    ~InputEvent() = default;
+
+    uint32_t        type;
+    MouseEvent      mouse;
+    KeyboardEvent   keyboard;
+};
+
 class EventManager {
 public:
     static EventManager* get_instance() {
@@ -72,8 +99,25 @@ public:
         return event_manager;
     };
 
+    // Pumps host events, host thread only. Window events are handled
+    // right away, input events are queued until deliver_input().
     void poll_events();
 
+    // Hands queued input over to the emulated devices, then runs
+    // the post handlers. Called at the ADB polling rate on the
+    // emulation thread.
+    void deliver_input();
+
+    // Runs emu_func on a new emulation thread. The calling thread becomes
+    // the host thread: it pumps host events and serves call_on_host()
+    // until emu_func returns.
+    void run_host_loop(const std::function<void()>& emu_func);
+
+    // Runs func on the host thread and waits for it to finish.
+    // Runs it in place when called from the host thread or when
+    // no host loop is running.
+    void call_on_host(const std::function<void()>& func);
+
     template <typename T>
     void add_window_handler(T *inst, void (T::*func)(const WindowEvent&)) {
         _window_signal.connect_method(inst, func);
@@ -105,16 +149,41 @@ private:
     static EventManager* event_manager;
     EventManager() {}; // private constructor to implement a singleton
 
+    void queue_input(const InputEvent& event);
+    void queue_mouse_motion(int32_t xrel, int32_t yrel);
+    void flush_mouse_motion();
+    void run_host_call();
+    void wake_host_loop(); // platform-specific
+
     CoreSignal<const WindowEvent&>     _window_signal;
     CoreSignal<const MouseEvent&>      _mouse_signal;
     CoreSignal<const KeyboardEvent&>   _keyboard_signal;
     CoreSignal<>                       _post_signal;
 
+    MpscQueue<InputEvent, INPUT_QUEUE_SIZE> input_queue;
+
+    MouseEvent          pending_motion;         // coalesced mouse motion
+    bool                motion_pending = false;
+    std::atomic<bool>   motion_queued{false};   // devices haven't taken it yet
+
+    typedef struct HostCall {
+        const std::function<void()>* func;
+        bool                         done;
+    } HostCall;
+
+    std::atomic<bool>               host_loop_on{false};
+    std::atomic<bool>               emu_done{false};
+    std::atomic<std::thread::id>    host_thread;
+    std::mutex                      host_call_mutex;
+    std::condition_variable         host_call_cv;
+    HostCall*                       host_call = nullptr; // pending call
+
     uint64_t    events_captured = 0;
     uint64_t    unhandled_events = 0;
     uint64_t    key_downs = 0;
     uint64_t    key_ups = 0;
     uint64_t    mouse_motions = 0;
+    uint64_t    dropped_events = 0;
 };
 
 #endif // EVENT_MANAGER_H
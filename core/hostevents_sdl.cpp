@@ -26,22 +26,66 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <loguru.hpp>
 #include <SDL.h>
 
-EventManager* EventManager::event_manager;
-
 static int get_sdl_event_key_code(const SDL_KeyboardEvent &event);
 static void toggle_mouse_grab(const SDL_KeyboardEvent &event);
 
+// user event type that wakes up the host thread
+static Uint32 host_wake_event = (Uint32)-1;
+
+void EventManager::run_host_loop(const std::function<void()>& emu_func)
+{
+    if (host_wake_event == (Uint32)-1)
+        host_wake_event = SDL_RegisterEvents(1);
+
+    this->host_thread  = std::this_thread::get_id();
+    this->emu_done     = false;
+    this->host_loop_on = true;
+
+    std::thread emu_thread([this, &emu_func]() {
+        emu_func();
+        this->emu_done = true;
+        this->wake_host_loop();
+    });
+
+    while (!this->emu_done) {
+        // sleep until a host event or a call from the emulation thread
+        // arrives, the event stays in the queue for poll_events()
+        SDL_WaitEventTimeout(nullptr, HOST_LOOP_TIMEOUT_MS);
+        this->poll_events();
+        this->run_host_call();
+    }
+
+    emu_thread.join();
+    this->host_loop_on = false;
+
+    if (this->dropped_events)
+        LOG_F(WARNING, "EventManager: %llu input events dropped",
+              (unsigned long long)this->dropped_events);
+}
+
+void EventManager::wake_host_loop()
+{
+    SDL_Event event = {};
+
+    event.type = host_wake_event;
+    SDL_PushEvent(&event);
+}
+
 void EventManager::poll_events()
 {
     SDL_Event event;
 
     while (SDL_PollEvent(&event)) {
+        if (event.type == host_wake_event)
+            continue;
+
         events_captured++;
 
         switch (event.type) {
         case SDL_QUIT:
-            power_on = false;
+            // the CPU thread reads the reason once it sees power_on cleared
             power_off_reason = po_shut_down;
+            power_on.store(false, std::memory_order_release);
             break;
 
         case SDL_WINDOWEVENT: {
@@ -78,35 +122,35 @@ void EventManager::poll_events()
                         ke.flags = SDL_GetModState() & KMOD_CAPS ?
                             KEYBOARD_EVENT_DOWN : KEYBOARD_EVENT_UP;
                     }
-                    this->_keyboard_signal.emit(ke);
+                    InputEvent ie;
+                    ie.type     = INPUT_EVENT_KEYBOARD;
+                    ie.keyboard = ke;
+                    this->queue_input(ie);
                 } else {
                     LOG_F(WARNING, "Unknown key %x pressed", event.key.keysym.sym);
                 }
             }
             break;
 
-        case SDL_MOUSEMOTION: {
-                MouseEvent me;
-                me.xrel  = event.motion.xrel;
-                me.yrel  = event.motion.yrel;
-                me.flags = MOUSE_EVENT_MOTION;
-                this->_mouse_signal.emit(me);
-            }
+        case SDL_MOUSEMOTION:
+            this->queue_mouse_motion(event.motion.xrel, event.motion.yrel);
             break;
 
         case SDL_MOUSEBUTTONDOWN: {
-                MouseEvent me;
-                me.buttons_state = 1;
-                me.flags = MOUSE_EVENT_BUTTON;
-                this->_mouse_signal.emit(me);
+                InputEvent ie;
+                ie.type                = INPUT_EVENT_MOUSE;
+                ie.mouse.buttons_state = 1;
+                ie.mouse.flags         = MOUSE_EVENT_BUTTON;
+                this->queue_input(ie);
             }
             break;
 
         case SDL_MOUSEBUTTONUP: {
-                MouseEvent me;
-                me.buttons_state = 0;
-                me.flags = MOUSE_EVENT_BUTTON;
-                this->_mouse_signal.emit(me);
+                InputEvent ie;
+                ie.type                = INPUT_EVENT_MOUSE;
+                ie.mouse.buttons_state = 0;
+                ie.mouse.flags         = MOUSE_EVENT_BUTTON;
+                this->queue_input(ie);
             }
             break;
 
@@ -115,8 +159,9 @@ void EventManager::poll_events()
         }
     }
 
-    // perform post-processing
-    this->_post_signal.emit();
+    // keep merging motion until the devices took the queued one
+    if (!this->motion_queued)
+        this->flush_mouse_motion();
 }
 
 
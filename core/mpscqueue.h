@@ -0,0 +1,96 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Bounded lock-free multi-producer single-consumer queue.
+
+    Any number of host threads may push, only one thread may pop.
+    Each slot carries a sequence number telling whose turn it is:
+    it's free for the push at position pos when equal to pos and
+    ready for the pop at pos when equal to pos + 1.
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cinttypes>
+#include <utility>
+
+template <typename T, uint32_t N>
+class MpscQueue {
+    static_assert(N && !(N & (N - 1)), "queue size must be a power of two");
+
+public:
+    MpscQueue() {
+        for (uint32_t i = 0; i < N; i++)
+            this->slots[i].seq.store(i, std::memory_order_relaxed);
+    };
+
+    // Returns false if the queue is full. Never blocks.
+    bool push(T item) {
+        uint32_t pos = this->push_pos.load(std::memory_order_relaxed);
+        Slot*    slot;
+
+        // claim a free slot
+        for (;;) {
+            slot = &this->slots[pos % N];
+            int32_t diff = int32_t(slot->seq.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (this->push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = this->push_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->item = std::move(item);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Returns false if the queue is empty. Consumer thread only.
+    bool pop(T& item) {
+        Slot* slot = &this->slots[this->pop_pos % N];
+
+        if (slot->seq.load(std::memory_order_acquire) != this->pop_pos + 1)
+            return false;
+
+        item       = std::move(slot->item);
+        slot->item = T();
+        slot->seq.store(this->pop_pos + N, std::memory_order_release);
+        this->pop_pos++;
+        return true;
+    };
+
+private:
+    typedef struct Slot {
+        std::atomic<uint32_t> seq;
+        T                     item;
+    } Slot;
+
+    Slot                  slots[N];
+    std::atomic<uint32_t> push_pos{0};
+    uint32_t              pop_pos = 0;
+};
+
+#endif // MPSC_QUEUE_H
@@ -30,69 +30,150 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 TimerManager* TimerManager::timer_manager;
 
-uint32_t TimerManager::add_oneshot_timer(uint64_t timeout, timer_cb cb)
+uint32_t TimerManager::add_timer(uint64_t timeout, uint64_t interval, timer_cb cb)
 {
-    TimerInfo* ti = new TimerInfo;
+    uint32_t slot;
+
+    std::lock_guard<std::mutex> lk(this->timer_mtx);
+
+    // reuse the least recently freed slot or grow the pool
+    if (this->free_head != UINT32_MAX) {
+        slot = this->free_head;
+        this->free_head = this->timers[slot].heap_pos;
+        if (this->free_head == UINT32_MAX)
+            this->free_tail = UINT32_MAX;
+    } else if (this->timers.size() <= TIMER_SLOT_MASK) {
+        slot = uint32_t(this->timers.size());
+        this->timers.emplace_back();
+        this->timers[slot].gen = 0;
+    } else if (!this->retired_slots.empty()) {
+        // out of fresh slots, let the generation of a retired one wrap around
+        slot = this->retired_slots.back();
+        this->retired_slots.pop_back();
+    } else {
+        ABORT_F("TimerManager: too many active timers");
+    }
 
-    ti->id          = ++this->id;
-    ti->timeout_ns  = this->get_time_now() + timeout;
-    ti->interval_ns = 0;
-    ti->cb          = cb;
+    TimerInfo& ti = this->timers[slot];
 
-    std::shared_ptr<TimerInfo> timer_desc(ti);
+    ti.gen         = ti.gen % TIMER_GEN_MAX + 1;
+    ti.id          = (ti.gen << TIMER_SLOT_BITS) | slot;
+    ti.interval_ns = interval;
+    ti.cb          = std::move(cb);
 
-    // add new timer to the timer queue
-    this->timer_queue.push(timer_desc);
+    // add new timer to the timer heap
+    this->timer_heap.push_back({timeout, slot});
+    this->sift_up(uint32_t(this->timer_heap.size() - 1));
 
-    // notify listeners about changes in the timer queue
-    if (!this->cb_active) {
-        this->notify_timer_changes();
+    return ti.id;
+}
+
+void TimerManager::free_timer(uint32_t slot)
+{
+    TimerInfo& ti = this->timers[slot];
+
+    ti.id       = 0;
+    ti.cb       = nullptr;
+    ti.heap_pos = UINT32_MAX;
+
+    // the next generation would match stale IDs of this slot's first timer
+    if (ti.gen == TIMER_GEN_MAX) {
+        this->retired_slots.push_back(slot);
+        return;
     }
 
-    return ti->id;
+    if (this->free_tail != UINT32_MAX)
+        this->timers[this->free_tail].heap_pos = slot;
+    else
+        this->free_head = slot;
+    this->free_tail = slot;
 }
 
-uint32_t TimerManager::add_immediate_timer(timer_cb cb) {
-    TimerInfo* ti = new TimerInfo;
+void TimerManager::heap_remove(uint32_t pos)
+{
+    TimerHeapEntry last = this->timer_heap.back();
+    this->timer_heap.pop_back();
+
+    if (pos < this->timer_heap.size()) {
+        this->timer_heap[pos] = last;
+        this->sift_up(pos);
+        this->sift_down(this->timers[last.slot].heap_pos);
+    }
+}
+
+void TimerManager::sift_up(uint32_t pos)
+{
+    TimerHeapEntry entry = this->timer_heap[pos];
+
+    while (pos) {
+        uint32_t parent = (pos - 1) >> 1;
+        if (this->timer_heap[parent].timeout_ns <= entry.timeout_ns)
+            break;
+        this->timer_heap[pos] = this->timer_heap[parent];
+        this->timers[this->timer_heap[pos].slot].heap_pos = pos;
+        pos = parent;
+    }
 
-    ti->id          = ++this->id;
-    ti->timeout_ns  = this->get_time_now();
-    ti->interval_ns = 0;
-    ti->cb          = cb;
+    this->timer_heap[pos] = entry;
+    this->timers[entry.slot].heap_pos = pos;
+}
 
-    std::shared_ptr<TimerInfo> timer_desc(ti);
+void TimerManager::sift_down(uint32_t pos)
+{
+    uint32_t       size  = uint32_t(this->timer_heap.size());
+    TimerHeapEntry entry = this->timer_heap[pos];
+
+    for (;;) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size &&
+            this->timer_heap[child + 1].timeout_ns < this->timer_heap[child].timeout_ns)
+            child++;
+        if (entry.timeout_ns <= this->timer_heap[child].timeout_ns)
+            break;
+        this->timer_heap[pos] = this->timer_heap[child];
+        this->timers[this->timer_heap[pos].slot].heap_pos = pos;
+        pos = child;
+    }
 
-    // add new timer to the timer queue
-    this->timer_queue.push(timer_desc);
+    this->timer_heap[pos] = entry;
+    this->timers[entry.slot].heap_pos = pos;
+}
+
+uint32_t TimerManager::add_oneshot_timer(uint64_t timeout, timer_cb cb)
+{
+    uint32_t id = this->add_timer(this->get_time_now() + timeout, 0, std::move(cb));
 
     // notify listeners about changes in the timer queue
     if (!this->cb_active) {
         this->notify_timer_changes();
     }
 
-    return ti->id;
+    return id;
 }
 
-uint32_t TimerManager::add_cyclic_timer(uint64_t interval, uint64_t delay, timer_cb cb)
-{
-    TimerInfo* ti = new TimerInfo;
+uint32_t TimerManager::add_immediate_timer(timer_cb cb) {
+    uint32_t id = this->add_timer(this->get_time_now(), 0, std::move(cb));
 
-    ti->id          = ++this->id;
-    ti->timeout_ns  = this->get_time_now() + delay;
-    ti->interval_ns = interval;
-    ti->cb          = cb;
+    // notify listeners about changes in the timer queue
+    if (!this->cb_active) {
+        this->notify_timer_changes();
+    }
 
-    std::shared_ptr<TimerInfo> timer_desc(ti);
+    return id;
+}
 
-    // add new timer to the timer queue
-    this->timer_queue.push(timer_desc);
+uint32_t TimerManager::add_cyclic_timer(uint64_t interval, uint64_t delay, timer_cb cb)
+{
+    uint32_t id = this->add_timer(this->get_time_now() + delay, interval, std::move(cb));
 
     // notify listeners about changes in the timer queue
     if (!this->cb_active) {
         this->notify_timer_changes();
     }
 
-    return ti->id;
+    return id;
 }
 
 uint32_t TimerManager::add_cyclic_timer(uint64_t interval, timer_cb cb) {
@@ -101,40 +182,89 @@ uint32_t TimerManager::add_cyclic_timer(uint64_t interval, timer_cb cb) {
 
 void TimerManager::cancel_timer(uint32_t id)
 {
-    this->timer_queue.remove_by_id(id);
+{ // [ mtx scope
+    std::lock_guard<std::mutex> lk(this->timer_mtx);
+
+    uint32_t slot = id & TIMER_SLOT_MASK;
+
+    // ignore IDs of timers that already expired or were cancelled
+    if (!id || slot >= this->timers.size() || this->timers[slot].id != id)
+        return;
+
+    this->heap_remove(this->timers[slot].heap_pos);
+    this->free_timer(slot);
+} // ] mtx scope
+
     if (!this->cb_active) {
         this->notify_timer_changes();
     }
 }
 
+bool TimerManager::post_event(timer_cb cb)
+{
+    if (!this->posted_events.push(std::move(cb)))
+        return false;
+
+    if (this->notify_posted)
+        this->notify_posted();
+
+    return true;
+}
+
+void TimerManager::process_posted_events()
+{
+    timer_cb cb;
+
+    while (this->posted_events.pop(cb)) {
+        this->cb_active = true;
+        cb();
+        this->cb_active = false;
+    }
+}
+
+void TimerManager::discard_posted_events()
+{
+    timer_cb cb;
+
+    while (this->posted_events.pop(cb)) {
+    }
+}
+
 uint64_t TimerManager::process_timers()
 {
-    std::shared_ptr<TimerInfo> cur_timer;
+    this->timer_thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+    this->process_posted_events();
+
     uint64_t time_now = get_time_now();
+    timer_cb cb;
 
-{ // mtx scope
-    std::lock_guard<std::recursive_mutex> lk(this->timer_queue.get_mtx());
-    if (this->timer_queue.empty()) {
-        return 0ULL;
-    }
+    std::unique_lock<std::mutex> lk(this->timer_mtx);
 
     // scan for expired timers
-    cur_timer = this->timer_queue.top();
-} // ] mtx scope
-    while (cur_timer->timeout_ns <= time_now) {
-        timer_cb cb = cur_timer->cb;
-
-        // re-arm cyclic timers
-        if (cur_timer->interval_ns) {
-            std::lock_guard<std::recursive_mutex> lk(this->timer_queue.get_mtx());
-            cur_timer->timeout_ns = time_now + cur_timer->interval_ns;
-            this->timer_queue.remove_by_id(cur_timer->id);
-            this->timer_queue.push(cur_timer);
+    while (!this->timer_heap.empty()) {
+        if (this->timer_heap[0].timeout_ns > time_now) {
+            // return time slice in nanoseconds until next timer's expiry
+            return this->timer_heap[0].timeout_ns - time_now;
+        }
+
+        uint32_t   slot      = this->timer_heap[0].slot;
+        TimerInfo& cur_timer = this->timers[slot];
+
+        if (cur_timer.interval_ns) {
+            // re-arm cyclic timers
+            cb = cur_timer.cb;
+            this->timer_heap[0].timeout_ns = time_now + cur_timer.interval_ns;
+            this->sift_down(0);
         } else {
             // remove one-shot timers from queue
-            this->timer_queue.pop();
+            cb = std::move(cur_timer.cb);
+            this->heap_remove(0);
+            this->free_timer(slot);
         }
 
+        lk.unlock();
+
         this->cb_active = true;
 
         // invoke timer callback
@@ -142,17 +272,8 @@ uint64_t TimerManager::process_timers()
 
         this->cb_active = false;
 
-        // process next timer
-{ // [ mtx scope
-        std::lock_guard<std::recursive_mutex> lk(this->timer_queue.get_mtx());
-        if (this->timer_queue.empty()) {
-            return 0ULL;
-        }
-
-        cur_timer = this->timer_queue.top();
-} // ] mtx scope
+        lk.lock();
     }
 
-    // return time slice in nanoseconds until next timer's expiry
-    return cur_timer->timeout_ns - time_now;
+    return 0ULL;
 }
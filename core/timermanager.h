@@ -22,12 +22,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef TIMER_MANAGER_H
 #define TIMER_MANAGER_H
 
+#include <core/mpscqueue.h>
+
 #include <atomic>
 #include <algorithm>
 #include <cinttypes>
 #include <functional>
 #include <memory>
 #include <queue>
+#include <thread>
 #include <vector>
 #include <mutex>
 
@@ -44,68 +47,29 @@ using namespace std;
 
 typedef function<void()> timer_cb;
 
-/** Extend std::priority_queue as suggested here:
-    https://stackoverflow.com/a/36711682
-    to be able to remove arbitrary elements.
- */
-template <typename T, class Container = std::vector<T>, class Compare = std::less<typename Container::value_type>>
-class my_priority_queue : public std::priority_queue<T, Container, Compare> {
-public:
-    bool remove_by_id(const uint32_t id){
-        std::lock_guard<std::recursive_mutex> lk(mtx);
-        auto el = this->top();
-        if (el->id == id) {
-            std::priority_queue<T, Container, Compare>::pop();
-            return true;
-        }
-        auto it = std::find_if(
-            this->c.begin(), this->c.end(), [id](const T& el) { return el->id == id; });
-        if (it != this->c.end()) {
-            this->c.erase(it);
-            std::make_heap(this->c.begin(), this->c.end(), this->comp);
-            return true;
-        }
-        return false;
-    };
-
-    void push(T val)
-    {
-        std::lock_guard<std::recursive_mutex> lk(mtx);
-        std::priority_queue<T, Container, Compare>::push(val);
-    };
+/** Timer IDs hold the index of the timer slot in their lower bits and
+    the slot's generation, bumped on each reuse, in the upper bits.
+    This makes cancelling by ID a direct lookup that ignores stale IDs.
 
-    T pop()
-    {
-        std::lock_guard<std::recursive_mutex> lk(mtx);
-        T val = std::priority_queue<T, Container, Compare>::top();
-        std::priority_queue<T, Container, Compare>::pop();
-        return val;
-    };
+    A slot whose generation reaches TIMER_GEN_MAX is retired instead of
+    wrapping around. Retired slots are only taken again once the pool can't
+    grow anymore, i.e. after about 2^32 timers have been created.
+ */
+#define TIMER_SLOT_BITS 14
+#define TIMER_SLOT_MASK ((1U << TIMER_SLOT_BITS) - 1)
+#define TIMER_GEN_MAX   ((1U << (32 - TIMER_SLOT_BITS)) - 1)
 
-    std::recursive_mutex& get_mtx()
-    {
-        return mtx;
-    }
-
-private:
-    std::recursive_mutex mtx;
-};
+// capacity of the queue for callbacks posted by other host threads
+#define POSTED_EVENTS_SIZE 256
 
 typedef struct TimerInfo {
-    uint32_t id;
-    uint64_t timeout_ns;  // timer expiry
+    uint32_t id;          // 0 for free slots
+    uint32_t gen;         // bumped on each reuse of the slot
+    uint32_t heap_pos;    // position in the timer heap, next free slot if free
     uint64_t interval_ns; // 0 for one-shot timers
     timer_cb cb;          // timer callback
 } TimerInfo;
 
-// Custom comparator for sorting our timer queue in ascending order
-class MyGtComparator {
-public:
-    bool operator()(const shared_ptr<TimerInfo>& l, const shared_ptr<TimerInfo>& r) {
-        return l.get()->timeout_ns > r.get()->timeout_ns;
-    }
-};
-
 class TimerManager {
 public:
     static TimerManager* get_instance() {
@@ -125,6 +89,11 @@ public:
         this->notify_timer_changes = cb;
     };
 
+    // callback for acknowledging posted events, called from the posting thread
+    void set_notify_posted_cb(const timer_cb &cb) {
+        this->notify_posted = cb;
+    };
+
     // return current virtual time in nanoseconds
     uint64_t current_time_ns() { return get_time_now(); };
 
@@ -135,20 +104,57 @@ public:
     uint32_t add_cyclic_timer(uint64_t interval, uint64_t delay, timer_cb cb);
     void cancel_timer(uint32_t id);
 
+    // Queue a callback to run on the emulation thread at its next event
+    // check. Meant for other host threads (audio, input), never blocks.
+    // Returns false if the queue is full.
+    bool post_event(timer_cb cb);
+
+    // Drop posted callbacks without running them.
+    void discard_posted_events();
+
+    // true if called on the thread that processes timers and posted events
+    bool on_timer_thread() {
+        return std::this_thread::get_id() == this->timer_thread.load(std::memory_order_relaxed);
+    };
+
     uint64_t process_timers();
 
 private:
     static TimerManager* timer_manager;
     TimerManager(){}; // private constructor to implement a singleton
 
-    // timer queue
-    my_priority_queue<shared_ptr<TimerInfo>, vector<shared_ptr<TimerInfo>>, MyGtComparator> timer_queue;
+    uint32_t add_timer(uint64_t timeout, uint64_t interval, timer_cb cb);
+    void     free_timer(uint32_t slot);
+    void     heap_remove(uint32_t pos);
+    void     sift_up(uint32_t pos);
+    void     sift_down(uint32_t pos);
+
+    typedef struct TimerHeapEntry {
+        uint64_t timeout_ns;
+        uint32_t slot;
+    } TimerHeapEntry;
+
+    // Timer slots are pooled and reused in FIFO order to spread generation
+    // bumps over all slots.
+    std::vector<TimerInfo>      timers;
+    uint32_t                    free_head = UINT32_MAX;
+    uint32_t                    free_tail = UINT32_MAX;
+    std::vector<uint32_t>       retired_slots;
+
+    // binary min-heap ordered by expiry
+    std::vector<TimerHeapEntry> timer_heap;
+    std::mutex                  timer_mtx;
+
+    void process_posted_events();
+
+    MpscQueue<timer_cb, POSTED_EVENTS_SIZE> posted_events;
+    std::atomic<std::thread::id>            timer_thread;
 
     function<uint64_t()>   get_time_now;
     function<void()>       notify_timer_changes;
+    function<void()>       notify_posted;
 
-    std::atomic<uint32_t> id{0};
-    bool        cb_active = false; // true if a timer callback is executing // FIXME: Do we need this? It gets written in main thread and read in audio thread.
+    bool        cb_active = false; // true if a timer callback is executing
 };
 
 #endif // TIMER_MANAGER_H
@@ -180,6 +180,8 @@ void dppc_interpreter::power_lscbx() {
 
     while (bytes_to_load > 0) {
         return_value = mmu_read_vmem<uint8_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
 
         ppc_result_d = (ppc_result_d & ~bitmask) | (return_value << shift_amount);
         if (!shift_amount) {
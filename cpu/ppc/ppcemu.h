@@ -31,12 +31,22 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <functional>
 #include <setjmp.h>
 #include <string>
+#include <vector>
 
 // Uncomment this to have a more graceful approach to illegal opcodes
 //#define ILLEGAL_OP_SAFE 1
 
 //#define CPU_PROFILING // enable CPU profiling
 
+// Comment this out to leave faulting instructions via longjmp()
+#define PPC_EXC_RETURN
+
+// Comment this out to execute guest idle loops instruction by instruction
+#define PPC_IDLE_SKIP
+
+// Default max virtual time between two event checks in adaptive mode
+#define PPC_DEF_MAX_LATENCY_NS  1000000 // 1 ms
+
 /** type of compiler used during execution */
 enum EXEC_MODE:uint32_t {
     interpreter     = 0,
@@ -184,6 +194,7 @@ enum {
     EXEF_BRANCH    = 1 << 0,
     EXEF_EXCEPTION = 1 << 1,
     EXEF_RFI       = 1 << 2,
+    EXEF_ABORT     = 1 << 3, // the current instruction raised an exception
 };
 
 enum CR_select : int32_t {
@@ -260,6 +271,13 @@ enum MSR : int {
     POW = 0x40000
 };
 
+/** HID0 power management bits of the 603 and 750. */
+enum HID0_PM : uint32_t {
+    HID0_SLEEP = 1UL << 21,
+    HID0_NAP   = 1UL << 22,
+    HID0_DOZE  = 1UL << 23,
+};
+
 enum XER : uint32_t {
     CA = 1UL << 29,
     OV = 1UL << 30,
@@ -302,6 +320,17 @@ extern unsigned exec_flags;
 
 extern jmp_buf exc_env;
 
+/** Tell if the current instruction has raised a synchronous exception.
+    With PPC_EXC_RETURN, the exception handler returns to the instruction
+    that has to return immediately without changing any further state. */
+inline bool ppc_exc_aborted() {
+#ifdef PPC_EXC_RETURN
+    return exec_flags & EXEF_ABORT;
+#else
+    return false;
+#endif
+}
+
 extern bool grab_return;
 
 enum Po_Cause : int {
@@ -318,7 +347,8 @@ enum Po_Cause : int {
     po_signal_interrupt,
 };
 
-extern bool power_on;
+extern std::atomic<bool> power_on;
+extern EXEC_MODE exec_mode;
 extern Po_Cause power_off_reason;
 extern bool int_pin;
 extern bool dec_exception_pending;
@@ -643,17 +673,39 @@ template <field_rc rec> extern void power_srq();
 
 // G5+ instructions
 
+extern uint64_t g_icycles;
+extern std::atomic<bool> exec_timer;
+extern bool g_realtime;
+extern bool g_adaptive;             // scale virtual time to the host speed
+extern uint64_t g_max_latency_ns;   // max virtual time between event checks
+                                    // in adaptive mode
+
 extern uint64_t get_virt_time_ns(void);
+extern uint64_t process_events(void);
+
+/* Let time pass until the next timer event is due. In realtime mode,
+   the host thread sleeps until then or until the timer queue changes.
+   Otherwise, virtual time jumps forward immediately. */
+extern void ppc_idle_wait(void);
+
+/* Stop instruction fetching while MSR[POW] requests a power saving mode.
+   Returns after an interrupt has cleared MSR[POW] or power has been turned off. */
+extern void ppc_power_save(void);
 
 extern void ppc_main_opcode(void);
 extern void ppc_exec(void);
 extern void ppc_exec_single(void);
 extern void ppc_exec_until(uint32_t goal_addr);
 extern void ppc_exec_dbg(uint32_t start_addr, uint32_t size);
+extern bool ppc_exec_until_bp(void); /* returns true if a breakpoint was hit */
 
 /* debugging support API */
 void print_fprs(void);                   /* print content of the floating-point registers  */
 uint64_t get_reg(std::string reg_name); /* get content of the register reg_name */
 void set_reg(std::string reg_name, uint64_t val); /* set reg_name to val */
+void ppc_set_breakpoint(uint32_t addr);   /* stop execution at effective address addr */
+bool ppc_clear_breakpoint(uint32_t addr); /* returns false if there was no breakpoint */
+void ppc_clear_breakpoints(void);
+std::vector<uint32_t> ppc_get_breakpoints(void);
 
 #endif /* PPCEMU_H */
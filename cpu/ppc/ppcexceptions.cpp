@@ -132,7 +132,11 @@ void ppc_exception_handler(Except_Type exception_type, uint32_t srr1_bits) {
     mmu_change_mode();
 
     if (exception_type != Except_Type::EXC_EXT_INT && exception_type != Except_Type::EXC_DECR) {
+#ifdef PPC_EXC_RETURN
+        exec_flags |= EXEF_ABORT; /* leave the faulting instruction */
+#else
         longjmp(exc_env, 2); /* return to the main execution loop. */
+#endif
     }
 }
 
@@ -19,19 +19,29 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <core/hostclock.h>
 #include <core/timermanager.h>
 #include <loguru.hpp>
 #include "ppcemu.h"
+#include "ppcjit.h"
 #include "ppcmmu.h"
+#include "ppcpredecode.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <setjmp.h>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace dppc_interpreter;
@@ -39,8 +49,11 @@ using namespace dppc_interpreter;
 MemCtrlBase* mem_ctrl_instance = 0;
 
 bool is_601 = false;
+static bool has_power_modes = false; // HID0 DOZE/NAP/SLEEP are implemented
 
-bool power_on = false;
+// cleared by host threads to stop the CPU thread
+std::atomic<bool> power_on{false};
+EXEC_MODE exec_mode = interpreter; // execution engine used by ppc_exec()
 Po_Cause power_off_reason = po_enter_debugger;
 
 SetPRS ppc_state;
@@ -53,9 +66,8 @@ uint32_t ppc_effective_address;
 uint32_t ppc_next_instruction_address;    // Used for branching, setting up the NIA
 
 unsigned exec_flags; // execution control flags
-// FIXME: exec_timer is read by main thread ppc_main_opcode;
-// written by audio dbdma DMAChannel::update_irq .. add_immediate_timer
-volatile bool exec_timer;
+// set by the CPU thread and by other host threads posting events to it
+std::atomic<bool> exec_timer;
 bool int_pin = false; // interrupt request pin state: true - asserted
 bool dec_exception_pending = false;
 
@@ -66,6 +78,8 @@ uint32_t    glob_bb_start_la;
 
 /* variables related to virtual time */
 bool     g_realtime;
+bool     g_adaptive;
+uint64_t g_max_latency_ns = PPC_DEF_MAX_LATENCY_NS;
 uint64_t g_nanoseconds_base;
 uint64_t g_icycles_base;
 uint64_t g_icycles;
@@ -171,8 +185,12 @@ void ppc_fpu_off() {
     ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::FPU_OFF);
 }
 
+void force_cycle_counter_reload();
+
 void ppc_assert_int() {
     int_pin = true;
+    if (ppc_state.msr & MSR::POW)
+        force_cycle_counter_reload(); // wake up ppc_power_save()
     if (ppc_state.msr & MSR::EE) {
         LOG_F(5, "CPU ExtIntHandler called");
         ppc_exception_handler(Except_Type::EXC_EXT_INT, 0);
@@ -196,60 +214,48 @@ void ppc_opcode18() {
 }
 
 template<field_601 for601>
-void ppc_opcode19() {
-    uint16_t subop_grab = ppc_cur_instruction & 0x7FF;
-
-    switch (subop_grab) {
+static PPCOpcode decode_opcode19(uint32_t opcode) {
+    switch (opcode & 0x7FF) {
     case 0:
-        ppc_mcrf();
-        break;
+        return ppc_mcrf;
     case 32:
-        ppc_bclr<LK0>();
-        break;
+        return ppc_bclr<LK0>;
     case 33:
-        ppc_bclr<LK1>();
-        break;
+        return ppc_bclr<LK1>;
     case 66:
-        ppc_crnor();
-        break;
+        return ppc_crnor;
     case 100:
-        ppc_rfi();
-        break;
+        return ppc_rfi;
     case 258:
-        ppc_crandc();
-        break;
+        return ppc_crandc;
     case 300:
-        ppc_isync();
-        break;
+        return ppc_isync;
     case 386:
-        ppc_crxor();
-        break;
+        return ppc_crxor;
     case 450:
-        ppc_crnand();
-        break;
+        return ppc_crnand;
     case 514:
-        ppc_crand();
-        break;
+        return ppc_crand;
     case 578:
-        ppc_creqv();
-        break;
+        return ppc_creqv;
     case 834:
-        ppc_crorc();
-        break;
+        return ppc_crorc;
     case 898:
-        ppc_cror();
-        break;
+        return ppc_cror;
     case 1056:
-        ppc_bcctr<LK0, for601>();
-        break;
+        return ppc_bcctr<LK0, for601>;
     case 1057:
-        ppc_bcctr<LK1, for601>();
-        break;
+        return ppc_bcctr<LK1, for601>;
     default:
-        ppc_illegalop();
+        return ppc_illegalop;
     }
 }
 
+template<field_601 for601>
+void ppc_opcode19() {
+    decode_opcode19<for601>(ppc_cur_instruction)();
+}
+
 template void ppc_opcode19<NOT601>();
 template void ppc_opcode19<IS601>();
 
@@ -277,45 +283,382 @@ void ppc_main_opcode()
     OpcodeGrabber[(ppc_cur_instruction >> 26) & 0x3F]();
 }
 
-static long long now_ns() {
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+/* Resolve the final handler without going through the decoding functions above */
+PPCOpcode ppc_decode_opcode(uint32_t opcode)
+{
+    switch (opcode >> 26) {
+    case 16:
+        return SubOpcode16Grabber[opcode & 3];
+    case 18:
+        return SubOpcode18Grabber[opcode & 3];
+    case 19:
+        return is_601 ? decode_opcode19<IS601>(opcode) : decode_opcode19<NOT601>(opcode);
+    case 31:
+        return SubOpcode31Grabber[opcode & 0x7FFUL];
+    case 59:
+        return SubOpcode59Grabber[opcode & 0x3FUL];
+    case 63:
+        return SubOpcode63Grabber[opcode & 0x7FFUL];
+    default:
+        return OpcodeGrabber[opcode >> 26];
+    }
 }
 
+/* In realtime mode, the host clock is read once per event check. Virtual
+   time is interpolated from the cycle counter in between, at the rate
+   measured over previous slices, and never runs past the next check. */
+static uint64_t rt_host_ns;     // host time at the last event check
+static uint64_t rt_base_ns;     // virtual time at the last event check
+static uint64_t rt_base_cycles; // cycle count at the last event check
+static uint64_t rt_limit_ns;    // virtual time of the next event check
+static uint64_t rt_cycle_ns;    // ns per cycle, 16.16 fixed point
+static bool     rt_slept;       // CPU thread slept during this slice
+
+#define RT_MAX_CYCLE_NS     (1024ULL << 16)
+#define RT_MAX_SAMPLE_NS    1000000000ULL // ignore longer slices for rate
+
+/* In adaptive mode, virtual time follows the cycle counter only, scaled by
+   the ns-per-cycle rate the host achieves. The rate is measured over
+   windows of AT_WINDOW_NS, excluding idle time, and nudged to cancel
+   the accumulated drift from the host clock. */
+static uint64_t at_base_ns;     // virtual time at the start of the window
+static uint64_t at_base_cycles; // cycle count at the start of the window
+static uint64_t at_host_ns;     // host time at the start of the window
+static uint64_t at_idle_cycles; // cycles skipped by idle waits in the window
+static uint64_t at_idle_ns;     // host time slept by idle waits in the window
+static uint64_t at_virt_origin; // virtual time when adaptive timing started
+static uint64_t at_host_origin; // host time when adaptive timing started
+static uint64_t at_cycle_ns;    // ns per cycle, 16.16 fixed point
+static bool     at_started;
+
+#define AT_WINDOW_NS        10000000 // 10 ms
+
 uint64_t get_virt_time_ns()
 {
     if (g_realtime) {
-        return now_ns() - g_nanoseconds_base;
+        uint64_t cycles = std::min<uint64_t>(g_icycles - rt_base_cycles, UINT32_MAX);
+        return std::min(rt_base_ns + ((cycles * rt_cycle_ns) >> 16), rt_limit_ns);
+    } else if (g_adaptive) {
+        return at_base_ns + (((g_icycles - at_base_cycles) * at_cycle_ns) >> 16);
     } else {
         return g_icycles << icnt_factor;
     }
 }
 
+static void adaptive_rescale()
+{
+    uint64_t virt_ns = get_virt_time_ns();
+
+    if (at_started && virt_ns - at_base_ns < AT_WINDOW_NS)
+        return;
+
+    uint64_t host_ns = host_clock_ns() - g_nanoseconds_base;
+
+    if (!at_started) {
+        at_started     = true;
+        at_virt_origin = virt_ns;
+        at_host_origin = host_ns;
+    } else {
+        uint64_t cycles  = g_icycles - at_base_cycles - at_idle_cycles;
+        int64_t  busy_ns = int64_t(host_ns - at_host_ns - at_idle_ns);
+
+        if (cycles >= 1000 && busy_ns > 0 && uint64_t(busy_ns) < RT_MAX_SAMPLE_NS) {
+            uint64_t rate = (uint64_t(busy_ns) << 16) / cycles;
+
+            // spread the correction of the drift over the next window
+            int64_t drift = int64_t(virt_ns - at_virt_origin) - int64_t(host_ns - at_host_origin);
+            drift = std::clamp<int64_t>(drift, -AT_WINDOW_NS / 2, AT_WINDOW_NS / 2);
+            rate  = rate * uint64_t(AT_WINDOW_NS - drift) / AT_WINDOW_NS;
+
+            rate = std::clamp<uint64_t>(rate, 1, RT_MAX_CYCLE_NS);
+            at_cycle_ns = (at_cycle_ns * 3 + rate) / 4;
+        }
+    }
+
+    at_base_ns     = virt_ns;
+    at_base_cycles = g_icycles;
+    at_host_ns     = host_ns;
+    at_idle_cycles = 0;
+    at_idle_ns     = 0;
+}
+
+static void realtime_resync()
+{
+    uint64_t host_ns = host_clock_ns() - g_nanoseconds_base;
+    uint64_t virt_ns = get_virt_time_ns();
+    uint64_t cycles  = g_icycles - rt_base_cycles;
+
+    // update the execution rate, idle time would inflate it
+    if (!rt_slept && cycles >= 1000 && host_ns > rt_host_ns &&
+        host_ns - rt_host_ns < RT_MAX_SAMPLE_NS) {
+        uint64_t rate = ((host_ns - rt_host_ns) << 16) / cycles;
+        rate = std::clamp<uint64_t>(rate, 1, RT_MAX_CYCLE_NS);
+        rt_cycle_ns = (rt_cycle_ns * 3 + rate) / 4;
+    }
+    rt_slept = false;
+
+    // virtual time must not go backwards
+    rt_host_ns     = host_ns;
+    rt_base_ns     = std::max(host_ns, virt_ns);
+    rt_base_cycles = g_icycles;
+    rt_limit_ns    = rt_base_ns;
+}
+
+#define PPC_IDLE_MAX_SLEEP_NS   10000000 // max host sleep time in realtime/adaptive mode
+
+// max cycles between two iterations of an idle loop
+// JIT blocks are accounted as a whole when entered
+#define PPC_IDLE_MAX_GAP        128
+
+/* state of the next event check, used to let idle time pass */
+static uint64_t next_event_cycles;  // cycle count returned by process_events()
+static uint64_t next_event_ns;      // virtual time of the next event check
+static uint64_t num_event_checks;   // number of process_events() calls
+
+static std::mutex              idle_mutex;
+static std::condition_variable idle_cv;
+
 uint64_t process_events()
 {
     exec_timer = false;
+    num_event_checks++;
+    if (g_realtime)
+        realtime_resync();
+    else if (g_adaptive)
+        adaptive_rescale();
     uint64_t slice_ns = TimerManager::get_instance()->process_timers();
+    if (g_adaptive && !g_realtime) {
+        // bound the host time between two checks
+        if (slice_ns == 0 || slice_ns > g_max_latency_ns)
+            slice_ns = g_max_latency_ns;
+        next_event_cycles = g_icycles + ((slice_ns << 16) + at_cycle_ns - 1) / at_cycle_ns;
+        next_event_ns = get_virt_time_ns() + slice_ns;
+        return next_event_cycles;
+    }
     if (slice_ns == 0) {
         // execute 10.000 cycles
         // if there are no pending timers
-        return g_icycles + 10000;
+        slice_ns = 10000ULL << icnt_factor;
+        next_event_cycles = g_icycles + 10000;
+    } else {
+        next_event_cycles = g_icycles + ((slice_ns + (1ULL << icnt_factor)) >> icnt_factor);
     }
-    return g_icycles + ((slice_ns + (1ULL << icnt_factor)) >> icnt_factor);
+    if (g_realtime) {
+        // a virtual clock ahead of the host catches up within this slice
+        rt_limit_ns   = std::max(rt_base_ns, rt_host_ns + slice_ns);
+        next_event_ns = rt_limit_ns;
+        // the slice lasts as many cycles as the host executes in that time
+        next_event_cycles = g_icycles + ((slice_ns << 16) + rt_cycle_ns - 1) / rt_cycle_ns;
+    } else {
+        next_event_ns = get_virt_time_ns() + slice_ns;
+    }
+    return next_event_cycles;
 }
 
 void force_cycle_counter_reload()
 {
     // tell the interpreter loop to reload cycle counter
     exec_timer = true;
+
+    if (g_realtime || g_adaptive) {
+        // wake up the CPU thread sleeping in ppc_idle_wait()
+        std::lock_guard<std::mutex> lk(idle_mutex);
+        idle_cv.notify_one();
+    }
 }
 
+static void notify_posted_event()
+{
+    // called from the posting thread
+    exec_timer = true;
+
+    if (g_realtime || g_adaptive) {
+        // wake up the CPU thread sleeping in ppc_idle_wait()
+        std::lock_guard<std::mutex> lk(idle_mutex);
+        idle_cv.notify_one();
+    }
+}
+
+void ppc_idle_wait()
+{
+    if (exec_timer)
+        return; // the timer queue has changed, check it first
+
+    if (g_realtime) {
+        int64_t sleep_ns = int64_t(next_event_ns - (host_clock_ns() - g_nanoseconds_base));
+        rt_slept = true;
+        if (sleep_ns > 0) {
+            // don't oversleep events posted without notification
+            sleep_ns = std::min<int64_t>(sleep_ns, PPC_IDLE_MAX_SLEEP_NS);
+            std::unique_lock<std::mutex> lk(idle_mutex);
+            idle_cv.wait_for(lk, std::chrono::nanoseconds(sleep_ns),
+                             [] { return exec_timer.load(); });
+        }
+        exec_timer = true;
+    } else if (g_adaptive) {
+        // sleep until the host clock reaches the next event, then skip
+        // the cycles virtual time lags behind it
+        uint64_t start_ns = host_clock_ns() - g_nanoseconds_base;
+        int64_t  sleep_ns = int64_t(next_event_ns - at_virt_origin) -
+                            int64_t(start_ns - at_host_origin);
+        if (sleep_ns > 0) {
+            sleep_ns = std::min<int64_t>(sleep_ns, PPC_IDLE_MAX_SLEEP_NS);
+            std::unique_lock<std::mutex> lk(idle_mutex);
+            idle_cv.wait_for(lk, std::chrono::nanoseconds(sleep_ns),
+                             [] { return exec_timer.load(); });
+        }
+        uint64_t host_ns = host_clock_ns() - g_nanoseconds_base;
+        int64_t  lag_ns  = int64_t(host_ns - at_host_origin) -
+                           int64_t(get_virt_time_ns() - at_virt_origin);
+        if (lag_ns > 0 && g_icycles < next_event_cycles) {
+            uint64_t cycles = std::min((uint64_t(lag_ns) << 16) / at_cycle_ns,
+                                       next_event_cycles - g_icycles);
+            g_icycles      += cycles;
+            at_idle_cycles += cycles;
+        }
+        at_idle_ns += host_ns - start_ns;
+        exec_timer = true;
+    } else if (g_icycles < next_event_cycles) {
+        g_icycles = next_event_cycles;
+    }
+}
+
+void ppc_power_save()
+{
+    if (!has_power_modes ||
+        !(ppc_state.spr[SPR::HID0] & (HID0_DOZE | HID0_NAP | HID0_SLEEP)))
+        return;
+
+    LOG_F(9, "CPU entering power saving mode, HID0=0x%08X",
+          ppc_state.spr[SPR::HID0]);
+
+    // only interrupts clear MSR[POW] so nothing happens
+    // until timers raise one of them
+    while ((ppc_state.msr & MSR::POW) && power_on) {
+        ppc_idle_wait();
+        process_events();
+    }
+}
+
+#ifdef PPC_IDLE_SKIP
+/** Register state after the last iteration of a loop closed by ppc_idle_branch(). */
+static struct {
+    uint32_t    pc;
+    uint32_t    cr;
+    uint32_t    gpr[32];
+    uint64_t    icycles;
+    uint64_t    event_checks;
+} idle_loop;
+
+/** Handler for backward branches closing short loops without side effects.
+
+    These loops can only exit after an event or an external agent has
+    changed memory. Once an iteration completes without changing any
+    register, the remaining iterations are skipped by letting time pass
+    until the next event.
+ */
+void ppc_idle_branch()
+{
+    uint32_t branch_pc = ppc_state.pc;
+
+    ppc_decode_opcode(ppc_cur_instruction)();
+
+    if (exec_flags != EXEF_BRANCH) {
+        idle_loop.pc = 0xFFFFFFFFUL; // loop exited
+        return;
+    }
+
+    // compare with the immediately preceding iteration only
+    if (idle_loop.pc == branch_pc && idle_loop.event_checks == num_event_checks &&
+        g_icycles - idle_loop.icycles <= PPC_IDLE_MAX_GAP &&
+        idle_loop.cr == ppc_state.cr &&
+        !std::memcmp(idle_loop.gpr, ppc_state.gpr, sizeof(idle_loop.gpr))) {
+        ppc_idle_wait();
+        idle_loop.pc = 0xFFFFFFFFUL;
+        return;
+    }
+
+    idle_loop.pc           = branch_pc;
+    idle_loop.cr           = ppc_state.cr;
+    idle_loop.icycles      = g_icycles;
+    idle_loop.event_checks = num_event_checks;
+    std::memcpy(idle_loop.gpr, ppc_state.gpr, sizeof(idle_loop.gpr));
+}
+#endif
+
+/** Stop policies for the interpreter loop below.
+
+    enter_page() is called whenever execution moves to another page and
+    tells whether any stop point may be located there. at_stop() is then
+    evaluated after every instruction executed on such pages only.
+ */
+
 /** Execute PPC code as long as power is on. */
+struct RunPolicy {
+    bool enter_page([[maybe_unused]] uint32_t page_start) { return false; }
+    bool at_stop([[maybe_unused]] uint32_t addr) { return false; }
+};
+
+/** Execute PPC code until goal_addr is reached. */
+struct UntilPolicy {
+    uint32_t goal_addr;
+
+    bool enter_page(uint32_t page_start) {
+        return (this->goal_addr & PAGE_MASK) == page_start;
+    }
+    bool at_stop(uint32_t addr) { return addr == this->goal_addr; }
+};
+
+/** Execute PPC code until control reaches the specified region. */
+struct RegionPolicy {
+    uint32_t start_addr;
+    uint32_t size;
+
+    bool enter_page(uint32_t page_start) {
+        uint32_t first_page = this->start_addr & PAGE_MASK;
+        uint32_t last_page  = (this->start_addr + this->size - 1) & PAGE_MASK;
+        return this->size && page_start - first_page <= last_page - first_page;
+    }
+    bool at_stop(uint32_t addr) { return addr - this->start_addr < this->size; }
+};
+
+/** Execute PPC code until a breakpoint is hit. */
+typedef std::bitset<(PAGE_SIZE >> 2)> BreakpointBitmap;
+
+static std::unordered_map<uint32_t, BreakpointBitmap> bp_pages;
+
+struct BreakpointPolicy {
+    const BreakpointBitmap* bp_bitmap = nullptr;
+
+    bool enter_page(uint32_t page_start) {
+        auto it = bp_pages.find(page_start);
+        this->bp_bitmap = (it == bp_pages.end()) ? nullptr : &it->second;
+        return this->bp_bitmap != nullptr;
+    }
+    bool at_stop(uint32_t addr) {
+        return this->bp_bitmap->test((addr & ~PAGE_MASK) >> 2);
+    }
+};
+
+/** Continue at the exception vector after an instruction fetch raised ISI.
+    Only reached with PPC_EXC_RETURN because translation otherwise longjmps.
+    Returns true if execution has to stop at the vector. */
+template <class StopPolicy>
+static bool ppc_enter_isi(StopPolicy& stop)
+{
+    ppc_state.pc = ppc_next_instruction_address;
+    exec_flags   = 0;
+    return stop.enter_page(ppc_state.pc & PAGE_MASK) && stop.at_stop(ppc_state.pc);
+}
+
 // inner interpreter loop
-static void ppc_exec_inner()
+template <class StopPolicy>
+static void ppc_exec_inner(StopPolicy& stop)
 {
     uint64_t max_cycles;
-    uint32_t page_start, eb_start, eb_end;
-    uint8_t* pc_real;
+    uint32_t page_start, eb_start, eb_end, pd_gen;
+    PredecodedInstr* pd_instr;
+    bool check_stops;
 
     max_cycles = 0;
 
@@ -323,37 +666,63 @@ static void ppc_exec_inner()
         // define boundaries of the next execution block
         // max execution block length = one memory page
         eb_start   = ppc_state.pc;
-        page_start = eb_start & PAGE_MASK;
-        eb_end     = page_start + PAGE_SIZE - 1;
         exec_flags = 0;
 
-        pc_real    = mmu_translate_imem(eb_start);
+        pd_instr = ppc_predecode_lookup(eb_start);
+        if (pd_instr == nullptr) {
+            if (ppc_enter_isi(stop))
+                return;
+            continue;
+        }
+
+        page_start  = eb_start & PAGE_MASK;
+        eb_end      = page_start + PAGE_SIZE - 1;
+        pd_gen      = predecode_gen;
+        check_stops = stop.enter_page(page_start);
 
         // interpret execution block
-        while (power_on && ppc_state.pc < eb_end) {
-            ppc_main_opcode();
+        // power_on is only re-checked after events and branches
+        while (ppc_state.pc < eb_end) {
+            ppc_exec_predecoded(pd_instr);
             if (g_icycles++ >= max_cycles || exec_timer) {
                 max_cycles = process_events();
+                if (!power_on)
+                    eb_end = 0; // leave once PC has been updated
             }
 
             if (exec_flags) {
                 // define next execution block
                 eb_start = ppc_next_instruction_address;
-                if (!(exec_flags & EXEF_RFI) && (eb_start & PAGE_MASK) == page_start) {
-                    pc_real += (int)eb_start - (int)ppc_state.pc;
-                    ppc_set_cur_instruction(pc_real);
+                if (!(exec_flags & (EXEF_RFI | EXEF_EXCEPTION)) &&
+                    (eb_start & PAGE_MASK) == page_start &&
+                    pd_gen == predecode_gen) {
+                    pd_instr += ((int)eb_start - (int)ppc_state.pc) >> 2;
                 } else {
                     page_start = eb_start & PAGE_MASK;
                     eb_end = page_start + PAGE_SIZE - 1;
-                    pc_real = mmu_translate_imem(eb_start);
+                    // the MSR may have changed so don't rely on cached targets
+                    pd_instr = (exec_flags & (EXEF_RFI | EXEF_EXCEPTION)) ?
+                        ppc_predecode_lookup(eb_start) :
+                        ppc_predecode_lookup_branch(eb_start, ppc_state.pc, pd_instr, pd_gen);
+                    if (pd_instr == nullptr) {
+                        if (ppc_enter_isi(stop))
+                            return;
+                        break;
+                    }
+                    pd_gen = predecode_gen;
+                    check_stops = stop.enter_page(page_start);
                 }
                 ppc_state.pc = eb_start;
                 exec_flags = 0;
+                if (!power_on)
+                    break;
             } else {
                 ppc_state.pc += 4;
-                pc_real += 4;
-                ppc_set_cur_instruction(pc_real);
+                pd_instr++;
             }
+
+            if (check_stops && stop.at_stop(ppc_state.pc))
+                return;
         }
     }
 }
@@ -361,20 +730,37 @@ static void ppc_exec_inner()
 // outer interpreter loop
 void ppc_exec()
 {
+    RunPolicy stop;
+
+#ifndef PPC_EXC_RETURN
     if (setjmp(exc_env)) {
         // process low-level exceptions
         //LOG_F(9, "PPC-EXEC: low_level exception raised!");
         ppc_state.pc = ppc_next_instruction_address;
     }
+#endif
 
     while (power_on) {
-        ppc_exec_inner();
+#ifdef PPC_THREADED_INT
+        if (exec_mode == threaded_int) {
+            ppc_exec_threaded_inner();
+            continue;
+        }
+#endif
+#ifdef PPC_JIT
+        if (exec_mode == jit) {
+            ppc_exec_jit_inner();
+            continue;
+        }
+#endif
+        ppc_exec_inner(stop);
     }
 }
 
 /** Execute one PPC instruction. */
 void ppc_exec_single()
 {
+#ifndef PPC_EXC_RETURN
     if (setjmp(exc_env)) {
         // process low-level exceptions
         //LOG_F(9, "PPC-EXEC: low_level exception raised!");
@@ -382,8 +768,14 @@ void ppc_exec_single()
         exec_flags = 0;
         return;
     }
+#endif
 
-    mmu_translate_imem(ppc_state.pc);
+    if (mmu_translate_imem(ppc_state.pc) == nullptr) {
+        // instruction fetch raised ISI
+        ppc_state.pc = ppc_next_instruction_address;
+        exec_flags = 0;
+        return;
+    }
     ppc_main_opcode();
     g_icycles++;
     process_events();
@@ -396,136 +788,110 @@ void ppc_exec_single()
     }
 }
 
-/** Execute PPC code until goal_addr is reached. */
-
-// inner interpreter loop
-static void ppc_exec_until_inner(const uint32_t goal_addr)
+// outer interpreter loop
+void ppc_exec_until(volatile uint32_t goal_addr)
 {
-    uint64_t max_cycles;
-    uint32_t page_start, eb_start, eb_end;
-    uint8_t* pc_real;
+    UntilPolicy stop{goal_addr};
 
-    max_cycles = 0;
+#ifndef PPC_EXC_RETURN
+    if (setjmp(exc_env)) {
+        // process low-level exceptions
+        //LOG_F(9, "PPC-EXEC: low_level exception raised!");
+        ppc_state.pc = ppc_next_instruction_address;
+    }
+#endif
 
     do {
-        // define boundaries of the next execution block
-        // max execution block length = one memory page
-        eb_start   = ppc_state.pc;
-        page_start = eb_start & PAGE_MASK;
-        eb_end     = page_start + PAGE_SIZE - 1;
-        exec_flags = 0;
-
-        pc_real    = mmu_translate_imem(eb_start);
-
-        // interpret execution block
-        while (power_on && ppc_state.pc < eb_end) {
-            ppc_main_opcode();
-            if (g_icycles++ >= max_cycles || exec_timer) {
-                max_cycles = process_events();
-            }
-
-            if (exec_flags) {
-                // define next execution block
-                eb_start = ppc_next_instruction_address;
-                if (!(exec_flags & EXEF_RFI) && (eb_start & PAGE_MASK) == page_start) {
-                    pc_real += (int)eb_start - (int)ppc_state.pc;
-                    ppc_set_cur_instruction(pc_real);
-                } else {
-                    page_start = eb_start & PAGE_MASK;
-                    eb_end = page_start + PAGE_SIZE - 1;
-                    pc_real = mmu_translate_imem(eb_start);
-                }
-                ppc_state.pc = eb_start;
-                exec_flags = 0;
-            } else {
-                ppc_state.pc += 4;
-                pc_real += 4;
-                ppc_set_cur_instruction(pc_real);
-            }
-
-            if (ppc_state.pc == goal_addr)
-                break;
+#ifdef PPC_THREADED_INT
+        if (exec_mode == threaded_int) {
+            ppc_exec_threaded_until_inner(goal_addr);
+            continue;
+        }
+#endif
+#ifdef PPC_JIT
+        if (exec_mode == jit) {
+            ppc_exec_jit_until_inner(goal_addr);
+            continue;
         }
+#endif
+        ppc_exec_inner(stop);
     } while (power_on && ppc_state.pc != goal_addr);
 }
 
 // outer interpreter loop
-void ppc_exec_until(volatile uint32_t goal_addr)
+void ppc_exec_dbg(volatile uint32_t start_addr, volatile uint32_t size)
 {
+    RegionPolicy stop{start_addr, size};
+
+#ifndef PPC_EXC_RETURN
     if (setjmp(exc_env)) {
         // process low-level exceptions
         //LOG_F(9, "PPC-EXEC: low_level exception raised!");
         ppc_state.pc = ppc_next_instruction_address;
     }
+#endif
 
-    do {
-        ppc_exec_until_inner(goal_addr);
-    } while (power_on && ppc_state.pc != goal_addr);
+    while (power_on && !stop.at_stop(ppc_state.pc)) {
+        ppc_exec_inner(stop);
+    }
 }
 
-/** Execute PPC code until control is reached the specified region. */
-
-// inner interpreter loop
-static void ppc_exec_dbg_inner(const uint32_t start_addr, const uint32_t size)
+// outer interpreter loop
+bool ppc_exec_until_bp()
 {
-    uint64_t max_cycles;
-    uint32_t page_start, eb_start, eb_end;
-    uint8_t* pc_real;
+    BreakpointPolicy stop;
 
-    max_cycles = 0;
+#ifndef PPC_EXC_RETURN
+    if (setjmp(exc_env)) {
+        // process low-level exceptions
+        //LOG_F(9, "PPC-EXEC: low_level exception raised!");
+        ppc_state.pc = ppc_next_instruction_address;
+        if (power_on && stop.enter_page(ppc_state.pc & PAGE_MASK) &&
+            stop.at_stop(ppc_state.pc))
+            return true;
+    }
+#endif
 
-    while (power_on && (ppc_state.pc < start_addr || ppc_state.pc >= start_addr + size)) {
-        // define boundaries of the next execution block
-        // max execution block length = one memory page
-        eb_start   = ppc_state.pc;
-        page_start = eb_start & PAGE_MASK;
-        eb_end     = page_start + PAGE_SIZE - 1;
-        exec_flags = 0;
+    // the instruction at PC is always executed so that
+    // execution can be resumed from a breakpoint
+    ppc_exec_inner(stop);
+    return power_on;
+}
 
-        pc_real    = mmu_translate_imem(eb_start);
+void ppc_set_breakpoint(uint32_t addr)
+{
+    bp_pages[addr & PAGE_MASK].set((addr & ~PAGE_MASK) >> 2);
+}
 
-        // interpret execution block
-        while (power_on && (ppc_state.pc < start_addr || ppc_state.pc >= start_addr + size)
-                && (ppc_state.pc < eb_end)) {
-            ppc_main_opcode();
-            if (g_icycles++ >= max_cycles || exec_timer) {
-                max_cycles = process_events();
-            }
+bool ppc_clear_breakpoint(uint32_t addr)
+{
+    auto it = bp_pages.find(addr & PAGE_MASK);
+    if (it == bp_pages.end() || !it->second.test((addr & ~PAGE_MASK) >> 2))
+        return false;
+
+    it->second.reset((addr & ~PAGE_MASK) >> 2);
+    if (it->second.none())
+        bp_pages.erase(it);
+    return true;
+}
 
-            if (exec_flags) {
-                // define next execution block
-                eb_start = ppc_next_instruction_address;
-                if (!(exec_flags & EXEF_RFI) && (eb_start & PAGE_MASK) == page_start) {
-                    pc_real += (int)eb_start - (int)ppc_state.pc;
-                    ppc_set_cur_instruction(pc_real);
-                } else {
-                    page_start = eb_start & PAGE_MASK;
-                    eb_end = page_start + PAGE_SIZE - 1;
-                    pc_real = mmu_translate_imem(eb_start);
-                }
-                ppc_state.pc = eb_start;
-                exec_flags = 0;
-            } else {
-                ppc_state.pc += 4;
-                pc_real += 4;
-                ppc_set_cur_instruction(pc_real);
-            }
-        }
-    }
+void ppc_clear_breakpoints()
+{
+    bp_pages.clear();
 }
 
-// outer interpreter loop
-void ppc_exec_dbg(volatile uint32_t start_addr, volatile uint32_t size)
+std::vector<uint32_t> ppc_get_breakpoints()
 {
-    if (setjmp(exc_env)) {
-        // process low-level exceptions
-        //LOG_F(9, "PPC-EXEC: low_level exception raised!");
-        ppc_state.pc = ppc_next_instruction_address;
-    }
+    std::vector<uint32_t> bps;
 
-    while (power_on && (ppc_state.pc < start_addr || ppc_state.pc >= start_addr + size)) {
-        ppc_exec_dbg_inner(start_addr, size);
+    for (auto& page : bp_pages) {
+        for (uint32_t i = 0; i < page.second.size(); i++) {
+            if (page.second.test(i))
+                bps.push_back(page.first + (i << 2));
+        }
     }
+    std::sort(bps.begin(), bps.end());
+    return bps;
 }
 
 /*
@@ -833,20 +1199,49 @@ void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
 
     ppc_state.spr[SPR::PVR] = cpu_version;
     is_601 = (cpu_version >> 16) == 1;
+    switch (cpu_version >> 16) {
+    case 3:  // 603
+    case 6:  // 603e
+    case 7:  // 603ev
+    case 8:  // 750
+        has_power_modes = true;
+        break;
+    default:
+        has_power_modes = false;
+    }
 
     initialize_ppc_opcode_tables();
 
+    // handlers may have changed so drop previously decoded code
+    ppc_predecode_flush();
+
     // initialize emulator timers
     TimerManager::get_instance()->set_time_now_cb(&get_virt_time_ns);
     TimerManager::get_instance()->set_notify_changes_cb(&force_cycle_counter_reload);
+    TimerManager::get_instance()->set_notify_posted_cb(&notify_posted_event);
 
     // initialize time base facility
     g_realtime = false;
-    g_nanoseconds_base = now_ns();
+    g_adaptive = false;
+    host_clock_init();
+    g_nanoseconds_base = host_clock_ns();
     g_icycles_base = 0;
     g_icycles = 0;
     //icnt_factor      = 6;
     icnt_factor = 4;
+    rt_host_ns = 0;
+    rt_base_ns = 0;
+    rt_base_cycles = 0;
+    rt_limit_ns = 0;
+    rt_cycle_ns = (1ULL << icnt_factor) << 16;
+    rt_slept = false;
+    at_base_ns = 0;
+    at_base_cycles = 0;
+    at_host_ns = 0;
+    at_idle_cycles = 0;
+    at_idle_ns = 0;
+    at_cycle_ns = (1ULL << icnt_factor) << 16;
+    at_started = false;
     tbr_wr_timestamp = 0;
     rtc_timestamp = 0;
     tbr_wr_value = 0;
@@ -868,6 +1263,11 @@ void ppc_cpu_init(MemCtrlBase* mem_ctrl, uint32_t cpu_version, uint64_t tb_freq)
         ppc_state.spr[SPR::DEC] = 0xFFFFFFFFUL;
     }
 
+#ifdef PPC_FASTMEM
+    // the memory map may have changed
+    fastmem_reset();
+#endif
+
     ppc_mmu_init();
 
     /* redirect code execution to reset vector */
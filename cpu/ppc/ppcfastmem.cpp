@@ -0,0 +1,414 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Host-mapped guest address space for the dynamic recompiler.
+
+    Guest RAM and ROM are mapped into 4 GiB host address windows so
+    compiled loads and stores can access them at window base + EA.
+    There is one window per data translation mode: real addressing maps
+    physical memory one-to-one, translated supervisor and user mode map
+    DBAT blocks only. Everything else is left inaccessible, as are ROM
+    and read-only blocks for writing, pages holding predecoded code and
+    clean pages of dirty page tracking.
+
+    The fault handler continues a faulting access at its soft TLB code
+    and patches the access into a jump there for good. Faults caused by
+    write protection of guest pages are redirected only once: the soft TLB
+    drops the predecoded page or marks the page dirty, which makes it
+    writable again.
+ */
+
+#include <devices/memctrl/memctrlbase.h>
+#include <loguru.hpp>
+#include "ppcemu.h"
+#include "ppcjit.h"
+#include "ppcmmu.h"
+#include "ppcpredecode.h"
+
+#ifdef PPC_FASTMEM
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// guard page for accesses crossing the end of the window
+#define FM_WINDOW_SIZE  ((1ULL << 32) + PAGE_SIZE)
+
+
+/** Guest memory mapped at some effective address of a window. */
+typedef struct FastmemSpan {
+    uint32_t    ea;
+    uint32_t    pa;
+    uint64_t    size;
+    bool        writable;
+} FastmemSpan;
+
+typedef struct FastmemWindow {
+    uint8_t*                    base;
+    bool                        stale;
+    std::vector<FastmemSpan>    spans;
+} FastmemWindow;
+
+/** Load or store of compiled code accessing a window. */
+typedef struct FastmemSite {
+    uint8_t*    site;     // start of the instruction sequence to patch
+    uint8_t*    fallback; // soft TLB code for the same access
+} FastmemSite;
+
+enum : int {
+    FM_REAL,       // real addressing mode
+    FM_SUPERVISOR, // translated supervisor mode
+    FM_USER,       // translated user mode
+    FM_NUM_WINDOWS
+};
+
+uint8_t* fastmem_base = nullptr;
+
+static FastmemWindow fm_windows[FM_NUM_WINDOWS];
+static int      fm_cur_window = FM_REAL;
+static bool     fm_init_done  = false;
+static bool     fm_available  = false;
+static uint32_t fm_map_gen;
+
+static std::unordered_map<uintptr_t, FastmemSite> fm_sites;
+
+// physical pages holding predecoded code
+static std::unordered_set<uint32_t> fm_watched;
+
+// physical pages not written since their dirty state was harvested
+static std::unordered_set<uint32_t> fm_clean;
+
+// host pages write-protected because they map predecoded code or clean pages
+static std::unordered_set<uintptr_t> fm_wp_pages;
+
+static struct sigaction fm_old_segv;
+static struct sigaction fm_old_bus;
+
+static inline uintptr_t fm_host_page(uintptr_t addr) {
+    return addr & ~uintptr_t(PAGE_SIZE - 1);
+}
+
+static inline bool fm_in_window(uintptr_t addr) {
+    for (auto& w : fm_windows)
+        if (w.base && addr - uintptr_t(w.base) < FM_WINDOW_SIZE)
+            return true;
+    return false;
+}
+
+static void fm_fault_handler(int sig, siginfo_t* info, void* ctx) {
+    ucontext_t* uc = (ucontext_t*)ctx;
+    uintptr_t fault_addr = uintptr_t(info->si_addr);
+
+    auto it = fm_sites.find(uintptr_t(uc->uc_mcontext.gregs[REG_RIP]));
+    if (it != fm_sites.end() && fm_in_window(fault_addr)) {
+        FastmemSite& site = it->second;
+        if (!fm_wp_pages.count(fm_host_page(fault_addr))) {
+            // not guest memory -> never access the window from here again
+            int32_t disp = int32_t(site.fallback - (site.site + 5));
+            site.site[0] = 0xE9; // jmp rel32
+            memcpy(&site.site[1], &disp, 4);
+        }
+        uc->uc_mcontext.gregs[REG_RIP] = greg_t(site.fallback);
+        return;
+    }
+
+    // not ours -> pass it on
+    struct sigaction* old = (sig == SIGSEGV) ? &fm_old_segv : &fm_old_bus;
+    if (old->sa_flags & SA_SIGINFO) {
+        old->sa_sigaction(sig, info, ctx);
+    } else if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN) {
+        old->sa_handler(sig);
+    } else {
+        // the faulting instruction will be restarted and crash for real,
+        // an ignored fault would restart it forever
+        struct sigaction dfl = *old;
+        if (dfl.sa_handler == SIG_IGN)
+            dfl.sa_handler = SIG_DFL;
+        sigaction(sig, &dfl, nullptr);
+    }
+}
+
+static inline int fm_window_index(uint8_t mmu_mode) {
+    switch (mmu_mode) {
+    case 0:
+        return FM_REAL;
+    case 2:
+        return FM_SUPERVISOR;
+    default:
+        return FM_USER;
+    }
+}
+
+// Write-protect or unprotect the window pages mapping the given physical page
+// depending on whether it holds predecoded code or is clean.
+static void fm_protect_page(FastmemWindow& w, uint32_t phys_tag) {
+    const bool protect = fm_watched.count(phys_tag) || fm_clean.count(phys_tag);
+
+    for (auto& span : w.spans) {
+        if (!span.writable || phys_tag < span.pa || phys_tag - span.pa >= span.size)
+            continue;
+
+        uint8_t* host_page = w.base + span.ea + (phys_tag - span.pa);
+        if (protect == !!fm_wp_pages.count(uintptr_t(host_page)))
+            continue;
+        if (protect) {
+            mprotect(host_page, PAGE_SIZE, PROT_READ);
+            fm_wp_pages.insert(uintptr_t(host_page));
+        } else {
+            mprotect(host_page, PAGE_SIZE, PROT_READ | PROT_WRITE);
+            fm_wp_pages.erase(uintptr_t(host_page));
+        }
+    }
+}
+
+// Make a range of a window inaccessible.
+static void fm_unmap(FastmemWindow& w, uint32_t ea, uint64_t size) {
+    mmap(w.base + ea, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+         -1, 0);
+
+    uint64_t end = ea + size;
+
+    std::vector<FastmemSpan> kept;
+    for (auto& span : w.spans) {
+        uint64_t span_end = span.ea + span.size;
+        if (span_end <= ea || span.ea >= end) {
+            kept.push_back(span);
+            continue;
+        }
+        if (span.ea < ea)
+            kept.push_back({span.ea, span.pa, ea - span.ea, span.writable});
+        if (span_end > end)
+            kept.push_back({uint32_t(end), uint32_t(span.pa + (end - span.ea)),
+                            span_end - end, span.writable});
+    }
+    w.spans.swap(kept);
+
+    for (auto it = fm_wp_pages.begin(); it != fm_wp_pages.end();) {
+        if (*it - uintptr_t(w.base + ea) < size)
+            it = fm_wp_pages.erase(it);
+        else
+            ++it;
+    }
+}
+
+// Map the guest memory of a physical address range at ea.
+static void fm_map_phys(FastmemWindow& w, uint32_t ea, uint32_t pa, uint64_t size,
+                        bool writable) {
+    uint64_t pa_end = pa + size;
+
+    for (AddressMapEntry* entry : mem_ctrl_instance->get_address_map()) {
+        if (!(entry->type & (RT_ROM | RT_RAM)))
+            continue;
+
+        // only whole pages can be mapped
+        uint64_t start = std::max<uint64_t>(entry->start, pa);
+        uint64_t end   = std::min<uint64_t>(uint64_t(entry->end) + 1, pa_end);
+        start = (start + PAGE_SIZE - 1) & ~uint64_t(PAGE_SIZE - 1);
+        end  &= ~uint64_t(PAGE_SIZE - 1);
+        if (start >= end)
+            continue;
+
+        int fd;
+        uint32_t offset;
+        if (!mem_ctrl_instance->get_mem_backing(entry->mem_ptr, fd, offset) ||
+            (offset & (PAGE_SIZE - 1)))
+            continue;
+
+        bool span_writable = writable && (entry->type & RT_RAM);
+        uint32_t span_ea   = uint32_t(ea + (start - pa));
+
+        void* host = mmap(w.base + span_ea, end - start,
+                          span_writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                          MAP_SHARED | MAP_FIXED, fd, offset + (start - entry->start));
+        if (host == MAP_FAILED) {
+            LOG_F(WARNING, "fastmem: could not map 0x%" PRIX64 "..0x%" PRIX64,
+                  start, end - 1);
+            continue;
+        }
+
+        w.spans.push_back({span_ea, uint32_t(start), end - start, span_writable});
+    }
+}
+
+static void fm_build_window(int idx) {
+    FastmemWindow& w = fm_windows[idx];
+
+    fm_unmap(w, 0, 1ULL << 32);
+
+    if (idx == FM_REAL) {
+        // physical memory appears at its physical address
+        fm_map_phys(w, 0, 0, 1ULL << 32, true);
+    } else if (!is_601) {
+        // DBATs only, 601 BATs are left to the MMU code
+        uint8_t access_bit = (idx == FM_SUPERVISOR) ? 2 : 1;
+
+        // lower numbered BATs take precedence
+        for (int i = 3; i >= 0; i--) {
+            const PPC_BAT_entry& bat = dbat_array[i];
+            if (!(bat.access & access_bit))
+                continue;
+
+            uint64_t size = uint64_t(~bat.hi_mask) + 1;
+            fm_unmap(w, bat.bepi, size);
+            if (bat.prot)
+                fm_map_phys(w, bat.bepi, bat.phys_hi, size, bat.prot == 2);
+        }
+    }
+
+    for (uint32_t phys_tag : fm_watched)
+        fm_protect_page(w, phys_tag);
+    for (uint32_t phys_tag : fm_clean)
+        fm_protect_page(w, phys_tag);
+
+    w.stale = false;
+}
+
+bool fastmem_init() {
+    if (fm_init_done)
+        return fm_available;
+
+    fm_init_done = true;
+
+    if (sysconf(_SC_PAGESIZE) != PAGE_SIZE) {
+        LOG_F(WARNING, "fastmem: host page size isn't 4 KB");
+        return false;
+    }
+
+    for (auto& w : fm_windows) {
+        void* base = mmap(nullptr, FM_WINDOW_SIZE, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            LOG_F(WARNING, "fastmem: could not reserve host address space");
+            for (auto& w2 : fm_windows) {
+                if (w2.base)
+                    munmap(w2.base, FM_WINDOW_SIZE);
+                w2.base = nullptr;
+            }
+            return false;
+        }
+        w.base  = (uint8_t*)base;
+        w.stale = true;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = fm_fault_handler;
+    sa.sa_flags     = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &fm_old_segv);
+    sigaction(SIGBUS,  &sa, &fm_old_bus);
+
+    fm_available = true;
+    fm_map_gen   = mem_ctrl_instance->get_map_gen();
+    fastmem_sync();
+
+    return true;
+}
+
+void fastmem_reset() {
+    for (auto& w : fm_windows)
+        w.stale = true;
+
+    if (fm_available) {
+        fm_map_gen = mem_ctrl_instance->get_map_gen();
+        fastmem_sync();
+    }
+}
+
+void fastmem_sync() {
+    if (!fm_available)
+        return;
+
+    if (fm_map_gen != mem_ctrl_instance->get_map_gen()) {
+        fm_map_gen = mem_ctrl_instance->get_map_gen();
+        for (auto& w : fm_windows)
+            w.stale = true;
+    }
+
+    FastmemWindow& w = fm_windows[fm_cur_window];
+    if (w.stale)
+        fm_build_window(fm_cur_window);
+    fastmem_base = w.base;
+}
+
+void fastmem_change_mode(uint8_t mmu_mode) {
+    fm_cur_window = fm_window_index(mmu_mode);
+    fastmem_sync();
+}
+
+void fastmem_bats_changed() {
+    fm_windows[FM_SUPERVISOR].stale = true;
+    fm_windows[FM_USER].stale       = true;
+
+    if (fm_cur_window != FM_REAL)
+        fastmem_sync();
+}
+
+void fastmem_watch_code_page(uint32_t phys_tag) {
+    fm_watched.insert(phys_tag);
+
+    for (auto& w : fm_windows)
+        if (w.base)
+            fm_protect_page(w, phys_tag);
+}
+
+void fastmem_unwatch_code_page(uint32_t phys_tag) {
+    if (!fm_watched.erase(phys_tag))
+        return;
+
+    for (auto& w : fm_windows)
+        if (w.base)
+            fm_protect_page(w, phys_tag);
+}
+
+void fastmem_dirty_change(uint32_t start_addr, uint32_t size, bool is_clean) {
+    const uint32_t first = start_addr & ~(PAGE_SIZE - 1);
+    const uint64_t end   = uint64_t(start_addr) + size;
+
+    for (uint64_t phys_tag = first; phys_tag < end; phys_tag += PAGE_SIZE) {
+        if (is_clean)
+            fm_clean.insert(uint32_t(phys_tag));
+        else if (!fm_clean.erase(uint32_t(phys_tag)))
+            continue;
+
+        for (auto& w : fm_windows)
+            if (w.base)
+                fm_protect_page(w, uint32_t(phys_tag));
+    }
+}
+
+void fastmem_add_site(uint8_t* fault_ip, uint8_t* site, uint8_t* fallback) {
+    fm_sites[uintptr_t(fault_ip)] = {site, fallback};
+}
+
+void fastmem_clear_sites() {
+    fm_sites.clear();
+}
+
+#endif // PPC_FASTMEM
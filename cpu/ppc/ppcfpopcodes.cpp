@@ -649,6 +649,8 @@ void dppc_interpreter::ppc_lfs() {
     ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
     ppc_effective_address += (reg_a) ? val_reg_a : 0;
     uint32_t result = mmu_read_vmem<uint32_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_state.fpr[reg_d].dbl64_r = *(float*)(&result);
 }
 
@@ -658,6 +660,8 @@ void dppc_interpreter::ppc_lfsu() {
         ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
         ppc_effective_address += (reg_a) ? val_reg_a : 0;
         uint32_t result = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.fpr[reg_d].dbl64_r = *(float*)(&result);
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
@@ -669,6 +673,8 @@ void dppc_interpreter::ppc_lfsx() {
     ppc_grab_regsfpdiab(ppc_cur_instruction);
     ppc_effective_address = val_reg_b + (reg_a ? val_reg_a : 0);
     uint32_t result       = mmu_read_vmem<uint32_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_state.fpr[reg_d].dbl64_r = *(float*)(&result);
 }
 
@@ -677,6 +683,8 @@ void dppc_interpreter::ppc_lfsux() {
     if (reg_a) {
         ppc_effective_address = val_reg_a + val_reg_b;
         uint32_t result = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.fpr[reg_d].dbl64_r = *(float*)(&result);
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
@@ -689,6 +697,8 @@ void dppc_interpreter::ppc_lfd() {
     ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
     ppc_effective_address += (reg_a) ? val_reg_a : 0;
     uint64_t ppc_result64_d = mmu_read_vmem<uint64_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_dfpresult_int(reg_d, ppc_result64_d);
 }
 
@@ -698,6 +708,8 @@ void dppc_interpreter::ppc_lfdu() {
         ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
         ppc_effective_address += val_reg_a;
         uint64_t ppc_result64_d = mmu_read_vmem<uint64_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_store_dfpresult_int(reg_d, ppc_result64_d);
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
@@ -709,6 +721,8 @@ void dppc_interpreter::ppc_lfdx() {
     ppc_grab_regsfpdiab(ppc_cur_instruction);
     ppc_effective_address   = val_reg_b + (reg_a ? val_reg_a : 0);
     uint64_t ppc_result64_d = mmu_read_vmem<uint64_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_dfpresult_int(reg_d, ppc_result64_d);
 }
 
@@ -717,6 +731,8 @@ void dppc_interpreter::ppc_lfdux() {
     if (reg_a) {
         ppc_effective_address = val_reg_a + val_reg_b;
         uint64_t ppc_result64_d = mmu_read_vmem<uint64_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_store_dfpresult_int(reg_d, ppc_result64_d);
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
@@ -739,6 +755,8 @@ void dppc_interpreter::ppc_stfsu() {
         ppc_effective_address += val_reg_a;
         float result = ppc_state.fpr[reg_s].dbl64_r;
         mmu_write_vmem<uint32_t>(ppc_effective_address, *(uint32_t*)(&result));
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
@@ -758,6 +776,8 @@ void dppc_interpreter::ppc_stfsux() {
         ppc_effective_address = val_reg_a + val_reg_b;
         float result = ppc_state.fpr[reg_s].dbl64_r;
         mmu_write_vmem<uint32_t>(ppc_effective_address, *(uint32_t*)(&result));
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
@@ -777,6 +797,8 @@ void dppc_interpreter::ppc_stfdu() {
         ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
         ppc_effective_address += val_reg_a;
         mmu_write_vmem<uint64_t>(ppc_effective_address, ppc_state.fpr[reg_s].int64_r);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
@@ -794,6 +816,8 @@ void dppc_interpreter::ppc_stfdux() {
     if (reg_a != 0) {
         ppc_effective_address = val_reg_a + val_reg_b;
         mmu_write_vmem<uint64_t>(ppc_effective_address, ppc_state.fpr[reg_s].int64_r);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
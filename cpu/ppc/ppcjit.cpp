@@ -0,0 +1,1687 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Dynamic recompiler for x86-64 hosts.
+
+    Compiled blocks never span a page boundary and end at the first branch.
+    Guest registers live in ppc_state; host registers are only used as
+    temporaries within one instruction. Blocks are looked up by physical
+    address and may be executed under any virtual mapping of their page,
+    so the generated code only ever adjusts ppc_state.pc by relative
+    amounts.
+
+    Branches to the same page are chained by patching the exit jump
+    of the source block. Compiled blocks live exactly as long as the
+    predecoded copy of their page: ppc_predecode_invalidate() drops
+    them together with all links pointing to them.
+
+    Host register usage in the generated code:
+    RBX - &ppc_state
+    R12 - &g_icycles
+    R13 - &jit_max_cycles
+    R14 - &exec_timer
+    R15 - &pCurDTLB1
+    RBP - effective address of the current load/store
+ */
+
+#include <loguru.hpp>
+#include "ppcemu.h"
+#include "ppcjit.h"
+#include "ppcmmu.h"
+#include "ppcpredecode.h"
+
+#ifdef PPC_JIT
+
+#include <sys/mman.h>
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace dppc_interpreter;
+
+#define JIT_CODE_SIZE         (32 << 20) // size of the code buffer in bytes
+#define JIT_MAX_BLOCK_INSTRS  64
+#define JIT_MAX_BLOCK_CODE    (64 << 10) // worst case code size for one block
+#define JIT_CACHE_BITS        12
+
+/** Exit codes returned by the generated code. Any other value is a JitLink*. */
+enum : uintptr_t {
+    JIT_EXIT_EVENTS  = 1, // timer events due, ppc_state.pc = block start
+    JIT_EXIT_RESOLVE = 2, // instruction at ppc_state.pc raised exec_flags
+                          // or modified code
+    JIT_EXIT_BRANCH  = 3, // ppc_state.pc holds the branch target
+};
+
+struct JitBlock;
+
+/** Direct branch from one block to another in the same page. */
+typedef struct JitLink {
+    JitBlock*   src;
+    uint8_t*    patch_site; // rel32 of the jump to patch
+    JitBlock*   target;     // linked block or nullptr
+} JitLink;
+
+typedef struct JitBlock {
+    uint32_t    phys;       // physical address of the first instruction
+    uint32_t    num_instrs;
+    uint8_t*    code;
+    bool        valid;
+    std::vector<std::unique_ptr<JitLink>> links;    // exits of this block
+    std::vector<JitLink*>                 incoming; // exits linked to this block
+} JitBlock;
+
+static uint8_t* jit_code_buf  = nullptr;
+static uint8_t* jit_code_ptr;  // next free byte
+static uint8_t* jit_code_base; // start of the block area
+static bool     jit_init_done = false;
+
+typedef uintptr_t (*JitEnterFunc)(const uint8_t* code);
+
+static JitEnterFunc jit_enter;
+static uint8_t*     jit_epilogue;
+static uint8_t*     jit_stub_events;
+static uint8_t*     jit_stub_resolve;
+
+static uint64_t jit_max_cycles;
+#ifdef PPC_FASTMEM
+static bool     jit_fastmem = false; // loads and stores go through fastmem windows
+#endif
+static uint32_t jit_flush_count = 0;
+
+// links are created for one execution mode: run or run until goal_addr
+static bool     jit_link_until = false;
+static uint32_t jit_link_goal  = 0;
+
+static std::vector<std::unique_ptr<JitBlock>>           jit_storage;
+static std::unordered_map<uint32_t, JitBlock*>              jit_blocks;
+static std::unordered_map<uint32_t, std::vector<JitBlock*>> jit_page_blocks;
+static JitBlock* jit_cache[1 << JIT_CACHE_BITS];
+
+/* ======================= x86-64 code emitter ======================= */
+
+enum X64Reg : int {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum X64Cond : uint8_t {
+    CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+enum X64Alu : uint8_t {
+    ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP
+};
+
+enum X64Shift : uint8_t {
+    SH_ROL = 0, SH_ROR = 1, SH_SHL = 4, SH_SHR = 5, SH_SAR = 7
+};
+
+class X64Emitter {
+public:
+    uint8_t* ptr;
+
+    void emit8(uint8_t v) { *ptr++ = v; }
+    void emit32(uint32_t v) { memcpy(ptr, &v, 4); ptr += 4; }
+    void emit64(uint64_t v) { memcpy(ptr, &v, 8); ptr += 8; }
+
+    // force = true is needed to access SPL, BPL, SIL and DIL
+    void rex(bool w, int reg, int base, bool force = false) {
+        uint8_t r = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((base & 8) >> 3);
+        if (r != 0x40 || force)
+            emit8(r);
+    }
+
+    void modrm_reg(int reg, int rm) {
+        emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // [base + disp]
+    void modrm_mem(int reg, int base, int32_t disp) {
+        int mod = (!disp && (base & 7) != RBP) ? 0 : (disp == int8_t(disp)) ? 1 : 2;
+        emit8((mod << 6) | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            emit8(0x24); // SIB without index
+        if (mod == 1)
+            emit8(disp);
+        else if (mod == 2)
+            emit32(disp);
+    }
+
+    // [base + index * (1 << scale) + disp], index must not be RSP
+    void modrm_sib(int reg, int base, int index, int scale, int32_t disp) {
+        int mod = (!disp && (base & 7) != RBP) ? 0 : (disp == int8_t(disp)) ? 1 : 2;
+        emit8((mod << 6) | ((reg & 7) << 3) | RSP);
+        emit8((scale << 6) | ((index & 7) << 3) | (base & 7));
+        if (mod == 1)
+            emit8(disp);
+        else if (mod == 2)
+            emit32(disp);
+    }
+
+    void op_rr(uint8_t opc, int reg, int rm, bool w = false) {
+        rex(w, reg, rm);
+        emit8(opc);
+        modrm_reg(reg, rm);
+    }
+
+    void op_rm(uint8_t opc, int reg, int base, int32_t disp, bool w = false) {
+        rex(w, reg, base);
+        emit8(opc);
+        modrm_mem(reg, base, disp);
+    }
+
+    void op_rmx(uint8_t opc, int reg, int base, int index, int scale, int32_t disp,
+                bool w = false) {
+        uint8_t r = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+        if (r != 0x40)
+            emit8(r);
+        emit8(opc);
+        modrm_sib(reg, base, index, scale, disp);
+    }
+
+    void op0f_rr(uint8_t opc, int reg, int rm, bool force = false) {
+        rex(false, reg, rm, force);
+        emit8(0x0F);
+        emit8(opc);
+        modrm_reg(reg, rm);
+    }
+
+    void op0f_rm(uint8_t opc, int reg, int base, int32_t disp) {
+        rex(false, reg, base);
+        emit8(0x0F);
+        emit8(opc);
+        modrm_mem(reg, base, disp);
+    }
+
+    void mov(int dst, int src) { op_rr(0x89, src, dst); }
+    void mov64(int dst, int src) { op_rr(0x89, src, dst, true); }
+    void load(int dst, int base, int32_t disp) { op_rm(0x8B, dst, base, disp); }
+    void store(int base, int32_t disp, int src) { op_rm(0x89, src, base, disp); }
+    void load64(int dst, int base, int32_t disp) { op_rm(0x8B, dst, base, disp, true); }
+    void store64(int base, int32_t disp, int src) { op_rm(0x89, src, base, disp, true); }
+    void add64(int dst, int src) { op_rr(0x01, src, dst, true); }
+    void add64_load(int dst, int base, int32_t disp) { op_rm(0x03, dst, base, disp, true); }
+    void load64_idx(int dst, int base, int index, int scale, int32_t disp) {
+        op_rmx(0x8B, dst, base, index, scale, disp, true);
+    }
+    void cmp_idx(int dst, int base, int index, int scale, int32_t disp) {
+        op_rmx(0x3B, dst, base, index, scale, disp);
+    }
+    void cmp64_load(int dst, int base, int32_t disp) { op_rm(0x3B, dst, base, disp, true); }
+
+    void store16(int base, int32_t disp, int src) {
+        emit8(0x66);
+        op_rm(0x89, src, base, disp);
+    }
+
+    void store8(int base, int32_t disp, int src) {
+        rex(false, src, base, src >= RSP && src <= RDI);
+        emit8(0x88);
+        modrm_mem(src, base, disp);
+    }
+
+    void mov_imm(int dst, uint32_t imm) {
+        rex(false, 0, dst);
+        emit8(0xB8 + (dst & 7));
+        emit32(imm);
+    }
+
+    void mov_imm64(int dst, uint64_t imm) {
+        rex(true, 0, dst);
+        emit8(0xB8 + (dst & 7));
+        emit64(imm);
+    }
+
+    void store_imm(int base, int32_t disp, uint32_t imm) {
+        rex(false, 0, base);
+        emit8(0xC7);
+        modrm_mem(0, base, disp);
+        emit32(imm);
+    }
+
+    void alu(X64Alu op, int dst, int src) { op_rr(0x01 + (op << 3), src, dst); }
+
+    void alu_load(X64Alu op, int dst, int base, int32_t disp) {
+        op_rm(0x03 + (op << 3), dst, base, disp);
+    }
+
+    void alu_imm(X64Alu op, int dst, uint32_t imm, bool w = false) {
+        rex(w, 0, dst);
+        if (int32_t(imm) == int8_t(imm)) {
+            emit8(0x83);
+            modrm_reg(op, dst);
+            emit8(imm);
+        } else {
+            emit8(0x81);
+            modrm_reg(op, dst);
+            emit32(imm);
+        }
+    }
+
+    void alu_mem_imm(X64Alu op, int base, int32_t disp, uint32_t imm) {
+        rex(false, 0, base);
+        if (int32_t(imm) == int8_t(imm)) {
+            emit8(0x83);
+            modrm_mem(op, base, disp);
+            emit8(imm);
+        } else {
+            emit8(0x81);
+            modrm_mem(op, base, disp);
+            emit32(imm);
+        }
+    }
+
+    void test(int a, int b) { op_rr(0x85, b, a); }
+
+    void test_imm(int r, uint32_t imm) {
+        rex(false, 0, r);
+        emit8(0xF7);
+        modrm_reg(0, r);
+        emit32(imm);
+    }
+
+    void test_mem_imm(int base, int32_t disp, uint32_t imm) {
+        rex(false, 0, base);
+        emit8(0xF7);
+        modrm_mem(0, base, disp);
+        emit32(imm);
+    }
+
+    void cmp8_mem_imm(int base, int32_t disp, uint8_t imm) {
+        rex(false, 0, base);
+        emit8(0x80);
+        modrm_mem(7, base, disp);
+        emit8(imm);
+    }
+
+    void shift_imm(X64Shift op, int r, uint8_t cnt, bool w = false) {
+        rex(w, 0, r);
+        emit8(0xC1);
+        modrm_reg(op, r);
+        emit8(cnt);
+    }
+
+    void shift_cl(X64Shift op, int r) {
+        rex(false, 0, r);
+        emit8(0xD3);
+        modrm_reg(op, r);
+    }
+
+    // rotate the low 16 bits by 8 = swap bytes of a halfword
+    void swap16(int r) {
+        emit8(0x66);
+        shift_imm(SH_ROL, r, 8);
+    }
+
+    void not_(int r) { op_rr(0xF7, 2, r); }
+    void neg(int r) { op_rr(0xF7, 3, r); }
+
+    void imul_load(int dst, int base, int32_t disp) { op0f_rm(0xAF, dst, base, disp); }
+
+    void imul_imm(int dst, int src, int32_t imm) {
+        rex(false, dst, src);
+        emit8(0x69);
+        modrm_reg(dst, src);
+        emit32(imm);
+    }
+
+    void bswap(int r) {
+        rex(false, 0, r);
+        emit8(0x0F);
+        emit8(0xC8 + (r & 7));
+    }
+
+    void movzx8_load(int dst, int base, int32_t disp) { op0f_rm(0xB6, dst, base, disp); }
+    void movzx16_load(int dst, int base, int32_t disp) { op0f_rm(0xB7, dst, base, disp); }
+    void movsx8(int dst, int src) { op0f_rr(0xBE, dst, src, src >= RSP && src <= RDI); }
+    void movsx16(int dst, int src) { op0f_rr(0xBF, dst, src); }
+
+    void cmov(X64Cond cc, int dst, int src) { op0f_rr(0x40 + cc, dst, src); }
+
+    void bt_mem_imm(int base, int32_t disp, uint8_t bit) {
+        op0f_rm(0xBA, 4, base, disp);
+        emit8(bit);
+    }
+
+    void cmc() { emit8(0xF5); }
+
+    // conditional jump with a 32-bit displacement, returns the displacement address
+    uint8_t* jcc(X64Cond cc) {
+        emit8(0x0F);
+        emit8(0x80 + cc);
+        uint8_t* rel = ptr;
+        emit32(0);
+        return rel;
+    }
+
+    uint8_t* jmp() {
+        emit8(0xE9);
+        uint8_t* rel = ptr;
+        emit32(0);
+        return rel;
+    }
+
+    void jcc_to(X64Cond cc, const uint8_t* target) { patch(jcc(cc), target); }
+    void jmp_to(const uint8_t* target) { patch(jmp(), target); }
+
+    void call(const void* fn) {
+        mov_imm64(RAX, uint64_t(fn));
+        op_rr(0xFF, 2, RAX);
+    }
+
+    void jmp_reg(int r) { op_rr(0xFF, 4, r); }
+
+    void push(int r) {
+        rex(false, 0, r);
+        emit8(0x50 + (r & 7));
+    }
+
+    void pop(int r) {
+        rex(false, 0, r);
+        emit8(0x58 + (r & 7));
+    }
+
+    void ret() { emit8(0xC3); }
+
+    static void patch(uint8_t* rel, const uint8_t* target) {
+        int32_t disp = int32_t(target - (rel + 4));
+        memcpy(rel, &disp, 4);
+    }
+};
+
+/* ===================== runtime support functions ===================== */
+
+// Return value of the slow path helpers: non-zero if the block must be left
+static inline uint32_t jit_exit_status(uint32_t gen) {
+    return exec_flags | (predecode_gen != gen);
+}
+
+static uint32_t jit_fallback(PPCOpcode handler, uint32_t opcode) {
+    uint32_t gen = predecode_gen;
+#ifdef CPU_PROFILING
+    num_executed_instrs++;
+#endif
+    ppc_cur_instruction = opcode;
+    handler();
+    return jit_exit_status(gen);
+}
+
+// loaded value in the low half, exit status in the high half
+template <class T>
+static uint64_t jit_read_slow(uint32_t ea) {
+    uint32_t gen = predecode_gen;
+    ppc_effective_address = ea;
+    uint32_t val = mmu_read_vmem<T>(ea);
+    return val | (uint64_t(jit_exit_status(gen)) << 32);
+}
+
+template <class T>
+static uint32_t jit_write_slow(uint32_t ea, uint32_t val) {
+    uint32_t gen = predecode_gen;
+    ppc_effective_address = ea;
+    mmu_write_vmem<T>(ea, T(val));
+    return jit_exit_status(gen);
+}
+
+/* ========================= block compiler ========================= */
+
+#define OFS_PC      int32_t(offsetof(SetPRS, pc))
+#define OFS_CR      int32_t(offsetof(SetPRS, cr))
+#define OFS_GPR(r)  int32_t(offsetof(SetPRS, gpr) + (r) * 4)
+#define OFS_SPR(n)  int32_t(offsetof(SetPRS, spr) + (n) * 4)
+
+/** Operation classes the recompiler knows how to translate. */
+enum JitOpKind : uint8_t {
+    JOP_FALLBACK = 0,
+    JOP_ADDI, JOP_ADDIS, JOP_ADDIC, JOP_SUBFIC, JOP_MULLI,
+    JOP_ANDI, JOP_ANDIS, JOP_ORI, JOP_ORIS, JOP_XORI, JOP_XORIS,
+    JOP_RLWINM, JOP_RLWIMI, JOP_RLWNM,
+    JOP_CMPI, JOP_CMPLI, JOP_CMP, JOP_CMPL,
+    JOP_ADD, JOP_ADDC, JOP_ADDE, JOP_ADDZE, JOP_SUBF, JOP_SUBFC, JOP_SUBFE,
+    JOP_NEG, JOP_MULLW,
+    JOP_AND, JOP_ANDC, JOP_OR, JOP_ORC, JOP_XOR, JOP_NOR, JOP_NAND, JOP_EQV,
+    JOP_SLW, JOP_SRW, JOP_SRAWI, JOP_EXTSB, JOP_EXTSH,
+    JOP_MFCR, JOP_MFSPR, JOP_MTSPR,
+    JOP_LOAD, JOP_STORE,
+    JOP_B, JOP_BC, JOP_BCLR, JOP_BCCTR,
+};
+
+typedef struct JitOpInfo {
+    JitOpKind   kind;
+    bool        rc;         // update CR0
+    uint8_t     size;       // memory access size
+    bool        sign;       // sign-extending load
+    bool        update;     // update form
+    bool        indexed;    // X-form
+} JitOpInfo;
+
+static std::unordered_map<PPCOpcode, JitOpInfo> jit_op_table;
+
+static void jit_init_op_table() {
+    auto& t = jit_op_table;
+
+    t[ppc_addi<SHFT0>]  = {JOP_ADDI};
+    t[ppc_addi<SHFT1>]  = {JOP_ADDIS};
+    t[ppc_addic<RC0>]   = {JOP_ADDIC};
+    t[ppc_addic<RC1>]   = {JOP_ADDIC, true};
+    t[ppc_subfic]       = {JOP_SUBFIC};
+    t[ppc_mulli]        = {JOP_MULLI};
+    t[ppc_andirc<SHFT0>] = {JOP_ANDI, true};
+    t[ppc_andirc<SHFT1>] = {JOP_ANDIS, true};
+    t[ppc_ori<SHFT0>]   = {JOP_ORI};
+    t[ppc_ori<SHFT1>]   = {JOP_ORIS};
+    t[ppc_xori<SHFT0>]  = {JOP_XORI};
+    t[ppc_xori<SHFT1>]  = {JOP_XORIS};
+    t[ppc_rlwinm]       = {JOP_RLWINM};
+    t[ppc_rlwimi]       = {JOP_RLWIMI};
+    t[ppc_rlwnm]        = {JOP_RLWNM};
+    t[ppc_cmpi]         = {JOP_CMPI};
+    t[ppc_cmpli]        = {JOP_CMPLI};
+    t[ppc_cmp]          = {JOP_CMP};
+    t[ppc_cmpl]         = {JOP_CMPL};
+
+    t[ppc_add<CARRY0, RC0, OV0>]  = {JOP_ADD};
+    t[ppc_add<CARRY0, RC1, OV0>]  = {JOP_ADD, true};
+    t[ppc_add<CARRY1, RC0, OV0>]  = {JOP_ADDC};
+    t[ppc_add<CARRY1, RC1, OV0>]  = {JOP_ADDC, true};
+    t[ppc_adde<RC0, OV0>]         = {JOP_ADDE};
+    t[ppc_adde<RC1, OV0>]         = {JOP_ADDE, true};
+    t[ppc_addze<RC0, OV0>]        = {JOP_ADDZE};
+    t[ppc_addze<RC1, OV0>]        = {JOP_ADDZE, true};
+    t[ppc_subf<CARRY0, RC0, OV0>] = {JOP_SUBF};
+    t[ppc_subf<CARRY0, RC1, OV0>] = {JOP_SUBF, true};
+    t[ppc_subf<CARRY1, RC0, OV0>] = {JOP_SUBFC};
+    t[ppc_subf<CARRY1, RC1, OV0>] = {JOP_SUBFC, true};
+    t[ppc_subfe<RC0, OV0>]        = {JOP_SUBFE};
+    t[ppc_subfe<RC1, OV0>]        = {JOP_SUBFE, true};
+    t[ppc_neg<RC0, OV0>]          = {JOP_NEG};
+    t[ppc_neg<RC1, OV0>]          = {JOP_NEG, true};
+    t[ppc_mullw<RC0, OV0>]        = {JOP_MULLW};
+    t[ppc_mullw<RC1, OV0>]        = {JOP_MULLW, true};
+
+    t[ppc_logical<ppc_and, RC0>]  = {JOP_AND};
+    t[ppc_logical<ppc_and, RC1>]  = {JOP_AND, true};
+    t[ppc_logical<ppc_andc, RC0>] = {JOP_ANDC};
+    t[ppc_logical<ppc_andc, RC1>] = {JOP_ANDC, true};
+    t[ppc_logical<ppc_or, RC0>]   = {JOP_OR};
+    t[ppc_logical<ppc_or, RC1>]   = {JOP_OR, true};
+    t[ppc_logical<ppc_orc, RC0>]  = {JOP_ORC};
+    t[ppc_logical<ppc_orc, RC1>]  = {JOP_ORC, true};
+    t[ppc_logical<ppc_xor, RC0>]  = {JOP_XOR};
+    t[ppc_logical<ppc_xor, RC1>]  = {JOP_XOR, true};
+    t[ppc_logical<ppc_nor, RC0>]  = {JOP_NOR};
+    t[ppc_logical<ppc_nor, RC1>]  = {JOP_NOR, true};
+    t[ppc_logical<ppc_nand, RC0>] = {JOP_NAND};
+    t[ppc_logical<ppc_nand, RC1>] = {JOP_NAND, true};
+    t[ppc_logical<ppc_eqv, RC0>]  = {JOP_EQV};
+    t[ppc_logical<ppc_eqv, RC1>]  = {JOP_EQV, true};
+
+    t[ppc_shift<LEFT1, RC0>]      = {JOP_SLW};
+    t[ppc_shift<LEFT1, RC1>]      = {JOP_SLW, true};
+    t[ppc_shift<RIGHT0, RC0>]     = {JOP_SRW};
+    t[ppc_shift<RIGHT0, RC1>]     = {JOP_SRW, true};
+    t[ppc_srawi<RC0>]             = {JOP_SRAWI};
+    t[ppc_srawi<RC1>]             = {JOP_SRAWI, true};
+    t[ppc_exts<int8_t, RC0>]      = {JOP_EXTSB};
+    t[ppc_exts<int8_t, RC1>]      = {JOP_EXTSB, true};
+    t[ppc_exts<int16_t, RC0>]     = {JOP_EXTSH};
+    t[ppc_exts<int16_t, RC1>]     = {JOP_EXTSH, true};
+
+    t[ppc_mfcr]  = {JOP_MFCR};
+    t[ppc_mfspr] = {JOP_MFSPR};
+    t[ppc_mtspr] = {JOP_MTSPR};
+
+    //                                 rc     size sign   update indexed
+    t[ppc_lz<uint8_t>]    = {JOP_LOAD, false, 1, false, false, false};
+    t[ppc_lz<uint16_t>]   = {JOP_LOAD, false, 2, false, false, false};
+    t[ppc_lz<uint32_t>]   = {JOP_LOAD, false, 4, false, false, false};
+    t[ppc_lha]            = {JOP_LOAD, false, 2, true,  false, false};
+    t[ppc_lzu<uint8_t>]   = {JOP_LOAD, false, 1, false, true,  false};
+    t[ppc_lzu<uint16_t>]  = {JOP_LOAD, false, 2, false, true,  false};
+    t[ppc_lzu<uint32_t>]  = {JOP_LOAD, false, 4, false, true,  false};
+    t[ppc_lzx<uint8_t>]   = {JOP_LOAD, false, 1, false, false, true};
+    t[ppc_lzx<uint16_t>]  = {JOP_LOAD, false, 2, false, false, true};
+    t[ppc_lzx<uint32_t>]  = {JOP_LOAD, false, 4, false, false, true};
+    t[ppc_lhax]           = {JOP_LOAD, false, 2, true,  false, true};
+    t[ppc_st<uint8_t>]    = {JOP_STORE, false, 1, false, false, false};
+    t[ppc_st<uint16_t>]   = {JOP_STORE, false, 2, false, false, false};
+    t[ppc_st<uint32_t>]   = {JOP_STORE, false, 4, false, false, false};
+    t[ppc_stu<uint8_t>]   = {JOP_STORE, false, 1, false, true,  false};
+    t[ppc_stu<uint16_t>]  = {JOP_STORE, false, 2, false, true,  false};
+    t[ppc_stu<uint32_t>]  = {JOP_STORE, false, 4, false, true,  false};
+    t[ppc_stx<uint8_t>]   = {JOP_STORE, false, 1, false, false, true};
+    t[ppc_stx<uint16_t>]  = {JOP_STORE, false, 2, false, false, true};
+    t[ppc_stx<uint32_t>]  = {JOP_STORE, false, 4, false, false, true};
+
+    t[ppc_b<LK0, AA0>]  = {JOP_B};
+    t[ppc_b<LK0, AA1>]  = {JOP_B};
+    t[ppc_b<LK1, AA0>]  = {JOP_B};
+    t[ppc_b<LK1, AA1>]  = {JOP_B};
+    t[ppc_bc<LK0, AA0>] = {JOP_BC};
+    t[ppc_bc<LK0, AA1>] = {JOP_BC};
+    t[ppc_bc<LK1, AA0>] = {JOP_BC};
+    t[ppc_bc<LK1, AA1>] = {JOP_BC};
+    t[ppc_bclr<LK0>]    = {JOP_BCLR};
+    t[ppc_bclr<LK1>]    = {JOP_BCLR};
+    t[ppc_bcctr<LK0, NOT601>] = {JOP_BCCTR};
+    t[ppc_bcctr<LK1, NOT601>] = {JOP_BCCTR};
+}
+
+static inline bool jit_ends_block(const PredecodedInstr& instr) {
+    auto it = jit_op_table.find(instr.handler);
+    return it != jit_op_table.end() && it->second.kind >= JOP_B;
+}
+
+/** mask generator for rotate and shift instructions (§ 4.2.1.4 PowerpC PEM) */
+static inline uint32_t rot_mask(unsigned rot_mb, unsigned rot_me) {
+    uint32_t m1 = 0xFFFFFFFFUL >> rot_mb;
+    uint32_t m2 = (uint32_t)(0xFFFFFFFFUL << (31 - rot_me));
+    return ((rot_mb <= rot_me) ? m2 & m1 : m1 | m2);
+}
+
+class JitCompiler {
+public:
+    JitCompiler(JitBlock* blk, uint8_t* code_ptr) : blk(blk) {
+        e.ptr = code_ptr;
+    }
+
+    uint8_t* compile(const PredecodedInstr* instrs, uint32_t num_instrs);
+    uint8_t* code_end() const { return e.ptr; }
+
+private:
+    X64Emitter  e;
+    JitBlock*   blk;
+    uint32_t    page_ofs;   // page offset of the first instruction
+    uint32_t    cur_ofs;    // offset of the current instruction from block start
+    uint32_t    synced_ofs; // offset ppc_state.pc currently points to
+    uint32_t    opcode;
+
+    std::vector<std::function<void()>> slow_paths;
+
+    int reg_d() { return (opcode >> 21) & 0x1F; }
+    int reg_a() { return (opcode >> 16) & 0x1F; }
+    int reg_b() { return (opcode >> 11) & 0x1F; }
+    int32_t simm() { return int32_t(int16_t(opcode)); }
+    uint32_t uimm() { return uint16_t(opcode); }
+
+    void sync_pc();
+    void gen_cr0();
+    void gen_ca_from_cf(bool inverted);
+    void gen_cmp_result(X64Cond lt_cond);
+    void gen_ea(const JitOpInfo& op);
+    void gen_tlb_lookup(int size, int32_t tag_ofs, uint8_t* slow_entry[2]);
+    uint8_t* gen_load_access(const JitOpInfo& op);
+    uint8_t* gen_store_access(const JitOpInfo& op, int rs);
+    void gen_tlb_load(const JitOpInfo& op, uint8_t* slow_entry[2]);
+    void gen_tlb_store(const JitOpInfo& op, int rs, uint8_t* slow_entry[2]);
+    void gen_load_slow(const JitOpInfo& op, uint8_t* slow_entry[2], uint32_t pc_delta,
+                       uint8_t* join, int rd, int ra);
+    void gen_store_slow(const JitOpInfo& op, uint8_t* slow_entry[2], uint32_t pc_delta,
+                        uint8_t* join, int rs, int ra);
+    void gen_load(const JitOpInfo& op);
+    void gen_store(const JitOpInfo& op);
+    void gen_fallback(PPCOpcode handler);
+    void gen_exit(uint32_t target_ofs);
+    void gen_exit_indirect(int reg);
+    void gen_set_lr();
+    bool gen_branch_cond(uint32_t br_bo, uint32_t br_bi, bool dec_ctr,
+                         std::vector<uint8_t*>& not_taken);
+    bool gen_instr(const PredecodedInstr* instr);
+};
+
+// Bring ppc_state.pc in line with the current instruction.
+void JitCompiler::sync_pc() {
+    if (cur_ofs != synced_ofs) {
+        e.alu_mem_imm(ALU_ADD, RBX, OFS_PC, cur_ofs - synced_ofs);
+        synced_ofs = cur_ofs;
+    }
+}
+
+// CR0 = LT/GT/EQ of EAX | XER[SO]. Preserves EAX.
+void JitCompiler::gen_cr0() {
+    e.test(RAX, RAX);
+    e.mov_imm(RDX, 0x40000000UL);
+    e.mov_imm(RCX, 0x80000000UL);
+    e.cmov(CC_S, RDX, RCX);
+    e.mov_imm(RCX, 0x20000000UL);
+    e.cmov(CC_E, RDX, RCX);
+    e.load(RCX, RBX, OFS_SPR(SPR::XER));
+    e.shift_imm(SH_SHR, RCX, 3);
+    e.alu_imm(ALU_AND, RCX, 0x10000000UL);
+    e.alu(ALU_OR, RDX, RCX);
+    e.load(RCX, RBX, OFS_CR);
+    e.alu_imm(ALU_AND, RCX, 0x0FFFFFFFUL);
+    e.alu(ALU_OR, RCX, RDX);
+    e.store(RBX, OFS_CR, RCX);
+}
+
+// XER[CA] = host carry flag. Preserves EAX.
+void JitCompiler::gen_ca_from_cf(bool inverted) {
+    if (inverted)
+        e.cmc();
+    e.alu(ALU_SBB, R9, R9);
+    e.alu_imm(ALU_AND, R9, XER::CA);
+    e.load(R10, RBX, OFS_SPR(SPR::XER));
+    e.alu_imm(ALU_AND, R10, ~uint32_t(XER::CA));
+    e.alu(ALU_OR, R10, R9);
+    e.store(RBX, OFS_SPR(SPR::XER), R10);
+}
+
+// Store the result of a preceding x86 compare into CR field crfD.
+void JitCompiler::gen_cmp_result(X64Cond lt_cond) {
+    int crf_d = (opcode >> 21) & 0x1C;
+
+    e.mov_imm(RDX, 0x40000000UL);
+    e.mov_imm(R8, 0x80000000UL);
+    e.cmov(lt_cond, RDX, R8);
+    e.mov_imm(R8, 0x20000000UL);
+    e.cmov(CC_E, RDX, R8);
+    e.load(RCX, RBX, OFS_SPR(SPR::XER));
+    e.shift_imm(SH_SHR, RCX, 3);
+    e.alu_imm(ALU_AND, RCX, 0x10000000UL);
+    e.alu(ALU_OR, RDX, RCX);
+    if (crf_d)
+        e.shift_imm(SH_SHR, RDX, crf_d);
+    e.load(RCX, RBX, OFS_CR);
+    e.alu_imm(ALU_AND, RCX, ~(0xF0000000UL >> crf_d));
+    e.alu(ALU_OR, RCX, RDX);
+    e.store(RBX, OFS_CR, RCX);
+}
+
+// effective address -> EBP
+void JitCompiler::gen_ea(const JitOpInfo& op) {
+    if (op.indexed) {
+        e.load(RBP, RBX, OFS_GPR(reg_b()));
+        if (reg_a())
+            e.alu_load(ALU_ADD, RBP, RBX, OFS_GPR(reg_a()));
+    } else if (reg_a()) {
+        e.load(RBP, RBX, OFS_GPR(reg_a()));
+        if (simm())
+            e.alu_imm(ALU_ADD, RBP, simm());
+    } else {
+        e.mov_imm(RBP, simm());
+    }
+}
+
+// Look up EBP in the tag array at tag_ofs of the primary DTLB.
+// On hit, R8 = primary DTLB, RAX = entry index.
+void JitCompiler::gen_tlb_lookup(int size, int32_t tag_ofs, uint8_t* slow_entry[2]) {
+    slow_entry[0] = nullptr;
+    if (size > 1) {
+        // unaligned accesses are left to the MMU code
+        e.test_imm(RBP, size - 1);
+        slow_entry[0] = e.jcc(CC_NE);
+    }
+    e.mov(RAX, RBP);
+    e.shift_imm(SH_SHR, RAX, PAGE_SIZE_BITS);
+    e.alu_imm(ALU_AND, RAX, TLB_SIZE - 1);
+    e.load64(R8, R15, 0);
+    e.mov(RCX, RBP);
+    e.alu_imm(ALU_AND, RCX, PAGE_MASK);
+    e.mov_imm64(RDX, uint64_t(&tlb1_gen));
+    e.alu_load(ALU_OR, RCX, RDX, 0);
+    e.cmp_idx(RCX, R8, RAX, 2, tag_ofs);
+    slow_entry[1] = e.jcc(CC_NE);
+}
+
+// Load from host address RDX into EAX. Returns the address of the access.
+uint8_t* JitCompiler::gen_load_access(const JitOpInfo& op) {
+    uint8_t* access = e.ptr;
+    switch (op.size) {
+    case 1:
+        e.movzx8_load(RAX, RDX, 0);
+        break;
+    case 2:
+        e.movzx16_load(RAX, RDX, 0);
+        e.swap16(RAX);
+        if (op.sign)
+            e.movsx16(RAX, RAX);
+        break;
+    case 4:
+        e.load(RAX, RDX, 0);
+        e.bswap(RAX);
+        break;
+    }
+    return access;
+}
+
+// Store GPR rs to host address RDX. Returns the address of the access.
+uint8_t* JitCompiler::gen_store_access(const JitOpInfo& op, int rs) {
+    uint8_t* access;
+    e.load(RCX, RBX, OFS_GPR(rs));
+    switch (op.size) {
+    case 1:
+        access = e.ptr;
+        e.store8(RDX, 0, RCX);
+        break;
+    case 2:
+        e.swap16(RCX);
+        access = e.ptr;
+        e.store16(RDX, 0, RCX);
+        break;
+    default:
+        e.bswap(RCX);
+        access = e.ptr;
+        e.store(RDX, 0, RCX);
+        break;
+    }
+    return access;
+}
+
+void JitCompiler::gen_tlb_load(const JitOpInfo& op, uint8_t* slow_entry[2]) {
+    gen_tlb_lookup(op.size, offsetof(TLB1, tag), slow_entry);
+    e.load64_idx(RDX, R8, RAX, 3, offsetof(TLB1, host_va_offs_r));
+    e.add64(RDX, RBP);
+    gen_load_access(op);
+}
+
+void JitCompiler::gen_tlb_store(const JitOpInfo& op, int rs, uint8_t* slow_entry[2]) {
+    // write tags only match writable pages without pending PTE updates
+    // or predecoded code
+    gen_tlb_lookup(op.size, offsetof(TLB1, write_tag), slow_entry);
+    e.load64_idx(RDX, R8, RAX, 3, offsetof(TLB1, host_va_offs_w));
+    e.add64(RDX, RBP);
+    gen_store_access(op, rs);
+}
+
+void JitCompiler::gen_load_slow(const JitOpInfo& op, uint8_t* slow_entry[2], uint32_t pc_delta,
+                                uint8_t* join, int rd, int ra) {
+    const void* helper = op.size == 1 ? (const void*)jit_read_slow<uint8_t> :
+                         op.size == 2 ? (const void*)jit_read_slow<uint16_t> :
+                                        (const void*)jit_read_slow<uint32_t>;
+
+    for (int i = 0; i < 2; i++)
+        if (slow_entry[i])
+            X64Emitter::patch(slow_entry[i], e.ptr);
+    if (pc_delta)
+        e.alu_mem_imm(ALU_ADD, RBX, OFS_PC, pc_delta);
+    e.mov(RDI, RBP);
+    e.call(helper);
+    e.mov64(RCX, RAX);
+    e.shift_imm(SH_SHR, RCX, 32, true); // exit status
+    // sign-extend after taking the status: the 32-bit movsx clears RAX[63:32]
+    // but leaves the flags of the shift alone
+    if (op.size == 2 && op.sign)
+        e.movsx16(RAX, RAX);
+    uint8_t* leave = e.jcc(CC_NE);
+    if (pc_delta)
+        e.alu_mem_imm(ALU_SUB, RBX, OFS_PC, pc_delta);
+    e.jmp_to(join);
+    X64Emitter::patch(leave, e.ptr);
+#ifdef PPC_EXC_RETURN
+    e.test_imm(RCX, EXEF_ABORT);
+    e.jcc_to(CC_NE, jit_stub_resolve);
+#endif
+    e.store(RBX, OFS_GPR(rd), RAX);
+    if (op.update)
+        e.store(RBX, OFS_GPR(ra), RBP);
+    e.jmp_to(jit_stub_resolve);
+}
+
+void JitCompiler::gen_store_slow(const JitOpInfo& op, uint8_t* slow_entry[2], uint32_t pc_delta,
+                                 uint8_t* join, int rs, int ra) {
+    const void* helper = op.size == 1 ? (const void*)jit_write_slow<uint8_t> :
+                         op.size == 2 ? (const void*)jit_write_slow<uint16_t> :
+                                        (const void*)jit_write_slow<uint32_t>;
+
+    for (int i = 0; i < 2; i++)
+        if (slow_entry[i])
+            X64Emitter::patch(slow_entry[i], e.ptr);
+    if (pc_delta)
+        e.alu_mem_imm(ALU_ADD, RBX, OFS_PC, pc_delta);
+    e.mov(RDI, RBP);
+    e.load(RSI, RBX, OFS_GPR(rs));
+    e.call(helper);
+    e.test(RAX, RAX);
+    uint8_t* leave = e.jcc(CC_NE);
+    if (pc_delta)
+        e.alu_mem_imm(ALU_SUB, RBX, OFS_PC, pc_delta);
+    e.jmp_to(join);
+    X64Emitter::patch(leave, e.ptr);
+    if (op.update) {
+#ifdef PPC_EXC_RETURN
+        e.test_imm(RAX, EXEF_ABORT);
+        e.jcc_to(CC_NE, jit_stub_resolve);
+#endif
+        e.store(RBX, OFS_GPR(ra), RBP);
+    }
+    e.jmp_to(jit_stub_resolve);
+}
+
+#ifdef PPC_FASTMEM
+// RDX = host address of EBP in the window of the current translation mode.
+// Code generated by this function is patched into a jump to the soft TLB
+// code if a window access faults, see ppcfastmem.cpp.
+static inline void gen_fastmem_addr(X64Emitter& e) {
+    e.mov_imm64(RDX, uint64_t(&fastmem_base));
+    e.load64(RDX, RDX, 0);
+    e.add64(RDX, RBP);
+}
+#endif
+
+void JitCompiler::gen_load(const JitOpInfo& op) {
+    uint8_t* slow_entry[2] = {};
+    uint8_t* fast_site     = nullptr;
+    uint8_t* fault_ip      = nullptr;
+    int rd = reg_d(), ra = reg_a();
+
+    gen_ea(op);
+
+#ifdef PPC_FASTMEM
+    if (jit_fastmem) {
+        fast_site = e.ptr;
+        gen_fastmem_addr(e);
+        fault_ip = gen_load_access(op);
+    } else
+#endif
+        gen_tlb_load(op, slow_entry);
+
+    uint8_t* join = e.ptr;
+    e.store(RBX, OFS_GPR(rd), RAX);
+    if (op.update)
+        e.store(RBX, OFS_GPR(ra), RBP);
+
+    uint32_t pc_delta = cur_ofs - synced_ofs;
+
+    slow_paths.push_back([=, this]() mutable {
+#ifdef PPC_FASTMEM
+        if (fast_site) {
+            fastmem_add_site(fault_ip, fast_site, e.ptr);
+            gen_tlb_load(op, slow_entry);
+            e.jmp_to(join);
+        }
+#endif
+        gen_load_slow(op, slow_entry, pc_delta, join, rd, ra);
+    });
+}
+
+void JitCompiler::gen_store(const JitOpInfo& op) {
+    uint8_t* slow_entry[2] = {};
+    uint8_t* fast_site     = nullptr;
+    uint8_t* fault_ip      = nullptr;
+    int rs = reg_d(), ra = reg_a();
+
+    gen_ea(op);
+
+#ifdef PPC_FASTMEM
+    if (jit_fastmem) {
+        fast_site = e.ptr;
+        gen_fastmem_addr(e);
+        fault_ip = gen_store_access(op, rs);
+    } else
+#endif
+        gen_tlb_store(op, rs, slow_entry);
+
+    uint8_t* join = e.ptr;
+    if (op.update)
+        e.store(RBX, OFS_GPR(ra), RBP);
+
+    uint32_t pc_delta = cur_ofs - synced_ofs;
+
+    slow_paths.push_back([=, this]() mutable {
+#ifdef PPC_FASTMEM
+        if (fast_site) {
+            fastmem_add_site(fault_ip, fast_site, e.ptr);
+            gen_tlb_store(op, rs, slow_entry);
+            e.jmp_to(join);
+        }
+#endif
+        gen_store_slow(op, slow_entry, pc_delta, join, rs, ra);
+    });
+}
+
+void JitCompiler::gen_fallback(PPCOpcode handler) {
+    sync_pc();
+    e.mov_imm64(RDI, uint64_t(handler));
+    e.mov_imm(RSI, opcode);
+    e.call((const void*)jit_fallback);
+    e.test(RAX, RAX);
+    e.jcc_to(CC_NE, jit_stub_resolve);
+}
+
+// Leave the block for the instruction at the given offset from block start.
+// Exits to the same page can be chained to the target block later.
+void JitCompiler::gen_exit(uint32_t target_ofs) {
+    if (target_ofs != synced_ofs)
+        e.alu_mem_imm(ALU_ADD, RBX, OFS_PC, target_ofs - synced_ofs);
+
+    int32_t target_po = int32_t(page_ofs + target_ofs);
+    if (target_po < 0 || target_po >= PAGE_SIZE) {
+        e.mov_imm(RAX, JIT_EXIT_BRANCH);
+        e.jmp_to(jit_epilogue);
+        return;
+    }
+
+    auto link        = std::make_unique<JitLink>();
+    link->src        = blk;
+    link->target     = nullptr;
+    link->patch_site = e.jmp(); // falls through until linked
+    e.mov_imm64(RAX, uint64_t(link.get()));
+    e.jmp_to(jit_epilogue);
+    blk->links.push_back(std::move(link));
+}
+
+// Leave the block for the address in reg.
+void JitCompiler::gen_exit_indirect(int reg) {
+    e.store(RBX, OFS_PC, reg);
+    e.mov_imm(RAX, JIT_EXIT_BRANCH);
+    e.jmp_to(jit_epilogue);
+}
+
+// LR = address of the current instruction + 4
+void JitCompiler::gen_set_lr() {
+    e.load(RCX, RBX, OFS_PC);
+    e.alu_imm(ALU_ADD, RCX, cur_ofs - synced_ofs + 4);
+    e.store(RBX, OFS_SPR(SPR::LR), RCX);
+}
+
+// Emit the BO/BI tests. Returns false if the branch is always taken.
+bool JitCompiler::gen_branch_cond(uint32_t br_bo, uint32_t br_bi, bool dec_ctr,
+                                  std::vector<uint8_t*>& not_taken) {
+    if (!(br_bo & 0x04)) {
+        if (dec_ctr)
+            e.alu_mem_imm(ALU_SUB, RBX, OFS_SPR(SPR::CTR), 1);
+        else
+            e.alu_mem_imm(ALU_CMP, RBX, OFS_SPR(SPR::CTR), 0);
+        not_taken.push_back(e.jcc((br_bo & 0x02) ? CC_NE : CC_E));
+    }
+    if (!(br_bo & 0x10)) {
+        e.test_mem_imm(RBX, OFS_CR, 0x80000000UL >> br_bi);
+        not_taken.push_back(e.jcc((br_bo & 0x08) ? CC_E : CC_NE));
+    }
+    return !not_taken.empty();
+}
+
+// Translate one instruction. Returns true if the block ends here.
+bool JitCompiler::gen_instr(const PredecodedInstr* instr) {
+    opcode = instr->opcode;
+
+    auto it = jit_op_table.find(instr->handler);
+    JitOpInfo op = (it != jit_op_table.end()) ? it->second : JitOpInfo{JOP_FALLBACK};
+
+    int rd = reg_d(), ra = reg_a(), rb = reg_b();
+
+    switch (op.kind) {
+    case JOP_ADDI:
+    case JOP_ADDIS: {
+        uint32_t imm = (op.kind == JOP_ADDIS) ? (opcode << 16) : simm();
+        if (ra) {
+            e.load(RAX, RBX, OFS_GPR(ra));
+            e.alu_imm(ALU_ADD, RAX, imm);
+        } else {
+            e.mov_imm(RAX, imm);
+        }
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    }
+    case JOP_ADDIC:
+        e.load(RAX, RBX, OFS_GPR(ra));
+        e.alu_imm(ALU_ADD, RAX, simm());
+        gen_ca_from_cf(false);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_SUBFIC:
+        e.mov_imm(RAX, simm());
+        e.alu_load(ALU_SUB, RAX, RBX, OFS_GPR(ra));
+        gen_ca_from_cf(true);
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_MULLI:
+        e.load(RCX, RBX, OFS_GPR(ra));
+        e.imul_imm(RAX, RCX, simm());
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_ANDI:
+    case JOP_ANDIS:
+    case JOP_ORI:
+    case JOP_ORIS:
+    case JOP_XORI:
+    case JOP_XORIS: {
+        bool shifted = op.kind == JOP_ANDIS || op.kind == JOP_ORIS || op.kind == JOP_XORIS;
+        uint32_t imm = shifted ? (uimm() << 16) : uimm();
+        X64Alu alu_op = (op.kind == JOP_ANDI || op.kind == JOP_ANDIS) ? ALU_AND :
+                        (op.kind == JOP_ORI  || op.kind == JOP_ORIS)  ? ALU_OR : ALU_XOR;
+        e.load(RAX, RBX, OFS_GPR(rd));
+        e.alu_imm(alu_op, RAX, imm);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    }
+    case JOP_RLWINM:
+    case JOP_RLWIMI:
+    case JOP_RLWNM: {
+        uint32_t mask = rot_mask((opcode >> 6) & 0x1F, (opcode >> 1) & 0x1F);
+        if (op.kind == JOP_RLWNM) {
+            e.load(RCX, RBX, OFS_GPR(rb));
+            e.load(RAX, RBX, OFS_GPR(rd));
+            e.shift_cl(SH_ROL, RAX);
+        } else {
+            e.load(RAX, RBX, OFS_GPR(rd));
+            if (rb) // rb = SH
+                e.shift_imm(SH_ROL, RAX, rb);
+        }
+        if (mask != 0xFFFFFFFFUL)
+            e.alu_imm(ALU_AND, RAX, mask);
+        if (op.kind == JOP_RLWIMI) {
+            e.load(RCX, RBX, OFS_GPR(ra));
+            e.alu_imm(ALU_AND, RCX, ~mask);
+            e.alu(ALU_OR, RAX, RCX);
+        }
+        if (opcode & 1)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    }
+    case JOP_CMPI:
+    case JOP_CMPLI:
+    case JOP_CMP:
+    case JOP_CMPL:
+        if (opcode & 0x200000) // L = 1 is left to the handler
+            goto fallback;
+        e.load(RAX, RBX, OFS_GPR(ra));
+        if (op.kind == JOP_CMPI)
+            e.alu_imm(ALU_CMP, RAX, simm());
+        else if (op.kind == JOP_CMPLI)
+            e.alu_imm(ALU_CMP, RAX, uimm());
+        else
+            e.alu_load(ALU_CMP, RAX, RBX, OFS_GPR(rb));
+        gen_cmp_result((op.kind == JOP_CMPI || op.kind == JOP_CMP) ? CC_L : CC_B);
+        break;
+    case JOP_ADD:
+    case JOP_ADDC:
+    case JOP_ADDE:
+    case JOP_ADDZE:
+        if (op.kind == JOP_ADDE || op.kind == JOP_ADDZE)
+            e.bt_mem_imm(RBX, OFS_SPR(SPR::XER), 29); // CF = XER[CA]
+        e.load(RAX, RBX, OFS_GPR(ra));
+        if (op.kind == JOP_ADDZE)
+            e.alu_imm(ALU_ADC, RAX, 0);
+        else
+            e.alu_load(op.kind == JOP_ADDE ? ALU_ADC : ALU_ADD, RAX, RBX, OFS_GPR(rb));
+        if (op.kind != JOP_ADD)
+            gen_ca_from_cf(false);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_SUBF:
+    case JOP_SUBFC:
+        e.load(RAX, RBX, OFS_GPR(rb));
+        e.alu_load(ALU_SUB, RAX, RBX, OFS_GPR(ra));
+        if (op.kind == JOP_SUBFC)
+            gen_ca_from_cf(true);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_SUBFE:
+        e.bt_mem_imm(RBX, OFS_SPR(SPR::XER), 29);
+        e.load(RAX, RBX, OFS_GPR(ra));
+        e.not_(RAX);
+        e.alu_load(ALU_ADC, RAX, RBX, OFS_GPR(rb));
+        gen_ca_from_cf(false);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_NEG:
+    case JOP_MULLW:
+        e.load(RAX, RBX, OFS_GPR(ra));
+        if (op.kind == JOP_NEG)
+            e.neg(RAX);
+        else
+            e.imul_load(RAX, RBX, OFS_GPR(rb));
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_AND:
+    case JOP_ANDC:
+    case JOP_OR:
+    case JOP_ORC:
+    case JOP_XOR:
+    case JOP_NOR:
+    case JOP_NAND:
+    case JOP_EQV:
+        e.load(RAX, RBX, OFS_GPR(rd));
+        if (op.kind == JOP_ANDC || op.kind == JOP_ORC) {
+            e.load(RCX, RBX, OFS_GPR(rb));
+            e.not_(RCX);
+            e.alu(op.kind == JOP_ANDC ? ALU_AND : ALU_OR, RAX, RCX);
+        } else {
+            X64Alu alu_op = (op.kind == JOP_AND || op.kind == JOP_NAND) ? ALU_AND :
+                            (op.kind == JOP_OR  || op.kind == JOP_NOR)  ? ALU_OR : ALU_XOR;
+            if (rb != rd || alu_op == ALU_XOR)
+                e.alu_load(alu_op, RAX, RBX, OFS_GPR(rb));
+            if (op.kind == JOP_NOR || op.kind == JOP_NAND || op.kind == JOP_EQV)
+                e.not_(RAX);
+        }
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    case JOP_SLW:
+    case JOP_SRW:
+        e.load(RCX, RBX, OFS_GPR(rb));
+        e.load(RAX, RBX, OFS_GPR(rd));
+        e.shift_cl(op.kind == JOP_SLW ? SH_SHL : SH_SHR, RAX);
+        e.mov_imm(RDX, 0);
+        e.test_imm(RCX, 0x20);
+        e.cmov(CC_NE, RAX, RDX);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    case JOP_SRAWI:
+        e.load(RAX, RBX, OFS_GPR(rd));
+        if (rb) { // rb = SH
+            // CA = negative source with ones shifted out
+            e.mov(RCX, RAX);
+            e.shift_imm(SH_SAR, RAX, rb);
+            e.mov(R9, RCX);
+            e.shift_imm(SH_SHR, R9, 31);
+            e.mov_imm(R10, 0);
+            e.test_imm(RCX, (1U << rb) - 1);
+            e.cmov(CC_E, R9, R10);
+            e.shift_imm(SH_SHL, R9, 29);
+            e.load(R10, RBX, OFS_SPR(SPR::XER));
+            e.alu_imm(ALU_AND, R10, ~uint32_t(XER::CA));
+            e.alu(ALU_OR, R10, R9);
+            e.store(RBX, OFS_SPR(SPR::XER), R10);
+        } else {
+            e.alu_mem_imm(ALU_AND, RBX, OFS_SPR(SPR::XER), ~uint32_t(XER::CA));
+        }
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    case JOP_EXTSB:
+    case JOP_EXTSH:
+        e.load(RAX, RBX, OFS_GPR(rd));
+        if (op.kind == JOP_EXTSB)
+            e.movsx8(RAX, RAX);
+        else
+            e.movsx16(RAX, RAX);
+        if (op.rc)
+            gen_cr0();
+        e.store(RBX, OFS_GPR(ra), RAX);
+        break;
+    case JOP_MFCR:
+        e.load(RAX, RBX, OFS_CR);
+        e.store(RBX, OFS_GPR(rd), RAX);
+        break;
+    case JOP_MFSPR:
+    case JOP_MTSPR: {
+        // only LR and CTR accesses have no side effects
+        uint32_t ref_spr = (rb << 5) | ra;
+        if (ref_spr != SPR::LR && ref_spr != SPR::CTR)
+            goto fallback;
+        if (op.kind == JOP_MFSPR) {
+            e.load(RAX, RBX, OFS_SPR(ref_spr));
+            e.store(RBX, OFS_GPR(rd), RAX);
+        } else {
+            e.load(RAX, RBX, OFS_GPR(rd));
+            e.store(RBX, OFS_SPR(ref_spr), RAX);
+        }
+        break;
+    }
+    case JOP_LOAD:
+        // invalid update forms are left to the handler
+        if (op.update && (!ra || ra == rd))
+            goto fallback;
+        gen_load(op);
+        break;
+    case JOP_STORE:
+        if (op.update && !ra)
+            goto fallback;
+        gen_store(op);
+        break;
+    case JOP_B: {
+        int32_t adr_li = int32_t((opcode & ~3UL) << 6) >> 6;
+        if (opcode & 1) // LK
+            gen_set_lr();
+        if (opcode & 2) { // AA
+            e.mov_imm(RAX, adr_li);
+            gen_exit_indirect(RAX);
+        } else {
+            gen_exit(cur_ofs + adr_li);
+        }
+        return true;
+    }
+    case JOP_BC: {
+        std::vector<uint8_t*> not_taken;
+        int32_t br_bd = int32_t(int16_t(opcode & ~3UL));
+        if (opcode & 1) // LK
+            gen_set_lr();
+        bool cond = gen_branch_cond(rd, ra, true, not_taken);
+        if (opcode & 2) { // AA
+            e.mov_imm(RAX, br_bd);
+            gen_exit_indirect(RAX);
+        } else {
+            gen_exit(cur_ofs + br_bd);
+        }
+        if (!cond)
+            return true;
+        for (auto rel : not_taken)
+            X64Emitter::patch(rel, e.ptr);
+        gen_exit(cur_ofs + 4);
+        return true;
+    }
+    case JOP_BCLR:
+    case JOP_BCCTR: {
+        std::vector<uint8_t*> not_taken;
+        bool cond = gen_branch_cond(rd, ra, op.kind == JOP_BCLR, not_taken);
+        e.load(RAX, RBX, OFS_SPR(op.kind == JOP_BCLR ? SPR::LR : SPR::CTR));
+        e.alu_imm(ALU_AND, RAX, ~3U);
+        if (opcode & 1) // LK
+            gen_set_lr();
+        gen_exit_indirect(RAX);
+        if (!cond)
+            return true;
+        for (auto rel : not_taken)
+            X64Emitter::patch(rel, e.ptr);
+        if (opcode & 1)
+            gen_set_lr();
+        gen_exit(cur_ofs + 4);
+        return true;
+    }
+    default:
+    fallback:
+        gen_fallback(instr->handler);
+        break;
+    }
+
+    return false;
+}
+
+uint8_t* JitCompiler::compile(const PredecodedInstr* instrs, uint32_t num_instrs) {
+    uint8_t* code = e.ptr;
+
+    page_ofs   = blk->phys & (PAGE_SIZE - 1);
+    synced_ofs = 0;
+
+    // the block ends with the first branch
+    blk->num_instrs = num_instrs;
+    for (uint32_t i = 0; i < num_instrs; i++) {
+        if (jit_ends_block(instrs[i])) {
+            blk->num_instrs = i + 1;
+            break;
+        }
+    }
+
+    // check for pending timer events, then account for the whole block
+    e.load64(RAX, R12, 0);
+    e.cmp64_load(RAX, R13, 0);
+    e.jcc_to(CC_AE, jit_stub_events);
+    e.cmp8_mem_imm(R14, 0, 0);
+    e.jcc_to(CC_NE, jit_stub_events);
+    e.alu_imm(ALU_ADD, RAX, blk->num_instrs, true);
+    e.store64(R12, 0, RAX);
+
+    bool has_exit = false;
+    for (uint32_t i = 0; i < blk->num_instrs && !has_exit; i++) {
+        cur_ofs  = i * 4;
+        has_exit = gen_instr(&instrs[i]);
+    }
+    if (!has_exit) {
+        cur_ofs = blk->num_instrs * 4;
+        gen_exit(cur_ofs);
+    }
+
+    for (auto& slow_path : slow_paths)
+        slow_path();
+
+    return code;
+}
+
+/* ========================= block management ========================= */
+
+static inline JitBlock*& jit_cache_slot(uint32_t phys) {
+    return jit_cache[(phys >> 2) & ((1 << JIT_CACHE_BITS) - 1)];
+}
+
+static void jit_flush() {
+    jit_storage.clear();
+    jit_blocks.clear();
+    jit_page_blocks.clear();
+    memset(jit_cache, 0, sizeof(jit_cache));
+    jit_code_ptr = jit_code_base;
+    jit_flush_count++;
+#ifdef PPC_FASTMEM
+    fastmem_clear_sites();
+#endif
+}
+
+static void jit_link(JitLink* link, JitBlock* target) {
+    X64Emitter::patch(link->patch_site, target->code);
+    link->target = target;
+    target->incoming.push_back(link);
+}
+
+static void jit_unlink(JitLink* link) {
+    X64Emitter::patch(link->patch_site, link->patch_site + 4);
+    link->target = nullptr;
+}
+
+static void jit_unlink_all() {
+    for (auto& blk : jit_storage) {
+        for (auto& link : blk->links)
+            if (link->target)
+                jit_unlink(link.get());
+        blk->incoming.clear();
+    }
+}
+
+void ppc_jit_invalidate_page(uint32_t phys_tag) {
+    auto page_it = jit_page_blocks.find(phys_tag);
+    if (page_it == jit_page_blocks.end())
+        return;
+
+    for (JitBlock* blk : page_it->second) {
+        for (JitLink* link : blk->incoming)
+            jit_unlink(link);
+        blk->incoming.clear();
+
+        for (auto& link : blk->links) {
+            if (!link->target)
+                continue;
+            auto& in = link->target->incoming;
+            for (auto it = in.begin(); it != in.end(); ++it) {
+                if (*it == link.get()) {
+                    in.erase(it);
+                    break;
+                }
+            }
+            jit_unlink(link.get());
+        }
+
+        blk->valid = false;
+        jit_blocks.erase(blk->phys);
+        if (jit_cache_slot(blk->phys) == blk)
+            jit_cache_slot(blk->phys) = nullptr;
+    }
+
+    jit_page_blocks.erase(page_it);
+}
+
+static inline JitBlock* jit_find_block(uint32_t phys) {
+    JitBlock* blk = jit_cache_slot(phys);
+    if (blk && blk->phys == phys)
+        return blk;
+
+    auto it = jit_blocks.find(phys);
+    if (it == jit_blocks.end())
+        return nullptr;
+
+    jit_cache_slot(phys) = it->second;
+    return it->second;
+}
+
+static JitBlock* jit_compile(uint32_t ea, uint32_t phys) {
+    if (jit_code_buf + JIT_CODE_SIZE - jit_code_ptr < JIT_MAX_BLOCK_CODE)
+        jit_flush();
+
+    PredecodedInstr* instrs = ppc_predecode_lookup(ea);
+
+    // self-modifying code is left to the interpreter
+    if (ppc_predecode_is_live(instrs))
+        return nullptr;
+
+    uint32_t num_instrs = std::min<uint32_t>(JIT_MAX_BLOCK_INSTRS,
+                                             (PAGE_SIZE - (phys & (PAGE_SIZE - 1))) >> 2);
+
+    auto blk   = std::make_unique<JitBlock>();
+    blk->phys  = phys;
+    blk->valid = true;
+
+    JitCompiler compiler(blk.get(), jit_code_ptr);
+    blk->code = compiler.compile(instrs, num_instrs);
+    jit_code_ptr = compiler.code_end();
+
+    JitBlock* result = blk.get();
+    jit_blocks[phys] = result;
+    jit_page_blocks[phys & PAGE_MASK].push_back(result);
+    jit_cache_slot(phys) = result;
+    jit_storage.push_back(std::move(blk));
+    return result;
+}
+
+/* ============================ execution ============================ */
+
+static void jit_gen_trampolines() {
+    X64Emitter e;
+    e.ptr = jit_code_buf;
+
+    // uintptr_t jit_enter(const uint8_t* code)
+    jit_enter = (JitEnterFunc)e.ptr;
+    e.push(RBP);
+    e.push(RBX);
+    e.push(R12);
+    e.push(R13);
+    e.push(R14);
+    e.push(R15);
+    e.alu_imm(ALU_SUB, RSP, 8, true); // align the stack for calls
+    e.mov_imm64(RBX, uint64_t(&ppc_state));
+    e.mov_imm64(R12, uint64_t(&g_icycles));
+    e.mov_imm64(R13, uint64_t(&jit_max_cycles));
+    static_assert(sizeof(exec_timer) == 1, "exec_timer is read as a byte");
+    e.mov_imm64(R14, uint64_t(&exec_timer));
+    e.mov_imm64(R15, uint64_t(&pCurDTLB1));
+    e.jmp_reg(RDI);
+
+    jit_epilogue = e.ptr;
+    e.alu_imm(ALU_ADD, RSP, 8, true);
+    e.pop(R15);
+    e.pop(R14);
+    e.pop(R13);
+    e.pop(R12);
+    e.pop(RBX);
+    e.pop(RBP);
+    e.ret();
+
+    jit_stub_events = e.ptr;
+    e.mov_imm(RAX, JIT_EXIT_EVENTS);
+    e.jmp_to(jit_epilogue);
+
+    jit_stub_resolve = e.ptr;
+    e.mov_imm(RAX, JIT_EXIT_RESOLVE);
+    e.jmp_to(jit_epilogue);
+
+    jit_code_base = e.ptr;
+}
+
+bool ppc_jit_init() {
+    if (jit_init_done)
+        return jit_code_buf != nullptr;
+
+    jit_init_done = true;
+
+    void* buf = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        LOG_F(ERROR, "JIT: could not allocate executable memory");
+        return false;
+    }
+
+    jit_code_buf = (uint8_t*)buf;
+    jit_gen_trampolines();
+    jit_init_op_table();
+    jit_flush();
+
+#ifdef PPC_FASTMEM
+    jit_fastmem = fastmem_init();
+    if (!jit_fastmem)
+        LOG_F(WARNING, "JIT: fastmem not available");
+#endif
+
+    return true;
+}
+
+// Interpret instructions up to the next branch, page boundary or goal_addr.
+template <bool until>
+static void jit_interpret(uint32_t goal_addr) {
+    PredecodedInstr* pd_instr = ppc_predecode_lookup(ppc_state.pc);
+    uint32_t pd_gen = predecode_gen;
+
+    do {
+        ppc_exec_predecoded(pd_instr);
+        if (g_icycles++ >= jit_max_cycles || exec_timer) {
+            jit_max_cycles = process_events();
+        }
+        if (exec_flags) {
+            ppc_state.pc = ppc_next_instruction_address;
+            exec_flags = 0;
+            return;
+        }
+        ppc_state.pc += 4;
+        pd_instr++;
+    } while ((ppc_state.pc & (PAGE_SIZE - 1)) && pd_gen == predecode_gen &&
+             power_on && !(until && ppc_state.pc == goal_addr));
+}
+
+// Tell if goal_addr may be reached in the middle of the block.
+static inline bool jit_block_has_goal(const JitBlock* blk, uint32_t goal_addr) {
+    uint32_t ofs = (goal_addr - blk->phys) & (PAGE_SIZE - 1);
+    return ofs < blk->num_instrs * 4 &&
+           ((blk->phys & (PAGE_SIZE - 1)) + ofs) < PAGE_SIZE;
+}
+
+template <bool until>
+static void ppc_exec_jit_loop(uint32_t goal_addr) {
+    JitLink* last_link = nullptr;
+    uint32_t phys_addr;
+
+    // links created for another goal may skip over this one
+    if (until && (!jit_link_until || jit_link_goal != goal_addr))
+        jit_unlink_all();
+    jit_link_until = until;
+    jit_link_goal  = goal_addr;
+
+    jit_max_cycles = 0;
+    exec_flags     = 0;
+
+#ifdef PPC_FASTMEM
+    fastmem_sync();
+#endif
+
+    while (power_on) {
+        if (mmu_translate_imem(ppc_state.pc, &phys_addr) == nullptr) {
+            // instruction fetch raised ISI
+            ppc_state.pc = ppc_next_instruction_address;
+            exec_flags = 0;
+            last_link  = nullptr;
+            if (until && ppc_state.pc == goal_addr)
+                return;
+            continue;
+        }
+
+        JitBlock* blk = jit_find_block(phys_addr);
+        if (blk == nullptr) {
+            uint32_t flush_count = jit_flush_count;
+            blk = jit_compile(ppc_state.pc, phys_addr);
+            if (flush_count != jit_flush_count)
+                last_link = nullptr;
+        }
+
+        if (blk == nullptr || (until && ppc_state.pc != goal_addr &&
+                               goal_addr - ppc_state.pc < blk->num_instrs * 4)) {
+            jit_interpret<until>(goal_addr);
+            last_link = nullptr;
+        } else {
+            if (last_link) {
+                if (last_link->src->valid && !last_link->target &&
+                    (last_link->src->phys & PAGE_MASK) == (phys_addr & PAGE_MASK) &&
+                    !(until && jit_block_has_goal(blk, goal_addr)))
+                    jit_link(last_link, blk);
+                last_link = nullptr;
+            }
+
+            uintptr_t status = jit_enter(blk->code);
+
+            switch (status) {
+            case JIT_EXIT_EVENTS:
+                // deliver interrupts at the start of the next block
+                exec_flags = EXEF_BRANCH;
+                ppc_next_instruction_address = ppc_state.pc;
+                jit_max_cycles = process_events();
+                if (exec_flags & EXEF_EXCEPTION)
+                    ppc_state.pc = ppc_next_instruction_address;
+                exec_flags = 0;
+#ifdef PPC_FASTMEM
+                // memory controllers may have changed the memory map
+                fastmem_sync();
+#endif
+                break;
+            case JIT_EXIT_RESOLVE:
+                if (exec_flags)
+                    ppc_state.pc = ppc_next_instruction_address;
+                else
+                    ppc_state.pc += 4;
+                exec_flags = 0;
+                break;
+            case JIT_EXIT_BRANCH:
+                break;
+            default:
+                last_link = (JitLink*)status;
+            }
+        }
+
+        if (until && ppc_state.pc == goal_addr)
+            return;
+    }
+}
+
+void ppc_exec_jit_inner() {
+    if (!ppc_jit_init()) {
+        LOG_F(WARNING, "JIT: falling back to the interpreter");
+        exec_mode = interpreter;
+        return;
+    }
+    ppc_exec_jit_loop<false>(0);
+}
+
+void ppc_exec_jit_until_inner(uint32_t goal_addr) {
+    if (!ppc_jit_init()) {
+        LOG_F(WARNING, "JIT: falling back to the interpreter");
+        exec_mode = interpreter;
+        return;
+    }
+    ppc_exec_jit_loop<true>(goal_addr);
+}
+
+#else // PPC_JIT
+
+bool ppc_jit_init() {
+    return false;
+}
+
+void ppc_jit_invalidate_page(uint32_t phys_tag) {
+}
+
+#endif // PPC_JIT
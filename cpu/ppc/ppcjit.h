@@ -0,0 +1,91 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Dynamic recompiler for x86-64 hosts.
+
+    Guest code is translated one basic block at a time from the predecoded
+    instruction cache. Instructions the recompiler doesn't know about
+    are compiled into calls to their interpreter handlers.
+ */
+
+#ifndef PPC_JIT_H
+#define PPC_JIT_H
+
+#include <cinttypes>
+
+/* The recompiler emits x86-64 code into an executable mmap() region. */
+#if defined(__x86_64__) && defined(__linux__)
+#define PPC_JIT
+#endif
+
+/* Compiled loads and stores access guest memory mapped into host address
+   windows. Comment this out to make them go through the soft TLB only. */
+#ifdef PPC_JIT
+#define PPC_FASTMEM
+#endif
+
+/** Set up the code buffer. Returns false if the JIT isn't available. */
+extern bool ppc_jit_init();
+
+/** Drop all compiled blocks located in the specified physical page. */
+extern void ppc_jit_invalidate_page(uint32_t phys_tag);
+
+#ifdef PPC_JIT
+extern void ppc_exec_jit_inner();
+extern void ppc_exec_jit_until_inner(uint32_t goal_addr);
+#endif
+
+#ifdef PPC_FASTMEM
+/** Host window of the current data translation mode.
+    Guest memory is accessible at fastmem_base + effective address. */
+extern uint8_t* fastmem_base;
+
+/** Reserve the host windows. Returns false if fastmem isn't available. */
+extern bool fastmem_init();
+
+/** Rebuild all windows before they're used next, e.g. after a machine change. */
+extern void fastmem_reset();
+
+/** Make sure the window of the current translation mode is up to date. */
+extern void fastmem_sync();
+
+/** Switch to the window of the given DTLB mode (see mmu_change_mode()). */
+extern void fastmem_change_mode(uint8_t mmu_mode);
+
+/** Rebuild the windows of translated modes after a DBAT change. */
+extern void fastmem_bats_changed();
+
+/** Write-protect or unprotect all window pages mapping a code page. */
+extern void fastmem_watch_code_page(uint32_t phys_tag);
+extern void fastmem_unwatch_code_page(uint32_t phys_tag);
+
+/** Write-protect the window pages of a physical range after its pages
+    became clean, or unprotect them once they're dirty again. */
+extern void fastmem_dirty_change(uint32_t start_addr, uint32_t size, bool is_clean);
+
+/** Register a fastmem access in compiled code. If the instruction
+    at fault_ip faults, execution continues at fallback and site
+    is patched into a jump to fallback. */
+extern void fastmem_add_site(uint8_t* fault_ip, uint8_t* site, uint8_t* fallback);
+extern void fastmem_clear_sites();
+#endif
+
+#endif // PPC_JIT_H
@@ -25,16 +25,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/mmiodevice.h>
 #include <memaccess.h>
 #include "ppcemu.h"
+#include "ppcjit.h"
 #include "ppcmmu.h"
+#include "ppcpredecode.h"
 
+#include <algorithm>
 #include <array>
 #include <cinttypes>
+#include <iterator>
 #include <loguru.hpp>
 #include <stdexcept>
 
-//#define MMU_PROFILING // uncomment this to enable MMU profiling
-//#define TLB_PROFILING // uncomment this to enable SoftTLB profiling
-
 /* pointer to exception handler to be called when a MMU exception is occurred. */
 void (*mmu_exception_handler)(Except_Type exception_type, uint32_t srr1_bits);
 
@@ -73,6 +74,12 @@ uint64_t    num_primary_dtlb_hits   = 0; // number of hits in the primary DTLB
 uint64_t    num_secondary_dtlb_hits = 0; // number of hits in the secondary DTLB
 uint64_t    num_dtlb_refills        = 0; // number of DTLB refills
 uint64_t    num_entry_replacements  = 0; // number of entry replacements
+uint64_t    num_btc_hits            = 0; // number of branch target cache hits
+uint64_t    num_ras_hits            = 0; // number of return address stack hits
+uint64_t    num_pte_cache_hits      = 0; // number of PTEs found in the PTE cache
+uint64_t    num_pte_cache_misses    = 0; // number of PTE cache misses
+uint64_t    num_pteg_probes_saved   = 0; // number of PTEG searches avoided
+uint64_t    num_bat_range_refills   = 0; // number of TLB refills from BAT ranges
 
 #endif // TLB_PROFILING
 
@@ -132,6 +139,7 @@ static BATResult ppc_block_address_translation(uint32_t la)
 {
     uint32_t pa = 0;    // translated physical address
     uint8_t  prot = 0;  // protection bits for the translated address
+    uint32_t hi_mask = 0;
     PPC_BAT_entry *bat_array;
 
     bool bat_hit    = false;
@@ -156,11 +164,12 @@ static BATResult ppc_block_address_translation(uint32_t la)
             // logical to physical translation
             pa = bat_entry->phys_hi | (la & ~bat_entry->hi_mask);
             prot = bat_entry->prot;
+            hi_mask = bat_entry->hi_mask;
             break;
         }
     }
 
-    return BATResult{bat_hit, prot, pa};
+    return BATResult{bat_hit, prot, pa, hi_mask};
 }
 
 static inline uint8_t* calc_pteg_addr(uint32_t hash)
@@ -188,6 +197,80 @@ static inline uint8_t* calc_pteg_addr(uint32_t hash)
     }
 }
 
+/** Page table walk cache.
+
+    Remembers where the PTE for a VSID/page index pair was found so that
+    repeated translations of the same page (e.g. after a TLB flush caused
+    by a segment register update) don't need to search the PTEGs again.
+    Sets are selected by the low-order bits of the page index, so tlbie
+    can drop all entries for an EA regardless of the VSID.
+
+    Cached PTEs are verified against guest memory before use, so changes
+    to the page table by guest stores are caught without write-protecting
+    the hash table.
+ */
+#define PTE_CACHE_SETS  1024
+#define PTE_CACHE_WAYS  4
+
+typedef struct PTECacheEntry {
+    uint32_t    pte_check; // first PTE word incl. the H bit, 0 = invalid
+    uint8_t*    pte_addr;  // host address of the PTE
+} PTECacheEntry;
+
+static std::array<PTECacheEntry, PTE_CACHE_SETS * PTE_CACHE_WAYS> pte_cache;
+
+static inline PTECacheEntry* pte_cache_set(uint32_t page_index)
+{
+    return &pte_cache[(page_index & (PTE_CACHE_SETS - 1)) * PTE_CACHE_WAYS];
+}
+
+static inline uint8_t* pte_cache_lookup(uint32_t vsid, uint32_t page_index)
+{
+    // the primary hash PTE check word, H bit masked out
+    const uint32_t pte_check = 0x80000000 | (vsid << 7) | (page_index >> 10);
+
+    PTECacheEntry* set = pte_cache_set(page_index);
+    for (int i = 0; i < PTE_CACHE_WAYS; i++) {
+        if ((set[i].pte_check & ~0x40U) == pte_check &&
+            READ_DWORD_BE_A(set[i].pte_addr) == set[i].pte_check) {
+#ifdef TLB_PROFILING
+            num_pte_cache_hits++;
+            num_pteg_probes_saved += 1 + ((set[i].pte_check >> 6) & 1);
+#endif
+            return set[i].pte_addr;
+        }
+    }
+#ifdef TLB_PROFILING
+    num_pte_cache_misses++;
+#endif
+    return nullptr;
+}
+
+static inline void pte_cache_insert(uint32_t page_index, uint8_t* pte_addr)
+{
+    PTECacheEntry* set = pte_cache_set(page_index);
+
+    // drop the oldest way
+    for (int i = PTE_CACHE_WAYS - 1; i > 0; i--)
+        set[i] = set[i - 1];
+
+    set[0].pte_check = READ_DWORD_BE_A(pte_addr);
+    set[0].pte_addr  = pte_addr;
+}
+
+static void pte_cache_flush_set(uint32_t ea)
+{
+    PTECacheEntry* set = pte_cache_set(ea >> 12);
+    for (int i = 0; i < PTE_CACHE_WAYS; i++)
+        set[i].pte_check = 0;
+}
+
+static void pte_cache_flush()
+{
+    for (auto& entry : pte_cache)
+        entry.pte_check = 0;
+}
+
 static bool search_pteg(uint8_t* pteg_addr, uint8_t** ret_pte_addr, uint32_t vsid,
                         uint16_t page_index, uint8_t pteg_num)
 {
@@ -249,22 +332,28 @@ static PATResult page_address_translation(uint32_t la, bool is_instr_fetch,
     /* instruction fetch from a no-execute segment will cause ISI exception */
     if ((sr_val & 0x10000000) && is_instr_fetch) {
         mmu_exception_handler(Except_Type::EXC_ISI, 0x10000000);
+        return PATResult{};
     }
 
     page_index = (la >> 12) & 0xFFFF;
     pteg_hash1 = (sr_val & 0x7FFFF) ^ page_index;
     vsid       = sr_val & 0x0FFFFFF;
 
-    if (!search_pteg(calc_pteg_addr(pteg_hash1), &pte_addr, vsid, page_index, 0)) {
-        if (!search_pteg(calc_pteg_addr(~pteg_hash1), &pte_addr, vsid, page_index, 1)) {
-            if (is_instr_fetch) {
-                mmu_exception_handler(Except_Type::EXC_ISI, 0x40000000);
-            } else {
-                ppc_state.spr[SPR::DSISR] = 0x40000000 | (is_write << 25);
-                ppc_state.spr[SPR::DAR]   = la;
-                mmu_exception_handler(Except_Type::EXC_DSI, 0);
+    pte_addr = pte_cache_lookup(vsid, page_index);
+    if (!pte_addr) {
+        if (!search_pteg(calc_pteg_addr(pteg_hash1), &pte_addr, vsid, page_index, 0)) {
+            if (!search_pteg(calc_pteg_addr(~pteg_hash1), &pte_addr, vsid, page_index, 1)) {
+                if (is_instr_fetch) {
+                    mmu_exception_handler(Except_Type::EXC_ISI, 0x40000000);
+                } else {
+                    ppc_state.spr[SPR::DSISR] = 0x40000000 | (is_write << 25);
+                    ppc_state.spr[SPR::DAR]   = la;
+                    mmu_exception_handler(Except_Type::EXC_DSI, 0);
+                }
+                return PATResult{};
             }
         }
+        pte_cache_insert(page_index, pte_addr);
     }
 
     pte_word2 = READ_DWORD_BE_A(pte_addr + 4);
@@ -286,6 +375,7 @@ static PATResult page_address_translation(uint32_t la, bool is_instr_fetch,
             ppc_state.spr[SPR::DAR]   = la;
             mmu_exception_handler(Except_Type::EXC_DSI, 0);
         }
+        return PATResult{};
     }
 
     /* update R and C bits */
@@ -335,10 +425,17 @@ MapDmaResult mmu_map_dma_mem(uint32_t addr, uint32_t size, bool allow_mmio) {
     return MapDmaResult{cur_dma_rgn->type, is_writable, host_va, devobj, dev_base};
 }
 
+// Called by DMA engines after they stored data to guest RAM.
+void mmu_dma_mem_written(uint32_t addr, uint32_t size) {
+    // DMA may overwrite predecoded guest code
+    ppc_predecode_invalidate_range(addr, size);
+    mem_ctrl_instance->mark_pages_dirty(addr, size);
+}
+
 // primary ITLB for all MMU modes
-static std::array<TLBEntry, TLB_SIZE> itlb1_mode1;
-static std::array<TLBEntry, TLB_SIZE> itlb1_mode2;
-static std::array<TLBEntry, TLB_SIZE> itlb1_mode3;
+static TLB1 itlb1_mode1;
+static TLB1 itlb1_mode2;
+static TLB1 itlb1_mode3;
 
 // secondary ITLB for all MMU modes
 static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> itlb2_mode1;
@@ -346,22 +443,56 @@ static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> itlb2_mode2;
 static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> itlb2_mode3;
 
 // primary DTLB for all MMU modes
-static std::array<TLBEntry, TLB_SIZE> dtlb1_mode1;
-static std::array<TLBEntry, TLB_SIZE> dtlb1_mode2;
-static std::array<TLBEntry, TLB_SIZE> dtlb1_mode3;
+static TLB1 dtlb1_mode1;
+static TLB1 dtlb1_mode2;
+static TLB1 dtlb1_mode3;
 
 // secondary DTLB for all MMU modes
 static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> dtlb2_mode1;
 static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> dtlb2_mode2;
 static std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> dtlb2_mode3;
 
-TLBEntry *pCurITLB1; // current primary ITLB
+TLB1     *pCurITLB1; // current primary ITLB
 TLBEntry *pCurITLB2; // current secondary ITLB
-TLBEntry *pCurDTLB1; // current primary DTLB
+TLB1     *pCurDTLB1; // current primary DTLB
 TLBEntry *pCurDTLB2; // current secondary DTLB
 
 uint32_t tlb_size_mask = TLB_SIZE - 1;
 
+uint32_t tlb1_gen = 0;
+
+// Flushing secondary TLB entries by class starts a new epoch of that class,
+// indexed by TLBType. Entries from older epochs are dropped on lookup.
+static uint32_t tlb2_bat_epoch[2] = {1, 1};
+static uint32_t tlb2_pat_epoch[2] = {1, 1};
+
+// Update flags of a primary TLB entry along with its write tag.
+static inline void tlb1_set_flags(TLB1 &tlb1, uint32_t idx, uint16_t flags)
+{
+    tlb1.flags[idx] = flags;
+    if ((flags & (TLBFlags::PAGE_WRITABLE | TLBFlags::PTE_SET_C | TLBFlags::PAGE_CODE |
+                  TLBFlags::PAGE_CLEAN)) == (TLBFlags::PAGE_WRITABLE | TLBFlags::PTE_SET_C))
+        tlb1.write_tag[idx] = tlb1.tag[idx];
+    else
+        tlb1.write_tag[idx] = TLB_INVALID_TAG;
+}
+
+// Refill a primary DTLB entry from a secondary TLB entry.
+static inline void dtlb1_refill(TLB1 &tlb1, uint32_t idx, uint32_t tag, const TLBEntry *tlb2_entry)
+{
+    uint16_t flags = tlb2_entry->flags;
+
+    tlb1.tag[idx]            = tag | tlb1_gen;
+    tlb1.host_va_offs_r[idx] = tlb2_entry->host_va_offs_r;
+    tlb1.host_va_offs_w[idx] = tlb2_entry->host_va_offs_w;
+    tlb1.phys_tag[idx]       = tlb2_entry->phys_tag;
+    if (ppc_predecode_is_watched(tlb2_entry->phys_tag))
+        flags |= TLBFlags::PAGE_CODE;
+    if (mem_ctrl_instance->is_page_clean((uint8_t *)(tlb2_entry->host_va_offs_w + tag)))
+        flags |= TLBFlags::PAGE_CLEAN;
+    tlb1_set_flags(tlb1, idx, flags);
+}
+
 // fake TLB entry for handling of unmapped memory accesses
 uint64_t    UnmappedVal = -1ULL;
 TLBEntry    UnmappedMem = {TLB_INVALID_TAG, TLBFlags::PAGE_NOPHYS, 0, 0};
@@ -372,6 +503,101 @@ static std::array<uint64_t, 4096 / sizeof(uint64_t)> dummy_page;
 uint8_t     CurITLBMode = {0xFF}; // current ITLB mode
 uint8_t     CurDTLBMode = {0xFF}; // current DTLB mode
 
+/** Part of a BAT block backed by a single host memory region.
+
+    Primary TLB misses inside such a range are refilled directly from it
+    without a secondary TLB lookup. This saves a secondary TLB refill per
+    page when sweeping through large blocks. Ranges are recorded by the
+    secondary TLB refill code and dropped whenever BAT entries are flushed.
+
+    601 BATs aren't handled here because their validity also depends
+    on the segment registers.
+ */
+typedef struct BATRange {
+    uint32_t    ea_start;
+    uint32_t    ea_end;         // inclusive
+    int64_t     host_va_offs_r;
+    uint32_t    pa_offs;        // physical address - effective address
+    uint16_t    flags;
+    bool        is_rom;         // writes go to the dummy page
+} BATRange;
+
+#define BAT_RANGES  4
+
+// most recently recorded BAT ranges indexed by TLBType and TLB mode
+static BATRange bat_ranges[2][4][BAT_RANGES];
+
+template <const TLBType tlb_type>
+static inline const BATRange* bat_range_lookup(uint32_t guest_va)
+{
+    const uint8_t mode = (tlb_type == TLBType::ITLB) ? CurITLBMode : CurDTLBMode;
+
+    for (const BATRange& range : bat_ranges[tlb_type][mode & 3]) {
+        if (guest_va >= range.ea_start && guest_va <= range.ea_end) {
+#ifdef TLB_PROFILING
+            num_bat_range_refills++;
+#endif
+            return &range;
+        }
+    }
+    return nullptr;
+}
+
+template <const TLBType tlb_type>
+static void bat_range_record(uint32_t guest_va, const BATResult& bat_res,
+                             const AddressMapEntry* rgn_desc, uint16_t flags)
+{
+    if (!bat_res.hi_mask)
+        return;
+
+    BATRange* ranges = bat_ranges[tlb_type][
+        ((tlb_type == TLBType::ITLB) ? CurITLBMode : CurDTLBMode) & 3];
+
+    // drop the oldest range
+    for (int i = BAT_RANGES - 1; i > 0; i--)
+        ranges[i] = ranges[i - 1];
+
+    // intersect the block with the host memory region
+    ranges[0].ea_start = (uint32_t)std::max<int64_t>(guest_va & bat_res.hi_mask,
+        (int64_t)guest_va - (bat_res.phys - rgn_desc->start));
+    ranges[0].ea_end   = (uint32_t)std::min<int64_t>(guest_va | ~bat_res.hi_mask,
+        (int64_t)guest_va + (rgn_desc->end - bat_res.phys));
+    ranges[0].host_va_offs_r = (int64_t)rgn_desc->mem_ptr - guest_va +
+                               (bat_res.phys - rgn_desc->start);
+    ranges[0].pa_offs  = bat_res.phys - guest_va;
+    ranges[0].flags    = flags;
+    ranges[0].is_rom   = rgn_desc->type == RT_ROM;
+}
+
+template <const TLBType tlb_type>
+static void bat_range_flush()
+{
+    for (auto& mode_ranges : bat_ranges[tlb_type]) {
+        for (BATRange& range : mode_ranges) {
+            range.ea_start = 1;
+            range.ea_end   = 0;
+        }
+    }
+}
+
+// Refill a primary DTLB entry from a BAT range.
+static inline void dtlb1_refill(TLB1 &tlb1, uint32_t idx, uint32_t guest_va, const BATRange *range)
+{
+    const uint32_t tag      = guest_va & ~0xFFFUL;
+    const uint32_t phys_tag = (guest_va + range->pa_offs) & ~0xFFFUL;
+    uint16_t flags = range->flags;
+
+    tlb1.tag[idx]            = tag | tlb1_gen;
+    tlb1.host_va_offs_r[idx] = range->host_va_offs_r;
+    tlb1.host_va_offs_w[idx] = range->is_rom ? (int64_t)&dummy_page - tag : range->host_va_offs_r;
+    tlb1.phys_tag[idx]       = phys_tag;
+    if (ppc_predecode_is_watched(phys_tag))
+        flags |= TLBFlags::PAGE_CODE;
+    if (mem_ctrl_instance->is_page_clean((uint8_t *)(tlb1.host_va_offs_w[idx] + tag)))
+        flags |= TLBFlags::PAGE_CLEAN;
+    tlb1_set_flags(tlb1, idx, flags);
+}
+
 void mmu_change_mode()
 {
     uint8_t mmu_mode;
@@ -382,11 +608,11 @@ void mmu_change_mode()
     if (CurITLBMode != mmu_mode) {
         switch(mmu_mode) {
             case 0: // real address mode
-                pCurITLB1 = &itlb1_mode1[0];
+                pCurITLB1 = &itlb1_mode1;
                 pCurITLB2 = &itlb2_mode1[0];
                 break;
             case 2: // supervisor mode with instruction translation enabled
-                pCurITLB1 = &itlb1_mode2[0];
+                pCurITLB1 = &itlb1_mode2;
                 pCurITLB2 = &itlb2_mode2[0];
                 break;
             case 1:
@@ -394,7 +620,7 @@ void mmu_change_mode()
                 //LOG_F(ERROR, "instruction mmu mode 1 is invalid!"); // this happens alot. Maybe it's not invalid?
                 mmu_mode = 3;
             case 3: // user mode with instruction translation enabled
-                pCurITLB1 = &itlb1_mode3[0];
+                pCurITLB1 = &itlb1_mode3;
                 pCurITLB2 = &itlb2_mode3[0];
                 break;
         }
@@ -407,11 +633,11 @@ void mmu_change_mode()
     if (CurDTLBMode != mmu_mode) {
         switch(mmu_mode) {
             case 0: // real address mode
-                pCurDTLB1 = &dtlb1_mode1[0];
+                pCurDTLB1 = &dtlb1_mode1;
                 pCurDTLB2 = &dtlb2_mode1[0];
                 break;
             case 2: // supervisor mode with data translation enabled
-                pCurDTLB1 = &dtlb1_mode2[0];
+                pCurDTLB1 = &dtlb1_mode2;
                 pCurDTLB2 = &dtlb2_mode2[0];
                 break;
             case 1:
@@ -419,14 +645,27 @@ void mmu_change_mode()
                 LOG_F(ERROR, "data mmu mode 1 is invalid!");
                 mmu_mode = 3;
             case 3: // user mode with data translation enabled
-                pCurDTLB1 = &dtlb1_mode3[0];
+                pCurDTLB1 = &dtlb1_mode3;
                 pCurDTLB2 = &dtlb2_mode3[0];
                 break;
         }
         CurDTLBMode = mmu_mode;
+#ifdef PPC_FASTMEM
+        fastmem_change_mode(mmu_mode);
+#endif
     }
 }
 
+template <const TLBType tlb_type>
+static inline uint32_t tlb2_class_epoch(uint16_t flags)
+{
+    if (flags & TLBFlags::TLBE_FROM_BAT)
+        return tlb2_bat_epoch[tlb_type];
+    if (flags & TLBFlags::TLBE_FROM_PAT)
+        return tlb2_pat_epoch[tlb_type];
+    return 0; // real addressing mode entries are never flushed by class
+}
+
 template <const TLBType tlb_type>
 static TLBEntry* tlb2_target_entry(uint32_t gp_va)
 {
@@ -523,12 +762,15 @@ static TLBEntry* itlb2_refill(uint32_t guest_va)
             // only PP = 0 (no access) causes ISI exception
             if (!bat_res.prot) {
                 mmu_exception_handler(Except_Type::EXC_ISI, 0x08000000);
+                return nullptr;
             }
             phys_addr = bat_res.phys;
             flags |= TLBFlags::TLBE_FROM_BAT; // tell the world we come from
         } else {
             // page address translation
             PATResult pat_res = page_address_translation(guest_va, true, !!(ppc_state.msr & MSR::PR), 0);
+            if (ppc_exc_aborted())
+                return nullptr;
             phys_addr = pat_res.phys;
             flags = TLBFlags::TLBE_FROM_PAT; // tell the world we come from
         }
@@ -547,9 +789,12 @@ static TLBEntry* itlb2_refill(uint32_t guest_va)
         tlb_entry = tlb2_target_entry<TLBType::ITLB>(tag);
         tlb_entry->tag = tag;
         tlb_entry->flags = flags | TLBFlags::PAGE_MEM;
+        tlb_entry->epoch = tlb2_class_epoch<TLBType::ITLB>(flags);
         tlb_entry->host_va_offs_r = (int64_t)rgn_desc->mem_ptr - guest_va +
                                     (phys_addr - rgn_desc->start);
         tlb_entry->phys_tag = phys_addr & ~0xFFFUL;
+        if (flags & TLBFlags::TLBE_FROM_BAT)
+            bat_range_record<TLBType::ITLB>(guest_va, bat_res, rgn_desc, tlb_entry->flags);
     } else {
         ABORT_F("Instruction fetch from unmapped memory at 0x%08X!\n", phys_addr);
     }
@@ -584,6 +829,7 @@ static TLBEntry* dtlb2_refill(uint32_t guest_va, int is_write, bool is_dbg = fal
                 ppc_state.spr[SPR::DSISR] = 0x08000000 | (is_write << 25);
                 ppc_state.spr[SPR::DAR]   = guest_va;
                 mmu_exception_handler(Except_Type::EXC_DSI, 0);
+                return nullptr;
             }
             phys_addr = bat_res.phys;
             flags = TLBFlags::PTE_SET_C; // prevent PTE.C updates for BAT
@@ -594,6 +840,8 @@ static TLBEntry* dtlb2_refill(uint32_t guest_va, int is_write, bool is_dbg = fal
         } else {
             // page address translation
             PATResult pat_res = page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), is_write);
+            if (ppc_exc_aborted())
+                return nullptr;
             phys_addr = pat_res.phys;
             flags = TLBFlags::TLBE_FROM_PAT; // tell the world we come from
             if (pat_res.prot <= 2 || pat_res.prot == 6) {
@@ -617,6 +865,7 @@ static TLBEntry* dtlb2_refill(uint32_t guest_va, int is_write, bool is_dbg = fal
         // refill the secondary TLB
         tlb_entry = tlb2_target_entry<TLBType::DTLB>(tag);
         tlb_entry->tag = tag;
+        tlb_entry->epoch = tlb2_class_epoch<TLBType::DTLB>(flags);
         if (rgn_desc->type & RT_MMIO) { // MMIO region
             tlb_entry->flags = flags | TLBFlags::PAGE_IO;
             tlb_entry->rgn_desc = rgn_desc;
@@ -631,6 +880,8 @@ static TLBEntry* dtlb2_refill(uint32_t guest_va, int is_write, bool is_dbg = fal
             } else {
                 tlb_entry->host_va_offs_w = tlb_entry->host_va_offs_r;
             }
+            if (flags & TLBFlags::TLBE_FROM_BAT)
+                bat_range_record<TLBType::DTLB>(guest_va, bat_res, rgn_desc, tlb_entry->flags);
         }
         tlb_entry->phys_tag = phys_addr & ~0xFFFUL;
         return tlb_entry;
@@ -661,6 +912,14 @@ static inline TLBEntry* lookup_secondary_tlb(uint32_t guest_va, uint32_t tag) {
         tlb_entry = &pCurDTLB2[((guest_va >> PAGE_SIZE_BITS) & tlb_size_mask) * TLB2_WAYS];
     }
 
+    // drop entries flushed since they were filled
+    // so tlb2_target_entry() can reuse them as well
+    for (int i = 0; i < TLB2_WAYS; i++) {
+        if (tlb_entry[i].tag != TLB_INVALID_TAG &&
+            tlb_entry[i].epoch != tlb2_class_epoch<tlb_type>(tlb_entry[i].flags))
+            tlb_entry[i].tag = TLB_INVALID_TAG;
+    }
+
     if (tlb_entry->tag == tag) {
         // update LRU bits
         tlb_entry[0].lru_bits  = 0x3;
@@ -696,7 +955,7 @@ static inline TLBEntry* lookup_secondary_tlb(uint32_t guest_va, uint32_t tag) {
 
 uint8_t *mmu_translate_imem(uint32_t vaddr, uint32_t *paddr)
 {
-    TLBEntry *tlb1_entry, *tlb2_entry;
+    TLBEntry *tlb2_entry;
     uint8_t *host_va;
 
 #ifdef MMU_PROFILING
@@ -706,12 +965,19 @@ uint8_t *mmu_translate_imem(uint32_t vaddr, uint32_t *paddr)
     const uint32_t tag = vaddr & ~0xFFFUL;
 
     // look up guest virtual address in the primary ITLB
-    tlb1_entry = &pCurITLB1[(vaddr >> PAGE_SIZE_BITS) & tlb_size_mask];
-    if (tlb1_entry->tag == tag) { // primary ITLB hit -> fast path
+    const uint32_t idx = (vaddr >> PAGE_SIZE_BITS) & tlb_size_mask;
+    if (pCurITLB1->tag[idx] == (tag | tlb1_gen)) { // primary ITLB hit -> fast path
 #ifdef TLB_PROFILING
         num_primary_itlb_hits++;
 #endif
-        host_va = (uint8_t *)(tlb1_entry->host_va_offs_r + vaddr);
+        host_va = (uint8_t *)(pCurITLB1->host_va_offs_r[idx] + vaddr);
+    } else if (const BATRange* range = bat_range_lookup<TLBType::ITLB>(vaddr)) {
+        // primary ITLB miss inside a BAT block -> refill from the BAT range
+        pCurITLB1->tag[idx]            = tag | tlb1_gen;
+        pCurITLB1->flags[idx]          = range->flags;
+        pCurITLB1->host_va_offs_r[idx] = range->host_va_offs_r;
+        pCurITLB1->phys_tag[idx]       = (vaddr + range->pa_offs) & ~0xFFFUL;
+        host_va = (uint8_t *)(range->host_va_offs_r + vaddr);
     } else {
         // primary ITLB miss -> look up address in the secondary ITLB
         tlb2_entry = lookup_secondary_tlb<TLBType::ITLB>(vaddr, tag);
@@ -722,6 +988,8 @@ uint8_t *mmu_translate_imem(uint32_t vaddr, uint32_t *paddr)
             // secondary ITLB miss ->
             // perform full address translation and refill the secondary ITLB
             tlb2_entry = itlb2_refill(vaddr);
+            if (tlb2_entry == nullptr)
+                return nullptr;
         }
 #ifdef TLB_PROFILING
         else {
@@ -729,25 +997,26 @@ uint8_t *mmu_translate_imem(uint32_t vaddr, uint32_t *paddr)
         }
 #endif
         // refill the primary ITLB
-        tlb1_entry->tag = tag;
-        tlb1_entry->flags = tlb2_entry->flags;
-        tlb1_entry->host_va_offs_r = tlb2_entry->host_va_offs_r;
-        tlb1_entry->phys_tag = tlb2_entry->phys_tag;
-        host_va = (uint8_t *)(tlb1_entry->host_va_offs_r + vaddr);
+        pCurITLB1->tag[idx]            = tag | tlb1_gen;
+        pCurITLB1->flags[idx]          = tlb2_entry->flags;
+        pCurITLB1->host_va_offs_r[idx] = tlb2_entry->host_va_offs_r;
+        pCurITLB1->phys_tag[idx]       = tlb2_entry->phys_tag;
+        host_va = (uint8_t *)(tlb2_entry->host_va_offs_r + vaddr);
     }
 
     ppc_set_cur_instruction(host_va);
     if (paddr)
-        *paddr = tlb1_entry->phys_tag | (vaddr & 0xFFFUL);
+        *paddr = pCurITLB1->phys_tag[idx] | (vaddr & 0xFFFUL);
 
     return host_va;
 }
 
-static void tlb_flush_primary_entry(std::array<TLBEntry, TLB_SIZE> &tlb1, uint32_t tag)
+static void tlb_flush_primary_entry(TLB1 &tlb1, uint32_t tag)
 {
-    TLBEntry *tlb_entry = &tlb1[(tag >> PAGE_SIZE_BITS) & tlb_size_mask];
-    if (tlb_entry->tag == tag) {
-        tlb_entry->tag = TLB_INVALID_TAG;
+    const uint32_t idx = (tag >> PAGE_SIZE_BITS) & tlb_size_mask;
+    if (tlb1.tag[idx] == (tag | tlb1_gen)) {
+        tlb1.tag[idx]       = TLB_INVALID_TAG;
+        tlb1.write_tag[idx] = TLB_INVALID_TAG;
         //LOG_F(INFO, "Invalidated primary TLB entry at 0x%X", ea);
     }
 }
@@ -766,6 +1035,8 @@ static void tlb_flush_secondary_entry(std::array<TLBEntry, TLB_SIZE*TLB2_WAYS> &
 void tlb_flush_entry(uint32_t ea)
 {
     const uint32_t tag = ea & ~0xFFFUL;
+    ppc_predecode_flush_targets();
+    pte_cache_flush_set(ea);
     tlb_flush_primary_entry(itlb1_mode1, tag);
     tlb_flush_secondary_entry(itlb2_mode1, tag);
     tlb_flush_primary_entry(itlb1_mode2, tag);
@@ -780,6 +1051,27 @@ void tlb_flush_entry(uint32_t ea)
     tlb_flush_secondary_entry(dtlb2_mode3, tag);
 }
 
+static void tlb_watch_code_page(TLB1 &tlb1, uint32_t phys_tag)
+{
+    for (uint32_t idx = 0; idx < TLB_SIZE; idx++) {
+        if (tlb1.tag[idx] != TLB_INVALID_TAG && (tlb1.flags[idx] & TLBFlags::PAGE_MEM) &&
+            tlb1.phys_tag[idx] == phys_tag) {
+            tlb1_set_flags(tlb1, idx, tlb1.flags[idx] | TLBFlags::PAGE_CODE);
+        }
+    }
+}
+
+/** Make the primary DTLB entries mapping a code page trap writes to it. */
+void mmu_watch_code_page(uint32_t phys_tag)
+{
+    tlb_watch_code_page(dtlb1_mode1, phys_tag);
+    tlb_watch_code_page(dtlb1_mode2, phys_tag);
+    tlb_watch_code_page(dtlb1_mode3, phys_tag);
+#ifdef PPC_FASTMEM
+    fastmem_watch_code_page(phys_tag);
+#endif
+}
+
 template <std::size_t N>
 static void tlb_flush_entries(std::array<TLBEntry, N> &tlb, TLBFlags type) {
     for (auto &tlb_el : tlb) {
@@ -789,27 +1081,60 @@ static void tlb_flush_entries(std::array<TLBEntry, N> &tlb, TLBFlags type) {
     }
 }
 
+static void tlb_invalidate_tags(TLB1 &tlb1) {
+    std::fill(std::begin(tlb1.tag), std::end(tlb1.tag), TLB_INVALID_TAG);
+    std::fill(std::begin(tlb1.write_tag), std::end(tlb1.write_tag), TLB_INVALID_TAG);
+}
+
+// Make all primary TLB entries miss by starting a new generation.
+static void tlb1_new_gen()
+{
+    tlb1_gen = (tlb1_gen + TLB1_GEN_STEP) & TLB1_GEN_MASK;
+    if (!tlb1_gen) {
+        // generation numbers wrapped around -> drop old entries for real
+        tlb_invalidate_tags(itlb1_mode1);
+        tlb_invalidate_tags(itlb1_mode2);
+        tlb_invalidate_tags(itlb1_mode3);
+        tlb_invalidate_tags(dtlb1_mode1);
+        tlb_invalidate_tags(dtlb1_mode2);
+        tlb_invalidate_tags(dtlb1_mode3);
+    }
+}
+
+template <const TLBType tlb_type>
+static void tlb2_new_epoch(uint32_t &epoch, TLBFlags type)
+{
+    if (!++epoch) {
+        // epoch numbers wrapped around -> drop old entries for real
+        if (tlb_type == TLBType::ITLB) {
+            tlb_flush_entries(itlb2_mode1, type);
+            tlb_flush_entries(itlb2_mode2, type);
+            tlb_flush_entries(itlb2_mode3, type);
+        } else {
+            tlb_flush_entries(dtlb2_mode1, type);
+            tlb_flush_entries(dtlb2_mode2, type);
+            tlb_flush_entries(dtlb2_mode3, type);
+        }
+        epoch = 1;
+    }
+}
+
 template <const TLBType tlb_type>
 void tlb_flush_entries(TLBFlags type)
 {
-    TLBEntry *m1_tlb, *m2_tlb, *m3_tlb;
-    int i;
+    if (tlb_type == TLBType::ITLB)
+        ppc_predecode_flush_targets();
 
-    if (tlb_type == TLBType::ITLB) {
-        tlb_flush_entries(itlb1_mode1, type);
-        tlb_flush_entries(itlb1_mode2, type);
-        tlb_flush_entries(itlb1_mode3, type);
-        tlb_flush_entries(itlb2_mode1, type);
-        tlb_flush_entries(itlb2_mode2, type);
-        tlb_flush_entries(itlb2_mode3, type);
-    } else {
-        tlb_flush_entries(dtlb1_mode1, type);
-        tlb_flush_entries(dtlb1_mode2, type);
-        tlb_flush_entries(dtlb1_mode3, type);
-        tlb_flush_entries(dtlb2_mode1, type);
-        tlb_flush_entries(dtlb2_mode2, type);
-        tlb_flush_entries(dtlb2_mode3, type);
+    // secondary TLB entries of the flushed classes are dropped on lookup
+    if (type & TLBFlags::TLBE_FROM_BAT) {
+        tlb2_new_epoch<tlb_type>(tlb2_bat_epoch[tlb_type], TLBFlags::TLBE_FROM_BAT);
+        bat_range_flush<tlb_type>();
     }
+    if (type & TLBFlags::TLBE_FROM_PAT)
+        tlb2_new_epoch<tlb_type>(tlb2_pat_epoch[tlb_type], TLBFlags::TLBE_FROM_PAT);
+
+    // primary TLB entries are cheap to refill so they're all dropped
+    tlb1_new_gen();
 }
 
 bool gTLBFlushIBatEntries = false;
@@ -830,6 +1155,9 @@ void tlb_flush_bat_entries()
             return;
         tlb_flush_entries<TLBType::DTLB>(TLBE_FROM_BAT);
         gTLBFlushDBatEntries = false;
+#ifdef PPC_FASTMEM
+        fastmem_bats_changed();
+#endif
     }
 }
 
@@ -861,6 +1189,10 @@ void tlb_flush_all_entries()
     } else {
         if (!gTLBFlushDBatEntries && !gTLBFlushDPatEntries)
             return;
+#ifdef PPC_FASTMEM
+        if (gTLBFlushDBatEntries)
+            fastmem_bats_changed();
+#endif
         tlb_flush_entries<TLBType::DTLB>((TLBFlags)(TLBE_FROM_BAT | TLBE_FROM_PAT));
         gTLBFlushDBatEntries = false;
         gTLBFlushDPatEntries = false;
@@ -959,6 +1291,13 @@ static void ppc_dbat_update(uint32_t bat_reg)
 
 }
 
+void mmu_sdr1_changed()
+{
+    // cached PTE locations point into the old page table
+    pte_cache_flush();
+    mmu_pat_ctx_changed();
+}
+
 void mmu_pat_ctx_changed()
 {
     // Page address translation context changed so we need to flush
@@ -978,20 +1317,24 @@ template <class T>
 static void write_unaligned(uint32_t guest_va, uint8_t *host_va, T value);
 
 template <class T>
-inline T mmu_read_vmem(uint32_t guest_va)
+T mmu_read_vmem_slow(uint32_t guest_va)
 {
-    TLBEntry *tlb1_entry, *tlb2_entry;
+    TLBEntry *tlb2_entry;
     uint8_t *host_va;
 
     const uint32_t tag = guest_va & ~0xFFFUL;
 
     // look up guest virtual address in the primary TLB
-    tlb1_entry = &pCurDTLB1[(guest_va >> PAGE_SIZE_BITS) & tlb_size_mask];
-    if (tlb1_entry->tag == tag) { // primary TLB hit -> fast path
+    const uint32_t idx = (guest_va >> PAGE_SIZE_BITS) & tlb_size_mask;
+    if (pCurDTLB1->tag[idx] == (tag | tlb1_gen)) { // primary TLB hit -> fast path
 #ifdef TLB_PROFILING
         num_primary_dtlb_hits++;
 #endif
-        host_va = (uint8_t *)(tlb1_entry->host_va_offs_r + guest_va);
+        host_va = (uint8_t *)(pCurDTLB1->host_va_offs_r[idx] + guest_va);
+    } else if (const BATRange* range = bat_range_lookup<TLBType::DTLB>(guest_va)) {
+        // primary TLB miss inside a BAT block -> refill from the BAT range
+        dtlb1_refill(*pCurDTLB1, idx, guest_va, range);
+        host_va = (uint8_t *)(range->host_va_offs_r + guest_va);
     } else {
         // primary TLB miss -> look up address in the secondary TLB
         tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
@@ -1002,6 +1345,8 @@ inline T mmu_read_vmem(uint32_t guest_va)
             // secondary TLB miss ->
             // perform full address translation and refill the secondary TLB
             tlb2_entry = dtlb2_refill(guest_va, 0);
+            if (tlb2_entry == nullptr)
+                return 0;
             if (tlb2_entry->flags & PAGE_NOPHYS) {
                 return (T)UnmappedVal;
             }
@@ -1014,15 +1359,18 @@ inline T mmu_read_vmem(uint32_t guest_va)
 
         if (tlb2_entry->flags & TLBFlags::PAGE_MEM) { // is it a real memory region?
             // refill the primary TLB
-            *tlb1_entry = *tlb2_entry;
-            host_va = (uint8_t *)(tlb1_entry->host_va_offs_r + guest_va);
+            dtlb1_refill(*pCurDTLB1, idx, tag, tlb2_entry);
+            host_va = (uint8_t *)(tlb2_entry->host_va_offs_r + guest_va);
         } else { // otherwise, it's an access to a memory-mapped device
 #ifdef MMU_PROFILING
             iomem_reads_total++;
 #endif
             if (sizeof(T) == 8) {
-                if (guest_va & 3)
+                if (guest_va & 3) {
                     ppc_alignment_exception(guest_va);
+                    if (ppc_exc_aborted())
+                        return 0;
+                }
 
                 return (
                     ((T)tlb2_entry->rgn_desc->devobj->read(tlb2_entry->rgn_desc->start,
@@ -1065,35 +1413,39 @@ inline T mmu_read_vmem(uint32_t guest_va)
     }
 }
 
-// explicitely instantiate all required mmu_read_vmem variants
-template uint8_t  mmu_read_vmem<uint8_t>(uint32_t guest_va);
-template uint16_t mmu_read_vmem<uint16_t>(uint32_t guest_va);
-template uint32_t mmu_read_vmem<uint32_t>(uint32_t guest_va);
-template uint64_t mmu_read_vmem<uint64_t>(uint32_t guest_va);
+// explicitely instantiate all required mmu_read_vmem_slow variants
+template uint8_t  mmu_read_vmem_slow<uint8_t>(uint32_t guest_va);
+template uint16_t mmu_read_vmem_slow<uint16_t>(uint32_t guest_va);
+template uint32_t mmu_read_vmem_slow<uint32_t>(uint32_t guest_va);
+template uint64_t mmu_read_vmem_slow<uint64_t>(uint32_t guest_va);
 
 template <class T>
-inline void mmu_write_vmem(uint32_t guest_va, T value)
+void mmu_write_vmem_slow(uint32_t guest_va, T value)
 {
-    TLBEntry *tlb1_entry, *tlb2_entry;
+    TLBEntry *tlb2_entry;
     uint8_t *host_va;
 
     const uint32_t tag = guest_va & ~0xFFFUL;
 
     // look up guest virtual address in the primary TLB
-    tlb1_entry = &pCurDTLB1[(guest_va >> PAGE_SIZE_BITS) & tlb_size_mask];
-    if (tlb1_entry->tag == tag) { // primary TLB hit -> fast path
+    const uint32_t idx = (guest_va >> PAGE_SIZE_BITS) & tlb_size_mask;
+    if (pCurDTLB1->tag[idx] == (tag | tlb1_gen)) { // primary TLB hit -> fast path
 #ifdef TLB_PROFILING
         num_primary_dtlb_hits++;
 #endif
-        if (!(tlb1_entry->flags & TLBFlags::PAGE_WRITABLE)) {
+        uint16_t flags = pCurDTLB1->flags[idx];
+        if (!(flags & TLBFlags::PAGE_WRITABLE)) {
             ppc_state.spr[SPR::DSISR] = 0x08000000 | (1 << 25);
             ppc_state.spr[SPR::DAR]   = guest_va;
             mmu_exception_handler(Except_Type::EXC_DSI, 0);
+            return;
         }
-        if (!(tlb1_entry->flags & TLBFlags::PTE_SET_C)) {
+        if (!(flags & TLBFlags::PTE_SET_C)) {
             // perform full page address translation to update PTE.C bit
             page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
-            tlb1_entry->flags |= TLBFlags::PTE_SET_C;
+            if (ppc_exc_aborted())
+                return;
+            flags |= TLBFlags::PTE_SET_C;
 
             // don't forget to update the secondary TLB as well
             tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
@@ -1101,7 +1453,26 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
                 tlb2_entry->flags |= TLBFlags::PTE_SET_C;
             }
         }
-        host_va = (uint8_t *)(tlb1_entry->host_va_offs_w + guest_va);
+        if (flags & TLBFlags::PAGE_CODE) {
+            // drop predecoded instructions of the page being modified
+            ppc_predecode_invalidate(pCurDTLB1->phys_tag[idx]);
+            flags &= ~TLBFlags::PAGE_CODE;
+        }
+        if (flags & TLBFlags::PAGE_CLEAN) {
+            // first write to the page since its dirty state was harvested
+            mem_ctrl_instance->mark_pages_dirty(
+                (uint8_t *)(pCurDTLB1->host_va_offs_w[idx] + tag), PAGE_SIZE);
+            flags &= ~TLBFlags::PAGE_CLEAN;
+        }
+        tlb1_set_flags(*pCurDTLB1, idx, flags);
+        host_va = (uint8_t *)(pCurDTLB1->host_va_offs_w[idx] + guest_va);
+    } else if (const BATRange* range = bat_range_lookup<TLBType::DTLB>(guest_va);
+               range && (range->flags & TLBFlags::PAGE_WRITABLE)) {
+        // primary TLB miss inside a writable BAT block -> refill from the BAT range
+        ppc_predecode_invalidate((guest_va + range->pa_offs) & ~0xFFFUL);
+        mem_ctrl_instance->mark_pages_dirty((uint8_t *)(range->host_va_offs_r + tag), PAGE_SIZE);
+        dtlb1_refill(*pCurDTLB1, idx, guest_va, range);
+        host_va = (uint8_t *)(pCurDTLB1->host_va_offs_w[idx] + guest_va);
     } else {
         // primary TLB miss -> look up address in the secondary TLB
         tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
@@ -1112,6 +1483,8 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
             // secondary TLB miss ->
             // perform full address translation and refill the secondary TLB
             tlb2_entry = dtlb2_refill(guest_va, 1);
+            if (tlb2_entry == nullptr)
+                return;
             if (tlb2_entry->flags & PAGE_NOPHYS) {
                 return;
             }
@@ -1126,25 +1499,34 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
             ppc_state.spr[SPR::DSISR] = 0x08000000 | (1 << 25);
             ppc_state.spr[SPR::DAR]   = guest_va;
             mmu_exception_handler(Except_Type::EXC_DSI, 0);
+            return;
         }
 
         if (!(tlb2_entry->flags & TLBFlags::PTE_SET_C)) {
             // perform full page address translation to update PTE.C bit
             page_address_translation(guest_va, false, !!(ppc_state.msr & MSR::PR), true);
+            if (ppc_exc_aborted())
+                return;
             tlb2_entry->flags |= TLBFlags::PTE_SET_C;
         }
 
         if (tlb2_entry->flags & TLBFlags::PAGE_MEM) { // is it a real memory region?
             // refill the primary TLB
-            *tlb1_entry = *tlb2_entry;
-            host_va = (uint8_t *)(tlb1_entry->host_va_offs_w + guest_va);
+            ppc_predecode_invalidate(tlb2_entry->phys_tag);
+            mem_ctrl_instance->mark_pages_dirty((uint8_t *)(tlb2_entry->host_va_offs_w + tag),
+                                                PAGE_SIZE);
+            dtlb1_refill(*pCurDTLB1, idx, tag, tlb2_entry);
+            host_va = (uint8_t *)(tlb2_entry->host_va_offs_w + guest_va);
         } else { // otherwise, it's an access to a memory-mapped device
 #ifdef MMU_PROFILING
             iomem_writes_total++;
 #endif
             if (sizeof(T) == 8) {
-                if (guest_va & 3)
+                if (guest_va & 3) {
                     ppc_alignment_exception(guest_va);
+                    if (ppc_exc_aborted())
+                        return;
+                }
 
                 tlb2_entry->rgn_desc->devobj->write(tlb2_entry->rgn_desc->start,
                                                     static_cast<uint32_t>(guest_va - tlb2_entry->dev_base_va),
@@ -1188,11 +1570,11 @@ inline void mmu_write_vmem(uint32_t guest_va, T value)
     }
 }
 
-// explicitely instantiate all required mmu_write_vmem variants
-template void mmu_write_vmem<uint8_t>(uint32_t guest_va,   uint8_t value);
-template void mmu_write_vmem<uint16_t>(uint32_t guest_va, uint16_t value);
-template void mmu_write_vmem<uint32_t>(uint32_t guest_va, uint32_t value);
-template void mmu_write_vmem<uint64_t>(uint32_t guest_va, uint64_t value);
+// explicitely instantiate all required mmu_write_vmem_slow variants
+template void mmu_write_vmem_slow<uint8_t>(uint32_t guest_va,   uint8_t value);
+template void mmu_write_vmem_slow<uint16_t>(uint32_t guest_va, uint16_t value);
+template void mmu_write_vmem_slow<uint32_t>(uint32_t guest_va, uint32_t value);
+template void mmu_write_vmem_slow<uint64_t>(uint32_t guest_va, uint64_t value);
 
 template <class T>
 static T read_unaligned(uint32_t guest_va, uint8_t *host_va)
@@ -1200,6 +1582,8 @@ static T read_unaligned(uint32_t guest_va, uint8_t *host_va)
     if ((sizeof(T) == 8) && (guest_va & 3)) {
 #ifndef PPC_TESTS
         ppc_alignment_exception(guest_va);
+        if (ppc_exc_aborted())
+            return 0;
 #endif
     }
 
@@ -1215,6 +1599,8 @@ static T read_unaligned(uint32_t guest_va, uint8_t *host_va)
         // presumably very rare so don't waste time optimizing the code below.
         for (int i = 0; i < sizeof(T); guest_va++, i++) {
             result = (result << 8) | mmu_read_vmem<uint8_t>(guest_va);
+            if (ppc_exc_aborted())
+                return 0;
         }
     } else {
 #ifdef MMU_PROFILING
@@ -1245,6 +1631,8 @@ static void write_unaligned(uint32_t guest_va, uint8_t *host_va, T value)
     if ((sizeof(T) == 8) && (guest_va & 3)) {
 #ifndef PPC_TESTS
         ppc_alignment_exception(guest_va);
+        if (ppc_exc_aborted())
+            return;
 #endif
     }
 
@@ -1261,6 +1649,8 @@ static void write_unaligned(uint32_t guest_va, uint8_t *host_va, T value)
 
         for (int i = 0; i < sizeof(T); shift -= 8, guest_va++, i++) {
             mmu_write_vmem<uint8_t>(guest_va, (value >> shift) & 0xFF);
+            if (ppc_exc_aborted())
+                return;
         }
     } else {
 #ifdef MMU_PROFILING
@@ -1403,6 +1793,30 @@ public:
         vars.push_back({.name = "Number of replaced TLB entries",
             .format = ProfileVarFmt::DEC,
             .value = num_entry_replacements});
+
+        vars.push_back({.name = "ITLB lookups avoided (branch target cache)",
+            .format = ProfileVarFmt::DEC,
+            .value = num_btc_hits});
+
+        vars.push_back({.name = "ITLB lookups avoided (return address stack)",
+            .format = ProfileVarFmt::DEC,
+            .value = num_ras_hits});
+
+        vars.push_back({.name = "Number of hits in the PTE cache",
+            .format = ProfileVarFmt::DEC,
+            .value = num_pte_cache_hits});
+
+        vars.push_back({.name = "Number of PTE cache misses",
+            .format = ProfileVarFmt::DEC,
+            .value = num_pte_cache_misses});
+
+        vars.push_back({.name = "PTEG searches avoided (PTE cache)",
+            .format = ProfileVarFmt::DEC,
+            .value = num_pteg_probes_saved});
+
+        vars.push_back({.name = "Number of TLB refills from BAT ranges",
+            .format = ProfileVarFmt::DEC,
+            .value = num_bat_range_refills});
     };
 
     void reset() {
@@ -1410,6 +1824,12 @@ public:
         num_secondary_dtlb_hits = 0;
         num_dtlb_refills        = 0;
         num_entry_replacements = 0;
+        num_btc_hits = 0;
+        num_ras_hits = 0;
+        num_pte_cache_hits    = 0;
+        num_pte_cache_misses  = 0;
+        num_pteg_probes_saved = 0;
+        num_bat_range_refills = 0;
     };
 };
 #endif
@@ -1468,15 +1888,18 @@ bool mmu_translate_dbg(uint32_t guest_va, uint32_t &guest_pa) {
     mmu_exception_handler = dbg_exception_handler;
 
     try {
-        TLBEntry *tlb1_entry, *tlb2_entry;
+        TLBEntry *tlb2_entry;
+        uint32_t phys_tag;
 
         const uint32_t tag = guest_va & ~0xFFFUL;
 
         // look up guest virtual address in the primary TLB
-        tlb1_entry = &pCurDTLB1[(guest_va >> PAGE_SIZE_BITS) & tlb_size_mask];
+        const uint32_t idx = (guest_va >> PAGE_SIZE_BITS) & tlb_size_mask;
 
         do {
-            if (tlb1_entry->tag != tag) {
+            if (pCurDTLB1->tag[idx] == (tag | tlb1_gen)) {
+                phys_tag = pCurDTLB1->phys_tag[idx];
+            } else {
                 // primary TLB miss -> look up address in the secondary TLB
                 tlb2_entry = lookup_secondary_tlb<TLBType::DTLB>(guest_va, tag);
                 if (tlb2_entry == nullptr) {
@@ -1491,13 +1914,11 @@ bool mmu_translate_dbg(uint32_t guest_va, uint32_t &guest_pa) {
 
                 if (tlb2_entry->flags & TLBFlags::PAGE_MEM) { // is it a real memory region?
                     // refill the primary TLB
-                    *tlb1_entry = *tlb2_entry;
-                }
-                else {
-                    tlb1_entry = tlb2_entry;
+                    dtlb1_refill(*pCurDTLB1, idx, tag, tlb2_entry);
                 }
+                phys_tag = tlb2_entry->phys_tag;
             }
-            guest_pa = tlb1_entry->phys_tag | (guest_va & 0xFFFUL);
+            guest_pa = phys_tag | (guest_va & 0xFFFUL);
             is_mapped = true;
         } while (0);
     } catch (std::invalid_argument& exc) {
@@ -1513,6 +1934,14 @@ bool mmu_translate_dbg(uint32_t guest_va, uint32_t &guest_pa) {
     return is_mapped;
 }
 
+static void invalidate_tlb_entries(TLB1 &tlb1) {
+    tlb_invalidate_tags(tlb1);
+    std::fill(std::begin(tlb1.host_va_offs_r), std::end(tlb1.host_va_offs_r), 0);
+    std::fill(std::begin(tlb1.host_va_offs_w), std::end(tlb1.host_va_offs_w), 0);
+    std::fill(std::begin(tlb1.phys_tag), std::end(tlb1.phys_tag), 0);
+    std::fill(std::begin(tlb1.flags), std::end(tlb1.flags), 0);
+}
+
 template <std::size_t N>
 static void invalidate_tlb_entries(std::array<TLBEntry, N> &tlb) {
     for (auto &tlb_el : tlb) {
@@ -1522,10 +1951,31 @@ static void invalidate_tlb_entries(std::array<TLBEntry, N> &tlb) {
         tlb_el.host_va_offs_r = 0;
         tlb_el.host_va_offs_w = 0;
         tlb_el.phys_tag = 0;
-        tlb_el.reserved = 0;
+        tlb_el.epoch = 0;
     }
 }
 
+// Regions of the physical address map have been added, moved or removed
+// (e.g. by a PCI BAR write). Drop all translations caching the old map,
+// including those of the real addressing mode.
+void mmu_phys_map_changed()
+{
+    last_dma_area = {0xFFFFFFFF, 0xFFFFFFFF, 0, 0, nullptr, nullptr};
+    last_ptab_area = {0xFFFFFFFF, 0xFFFFFFFF, 0, 0, nullptr, nullptr};
+
+    invalidate_tlb_entries(itlb2_mode1);
+    invalidate_tlb_entries(itlb2_mode2);
+    invalidate_tlb_entries(itlb2_mode3);
+    invalidate_tlb_entries(dtlb2_mode1);
+    invalidate_tlb_entries(dtlb2_mode2);
+    invalidate_tlb_entries(dtlb2_mode3);
+
+    bat_range_flush<TLBType::ITLB>();
+    bat_range_flush<TLBType::DTLB>();
+    ppc_predecode_flush_targets();
+    tlb1_new_gen();
+}
+
 void ppc_mmu_init()
 {
     last_read_area  = {0xFFFFFFFF, 0xFFFFFFFF, 0, 0, nullptr, nullptr};
@@ -1536,6 +1986,20 @@ void ppc_mmu_init()
 
     mmu_exception_handler = ppc_exception_handler;
 
+    mem_ctrl_instance->notify_dirty_change = [](uint32_t start_addr, uint32_t size,
+                                                bool is_clean) {
+        // primary DTLB entries check for clean pages when they're refilled
+        if (is_clean)
+            tlb1_new_gen();
+#ifdef PPC_FASTMEM
+        fastmem_dirty_change(start_addr, size, is_clean);
+#endif
+    };
+
+    pte_cache_flush();
+    bat_range_flush<TLBType::ITLB>();
+    bat_range_flush<TLBType::DTLB>();
+
     if (is_601) {
         // use 601-style unified BATs
         ibat_update = &mpc601_bat_update;
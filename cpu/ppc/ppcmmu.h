@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define PPCMMU_H
 
 #include <devices/memctrl/memctrlbase.h>
+#include <memaccess.h>
 
 #include <cinttypes>
 #include <functional>
@@ -34,6 +35,10 @@ class MMIODevice;
 /* Uncomment this to exhaustive MMU integrity checks. */
 //#define MMU_INTEGRITY_CHECKS
 
+//#define TLB_PROFILING // uncomment this to enable SoftTLB profiling
+
+//#define MMU_PROFILING // uncomment this to enable MMU profiling
+
 /** generic PowerPC BAT descriptor (MMU internal state) */
 typedef struct PPC_BAT_entry {
     bool        valid;   /* BAT entry valid for MPC601 */
@@ -61,6 +66,7 @@ typedef struct BATResult {
     bool        hit;
     uint8_t     prot;
     uint32_t    phys;
+    uint32_t    hi_mask; // block mask of the matching BAT, 0 for 601 BATs
 } BATResult;
 
 /** Result of the page address translation. */
@@ -88,6 +94,12 @@ typedef struct MapDmaResult {
 #define TLB2_WAYS           4
 #define TLB_INVALID_TAG     0xFFFFFFFF
 
+/* Primary TLB entries keep the generation they were filled in
+   in tag bits 3...10. Bit 11 stays clear so that no lookup key
+   can ever equal TLB_INVALID_TAG. */
+#define TLB1_GEN_STEP       (1 << 3)
+#define TLB1_GEN_MASK       0x7F8
+
 typedef struct TLBEntry {
     uint32_t    tag;
     uint16_t    flags;
@@ -103,7 +115,7 @@ typedef struct TLBEntry {
         };
     };
     uint32_t phys_tag;
-    uint32_t reserved;
+    uint32_t epoch; // flush epoch of the BAT/PAT class at refill time
 } TLBEntry;
 
 enum TLBFlags : uint16_t {
@@ -114,25 +126,121 @@ enum TLBFlags : uint16_t {
     TLBE_FROM_PAT = 1 << 4, // TLB entry has been translated with PAT
     PAGE_WRITABLE = 1 << 5, // page is writable
     PTE_SET_C     = 1 << 6, // tells if C bit of the PTE needs to be updated
+    PAGE_CODE     = 1 << 7, // page contains predecoded instructions
+    PAGE_CLEAN    = 1 << 8, // page not written since its dirty state was harvested
 };
 
+/** Primary TLB stored as separate arrays so that a lookup only touches
+    the cache lines holding its tag and its host offset.
+
+    write_tag mirrors tag for entries that can be written without further
+    checks, i.e. writable pages with PTE.C already set, no predecoded
+    code and already marked dirty. It's TLB_INVALID_TAG for all other entries.
+ */
+typedef struct TLB1 {
+    uint32_t    tag[TLB_SIZE];
+    uint32_t    write_tag[TLB_SIZE];
+    int64_t     host_va_offs_r[TLB_SIZE];
+    int64_t     host_va_offs_w[TLB_SIZE];
+    uint32_t    phys_tag[TLB_SIZE];
+    uint16_t    flags[TLB_SIZE];
+} TLB1;
+
+#ifdef TLB_PROFILING
+extern uint64_t num_btc_hits; // ITLB lookups avoided by the branch target cache
+extern uint64_t num_ras_hits; // ITLB lookups avoided by the return address stack
+#endif
+
+/** Primary data TLB for the current translation mode. */
+extern TLB1* pCurDTLB1;
+
+/** Current primary TLB generation. Flushing TLB entries starts
+    a new one, making all older primary TLB entries miss. */
+extern uint32_t tlb1_gen;
+
+extern PPC_BAT_entry dbat_array[4];
+
 extern std::function<void(uint32_t bat_reg)> ibat_update;
 extern std::function<void(uint32_t bat_reg)> dbat_update;
 
 extern MapDmaResult mmu_map_dma_mem(uint32_t addr, uint32_t size, bool allow_mmio);
+extern void mmu_dma_mem_written(uint32_t addr, uint32_t size);
 
 extern void mmu_change_mode(void);
 extern void mmu_pat_ctx_changed();
+extern void mmu_sdr1_changed();
+extern void mmu_phys_map_changed();
 extern void tlb_flush_entry(uint32_t ea);
+extern void mmu_watch_code_page(uint32_t phys_tag);
 
 extern uint64_t mem_read_dbg(uint32_t virt_addr, uint32_t size);
 uint8_t *mmu_translate_imem(uint32_t vaddr, uint32_t *paddr = nullptr);
 bool mmu_translate_dbg(uint32_t guest_va, uint32_t &guest_pa);
 
 template <class T>
-extern T mmu_read_vmem(uint32_t guest_va);
+extern T mmu_read_vmem_slow(uint32_t guest_va);
+template <class T>
+extern void mmu_write_vmem_slow(uint32_t guest_va, T value);
+
+/** Read a value from guest virtual memory.
+    Aligned accesses hitting the primary DTLB are handled inline.
+    Misses, MMIO and unaligned accesses go to mmu_read_vmem_slow().
+ */
 template <class T>
-extern void mmu_write_vmem(uint32_t guest_va, T value);
+inline T mmu_read_vmem(uint32_t guest_va)
+{
+#if !defined(MMU_PROFILING) && !defined(TLB_PROFILING)
+    const uint32_t idx = (guest_va >> PAGE_SIZE_BITS) & (TLB_SIZE - 1);
+
+    // tags never match unaligned addresses
+    if (pCurDTLB1->tag[idx] == ((guest_va & (uint32_t)(PAGE_MASK | (sizeof(T) - 1))) | tlb1_gen)) {
+        uint8_t* host_va = (uint8_t*)(pCurDTLB1->host_va_offs_r[idx] + guest_va);
+        switch (sizeof(T)) {
+        case 1:
+            return *host_va;
+        case 2:
+            return READ_WORD_BE_A(host_va);
+        case 4:
+            return READ_DWORD_BE_A(host_va);
+        case 8:
+            return READ_QWORD_BE_A(host_va);
+        }
+    }
+#endif
+    return mmu_read_vmem_slow<T>(guest_va);
+}
+
+/** Write a value to guest virtual memory.
+    Aligned accesses to writable pages from the primary DTLB are handled
+    inline unless PTE.C needs to be updated or the page contains code.
+ */
+template <class T>
+inline void mmu_write_vmem(uint32_t guest_va, T value)
+{
+#if !defined(MMU_PROFILING) && !defined(TLB_PROFILING)
+    const uint32_t idx = (guest_va >> PAGE_SIZE_BITS) & (TLB_SIZE - 1);
+
+    if (pCurDTLB1->write_tag[idx] == ((guest_va & (uint32_t)(PAGE_MASK | (sizeof(T) - 1))) | tlb1_gen)) {
+        uint8_t* host_va = (uint8_t*)(pCurDTLB1->host_va_offs_w[idx] + guest_va);
+        switch (sizeof(T)) {
+        case 1:
+            *host_va = value;
+            break;
+        case 2:
+            WRITE_WORD_BE_A(host_va, value);
+            break;
+        case 4:
+            WRITE_DWORD_BE_A(host_va, value);
+            break;
+        case 8:
+            WRITE_QWORD_BE_A(host_va, value);
+            break;
+        }
+        return;
+    }
+#endif
+    mmu_write_vmem_slow<T>(guest_va, value);
+}
 
 //====================== Deprecated calls =========================
 #if 0
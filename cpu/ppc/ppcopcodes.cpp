@@ -731,6 +731,7 @@ void dppc_interpreter::ppc_mtsr() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     int reg_s             = (ppc_cur_instruction >> 21) & 0x1F;
     uint32_t grab_sr      = (ppc_cur_instruction >> 16) & 0x0F;
@@ -744,6 +745,7 @@ void dppc_interpreter::ppc_mtsrin() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     ppc_grab_regssb(ppc_cur_instruction);
     uint32_t grab_sr      = ppc_result_b >> 28;
@@ -757,6 +759,7 @@ void dppc_interpreter::ppc_mfsr() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     int reg_d            = (ppc_cur_instruction >> 21) & 0x1F;
     uint32_t grab_sr     = (ppc_cur_instruction >> 16) & 0x0F;
@@ -769,6 +772,7 @@ void dppc_interpreter::ppc_mfsrin() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     ppc_grab_regsdb(ppc_cur_instruction);
     uint32_t grab_sr     = ppc_result_b >> 28;
@@ -781,6 +785,7 @@ void dppc_interpreter::ppc_mfmsr() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     uint32_t reg_d       = (ppc_cur_instruction >> 21) & 0x1F;
     ppc_state.gpr[reg_d] = ppc_state.msr;
@@ -792,6 +797,7 @@ void dppc_interpreter::ppc_mtmsr() {
 #endif
     if (ppc_state.msr & MSR::PR) {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::NOT_ALLOWED);
+        return;
     }
     uint32_t reg_s = (ppc_cur_instruction >> 21) & 0x1F;
     ppc_state.msr = ppc_state.gpr[reg_s];
@@ -807,6 +813,8 @@ void dppc_interpreter::ppc_mtmsr() {
         ppc_exception_handler(Except_Type::EXC_DECR, 0);
     } else {
         mmu_change_mode();
+        if (ppc_state.msr & MSR::POW)
+            ppc_power_save();
     }
 }
 
@@ -941,7 +949,7 @@ void dppc_interpreter::ppc_mtspr() {
         ppc_state.spr[ref_spr] = val & 0xe000ff7f;
         break;
     case SPR::SDR1:
-        mmu_pat_ctx_changed(); // adapt to SDR1 changes
+        mmu_sdr1_changed();
         break;
     case SPR::RTCL_S:
         calc_rtcl_value();
@@ -1430,6 +1438,8 @@ void dppc_interpreter::ppc_dcbz() {
     // the following is not especially efficient but necessary
     // to make BlockZero under Mac OS 8.x and later to work
     mmu_write_vmem<uint64_t>(ppc_effective_address +  0, 0);
+    if (ppc_exc_aborted())
+        return;
     mmu_write_vmem<uint64_t>(ppc_effective_address +  8, 0);
     mmu_write_vmem<uint64_t>(ppc_effective_address + 16, 0);
     mmu_write_vmem<uint64_t>(ppc_effective_address + 24, 0);
@@ -1477,6 +1487,8 @@ void dppc_interpreter::ppc_stu() {
         ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
         ppc_effective_address += ppc_result_a;
         mmu_write_vmem<T>(ppc_effective_address, ppc_result_d);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
@@ -1496,6 +1508,8 @@ void dppc_interpreter::ppc_stux() {
     if (reg_a != 0) {
         ppc_effective_address = ppc_result_a + ppc_result_b;
         mmu_write_vmem<T>(ppc_effective_address, ppc_result_d);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.gpr[reg_a] = ppc_effective_address;
     } else {
         ppc_exception_handler(Except_Type::EXC_PROGRAM, Exc_Cause::ILLEGAL_OP);
@@ -1526,6 +1540,8 @@ void dppc_interpreter::ppc_stwcx() {
     ppc_state.cr |= (ppc_state.spr[SPR::XER] & XER::SO) >> 3; // copy XER[SO] to CR0[SO]
     if (ppc_state.reserve) {
         mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_result_d);
+        if (ppc_exc_aborted())
+            return;
         ppc_state.reserve = false;
         ppc_state.cr |= 0x20000000UL; // set CR0[EQ]
     }
@@ -1552,10 +1568,14 @@ void dppc_interpreter::ppc_stmw() {
     /* what should we do if EA is unaligned? */
     if (ppc_effective_address & 3) {
         ppc_alignment_exception(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
     }
 
     for (; reg_s <= 31; reg_s++) {
         mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_state.gpr[reg_s]);
+        if (ppc_exc_aborted())
+            return;
         ppc_effective_address += 4;
     }
 }
@@ -1569,6 +1589,8 @@ void dppc_interpreter::ppc_lz() {
     ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
     ppc_effective_address += reg_a ? ppc_result_a : 0;
     uint32_t ppc_result_d = mmu_read_vmem<T>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1586,6 +1608,8 @@ void dppc_interpreter::ppc_lzu() {
     if ((reg_a != reg_d) && reg_a != 0) {
         ppc_effective_address += ppc_result_a;
         uint32_t ppc_result_d = mmu_read_vmem<T>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         uint32_t ppc_result_a = ppc_effective_address;
         ppc_store_iresult_reg(reg_d, ppc_result_d);
         ppc_store_iresult_reg(reg_a, ppc_result_a);
@@ -1606,6 +1630,8 @@ void dppc_interpreter::ppc_lzx() {
     ppc_grab_regsdab(ppc_cur_instruction);
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     uint32_t ppc_result_d = mmu_read_vmem<T>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1622,6 +1648,8 @@ void dppc_interpreter::ppc_lzux() {
     if ((reg_a != reg_d) && reg_a != 0) {
         ppc_effective_address = ppc_result_a + ppc_result_b;
         uint32_t ppc_result_d = mmu_read_vmem<T>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_result_a          = ppc_effective_address;
         ppc_store_iresult_reg(reg_d, ppc_result_d);
         ppc_store_iresult_reg(reg_a, ppc_result_a);
@@ -1642,6 +1670,8 @@ void dppc_interpreter::ppc_lha() {
     ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
     ppc_effective_address += (reg_a ? ppc_result_a : 0);
     int16_t val = mmu_read_vmem<uint16_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, int32_t(val));
 }
 
@@ -1654,6 +1684,8 @@ void dppc_interpreter::ppc_lhau() {
         ppc_effective_address = int32_t(int16_t(ppc_cur_instruction));
         ppc_effective_address += ppc_result_a;
         int16_t val = mmu_read_vmem<uint16_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_store_iresult_reg(reg_d, int32_t(val));
         uint32_t ppc_result_a = ppc_effective_address;
         ppc_store_iresult_reg(reg_a, ppc_result_a);
@@ -1670,6 +1702,8 @@ void dppc_interpreter::ppc_lhaux() {
     if ((reg_a != reg_d) && reg_a != 0) {
         ppc_effective_address = ppc_result_a + ppc_result_b;
         int16_t val = mmu_read_vmem<uint16_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
         ppc_store_iresult_reg(reg_d, int32_t(val));
         uint32_t ppc_result_a = ppc_effective_address;
         ppc_store_iresult_reg(reg_a, ppc_result_a);
@@ -1686,6 +1720,8 @@ void dppc_interpreter::ppc_lhax() {
     ppc_grab_regsdab(ppc_cur_instruction);
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     int16_t val = mmu_read_vmem<uint16_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, int32_t(val));
 }
 
@@ -1696,6 +1732,8 @@ void dppc_interpreter::ppc_lhbrx() {
     ppc_grab_regsdab(ppc_cur_instruction);
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     uint32_t ppc_result_d = uint32_t(BYTESWAP_16(mmu_read_vmem<uint16_t>(ppc_effective_address)));
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1706,6 +1744,8 @@ void dppc_interpreter::ppc_lwbrx() {
     ppc_grab_regsdab(ppc_cur_instruction);
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     uint32_t ppc_result_d = BYTESWAP_32(mmu_read_vmem<uint32_t>(ppc_effective_address));
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1718,6 +1758,8 @@ void dppc_interpreter::ppc_lwarx() {
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     ppc_state.reserve     = true;
     uint32_t ppc_result_d = mmu_read_vmem<uint32_t>(ppc_effective_address);
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1730,7 +1772,10 @@ void dppc_interpreter::ppc_lmw() {
     ppc_effective_address += (reg_a ? ppc_result_a : 0);
     // How many words to load in memory - using a do-while for this
     do {
-       ppc_state.gpr[reg_d] = mmu_read_vmem<uint32_t>(ppc_effective_address);
+       uint32_t val = mmu_read_vmem<uint32_t>(ppc_effective_address);
+       if (ppc_exc_aborted())
+           return;
+       ppc_state.gpr[reg_d] = val;
        ppc_effective_address += 4;
        reg_d++;
     } while (reg_d < 32);
@@ -1745,8 +1790,13 @@ void dppc_interpreter::ppc_lswi() {
     uint32_t grab_inb     = (ppc_cur_instruction >> 11) & 0x1F;
     grab_inb              = grab_inb ? grab_inb : 32;
 
+    uint32_t val;
+
     while (grab_inb >= 4) {
-        ppc_state.gpr[reg_d] = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        val = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
+        ppc_state.gpr[reg_d] = val;
         reg_d++;
         if (reg_d >= 32) {    // wrap around through GPR0
             reg_d = 0;
@@ -1758,14 +1808,25 @@ void dppc_interpreter::ppc_lswi() {
     // handle remaining bytes
     switch (grab_inb) {
     case 1:
-        ppc_state.gpr[reg_d] = mmu_read_vmem<uint8_t>(ppc_effective_address) << 24;
+        val = mmu_read_vmem<uint8_t>(ppc_effective_address) << 24;
+        if (ppc_exc_aborted())
+            return;
+        ppc_state.gpr[reg_d] = val;
         break;
     case 2:
-        ppc_state.gpr[reg_d] = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+        val = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+        if (ppc_exc_aborted())
+            return;
+        ppc_state.gpr[reg_d] = val;
         break;
     case 3:
-        ppc_state.gpr[reg_d] = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
-        ppc_state.gpr[reg_d] += mmu_read_vmem<uint8_t>(ppc_effective_address + 2) << 8;
+        val = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+        if (ppc_exc_aborted())
+            return;
+        val |= mmu_read_vmem<uint8_t>(ppc_effective_address + 2) << 8;
+        if (ppc_exc_aborted())
+            return;
+        ppc_state.gpr[reg_d] = val;
         break;
     default:
         break;
@@ -1789,6 +1850,7 @@ void dppc_interpreter::ppc_lswx() {
 
     ppc_effective_address = ppc_result_b + (reg_a ? ppc_result_a : 0);
     uint32_t grab_inb      = ppc_state.spr[SPR::XER] & 0x7F;
+    uint32_t val;
 
     for (;;) {
         if (is_601 && (reg_d == reg_b || (reg_a != 0 && reg_d == reg_a))) {
@@ -1799,17 +1861,31 @@ void dppc_interpreter::ppc_lswx() {
         case 0:
             return;
         case 1:
-            ppc_state.gpr[reg_d] = mmu_read_vmem<uint8_t>(ppc_effective_address) << 24;
+            val = mmu_read_vmem<uint8_t>(ppc_effective_address) << 24;
+            if (ppc_exc_aborted())
+                return;
+            ppc_state.gpr[reg_d] = val;
             return;
         case 2:
-            ppc_state.gpr[reg_d] = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+            val = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+            if (ppc_exc_aborted())
+                return;
+            ppc_state.gpr[reg_d] = val;
             return;
         case 3:
-            ppc_state.gpr[reg_d] = (mmu_read_vmem<uint16_t>(ppc_effective_address) << 16)
-                                 | (mmu_read_vmem<uint8_t>(ppc_effective_address + 2) << 8);
+            val = mmu_read_vmem<uint16_t>(ppc_effective_address) << 16;
+            if (ppc_exc_aborted())
+                return;
+            val |= mmu_read_vmem<uint8_t>(ppc_effective_address + 2) << 8;
+            if (ppc_exc_aborted())
+                return;
+            ppc_state.gpr[reg_d] = val;
             return;
         }
-        ppc_state.gpr[reg_d] = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        val = mmu_read_vmem<uint32_t>(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
+        ppc_state.gpr[reg_d] = val;
         reg_d = (reg_d + 1) & 0x1F; // wrap around through GPR0
         ppc_effective_address += 4;
         grab_inb -= 4;
@@ -1827,6 +1903,8 @@ void dppc_interpreter::ppc_stswi() {
 
     while (grab_inb >= 4) {
         mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_state.gpr[reg_s]);
+        if (ppc_exc_aborted())
+            return;
         reg_s++;
         if (reg_s >= 32) {    // wrap around through GPR0
             reg_s = 0;
@@ -1845,6 +1923,8 @@ void dppc_interpreter::ppc_stswi() {
         break;
     case 3:
         mmu_write_vmem<uint16_t>(ppc_effective_address, ppc_state.gpr[reg_s] >> 16);
+        if (ppc_exc_aborted())
+            return;
         mmu_write_vmem<uint8_t>(ppc_effective_address + 2, (ppc_state.gpr[reg_s] >> 8) & 0xFF);
         break;
     default:
@@ -1862,6 +1942,8 @@ void dppc_interpreter::ppc_stswx() {
 
     while (grab_inb >= 4) {
         mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_state.gpr[reg_s]);
+        if (ppc_exc_aborted())
+            return;
         reg_s++;
         if (reg_s >= 32) {    // wrap around through GPR0
             reg_s = 0;
@@ -1880,6 +1962,8 @@ void dppc_interpreter::ppc_stswx() {
         break;
     case 3:
         mmu_write_vmem<uint16_t>(ppc_effective_address, ppc_state.gpr[reg_s] >> 16);
+        if (ppc_exc_aborted())
+            return;
         mmu_write_vmem<uint8_t>(ppc_effective_address + 2, (ppc_state.gpr[reg_s] >> 8) & 0xFF);
         break;
     default:
@@ -1893,6 +1977,7 @@ void dppc_interpreter::ppc_eciwx() {
     // error if EAR[E] != 1
     if (!(ppc_state.spr[282] && ear_enable)) {
         ppc_exception_handler(Except_Type::EXC_DSI, 0x0);
+        return;
     }
 
     ppc_grab_regsdab(ppc_cur_instruction);
@@ -1900,10 +1985,14 @@ void dppc_interpreter::ppc_eciwx() {
 
     if (ppc_effective_address & 0x3) {
         ppc_alignment_exception(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
     }
 
     uint32_t ppc_result_d = mmu_read_vmem<uint32_t>(ppc_effective_address);
 
+    if (ppc_exc_aborted())
+        return;
     ppc_store_iresult_reg(reg_d, ppc_result_d);
 }
 
@@ -1913,6 +2002,7 @@ void dppc_interpreter::ppc_ecowx() {
     // error if EAR[E] != 1
     if (!(ppc_state.spr[282] && ear_enable)) {
         ppc_exception_handler(Except_Type::EXC_DSI, 0x0);
+        return;
     }
 
     ppc_grab_regssab(ppc_cur_instruction);
@@ -1920,6 +2010,8 @@ void dppc_interpreter::ppc_ecowx() {
 
     if (ppc_effective_address & 0x3) {
         ppc_alignment_exception(ppc_effective_address);
+        if (ppc_exc_aborted())
+            return;
     }
 
     mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_result_d);
@@ -0,0 +1,385 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Cache of predecoded PowerPC instructions. */
+
+#include <devices/memctrl/memctrlbase.h>
+#include <memaccess.h>
+#include "ppcemu.h"
+#include "ppcjit.h"
+#include "ppcmmu.h"
+#include "ppcpredecode.h"
+
+#include <array>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+/* Physical page numbers are looked up using a two-level directory. */
+#define PD_L1_BITS      10
+#define PD_L2_BITS      (32 - PAGE_SIZE_BITS - PD_L1_BITS)
+#define PD_L2_MASK      ((1 << PD_L2_BITS) - 1)
+
+#define PD_MAX_PAGES    2048 // max number of predecoded pages (16 KB each)
+
+#define PD_TARGET_BITS  8  // number of branch target cache entries = 1 << PD_TARGET_BITS
+#define PD_RAS_SIZE     16 // depth of the return address stack
+
+/* Pages invalidated more often than that are treated as self-modifying
+   and won't be predecoded anymore. */
+#define PD_SMC_THRESHOLD 16
+
+typedef struct PredecodedPage {
+    PredecodedInstr instrs[PAGE_SIZE >> 2];
+    uint32_t        phys_tag;
+    bool            is_watched; // true if writes to this page must be tracked
+} PredecodedPage;
+
+typedef struct PredecodeDir {
+    PredecodedPage* pages[1 << PD_L2_BITS];
+    uint8_t         inval_cnt[1 << PD_L2_BITS];
+} PredecodeDir;
+
+/** Cached translation of a guest virtual code address. */
+typedef struct PdTarget {
+    uint32_t            tag;    // virtual address | ITLB mode
+    uint32_t            gen;    // predecode_gen at the time of caching
+    PredecodedInstr*    instr;
+} PdTarget;
+
+uint32_t predecode_gen = 0;
+
+static std::array<std::unique_ptr<PredecodeDir>, 1 << PD_L1_BITS> pd_dir;
+
+// backing storage for predecoded pages
+static std::vector<std::unique_ptr<PredecodedPage>> pd_storage;
+
+static std::vector<PredecodedPage*> pd_free_pages;
+
+// Invalidated pages may still be executed by the interpreter
+// so they're recycled on the next lookup only.
+static std::vector<PredecodedPage*> pd_retired_pages;
+
+// Instructions on self-modifying pages are fetched from memory every time.
+static PredecodedPage   pd_live_page;
+static bool             pd_live_page_init = false;
+
+static void ppc_exec_live() {
+    if (mmu_translate_imem(ppc_state.pc) == nullptr)
+        return; // ISI is already pending
+    ppc_decode_opcode(ppc_cur_instruction)();
+}
+
+// Branch target cache, indexed by virtual page number.
+static PdTarget pd_targets[1 << PD_TARGET_BITS];
+
+// Return addresses of calls that left their page.
+static PdTarget pd_ras[PD_RAS_SIZE];
+static unsigned pd_ras_top = 0;
+
+static inline PredecodeDir* pd_get_dir(uint32_t phys_addr) {
+    return pd_dir[phys_addr >> (32 - PD_L1_BITS)].get();
+}
+
+static void pd_retire_page(PredecodeDir* dir, int idx) {
+    // compiled code lives exactly as long as its predecoded page
+    ppc_jit_invalidate_page(dir->pages[idx]->phys_tag);
+#ifdef PPC_FASTMEM
+    if (dir->pages[idx]->is_watched)
+        fastmem_unwatch_code_page(dir->pages[idx]->phys_tag);
+#endif
+    pd_retired_pages.push_back(dir->pages[idx]);
+    dir->pages[idx] = nullptr;
+    predecode_gen++;
+}
+
+static PredecodedPage* pd_alloc_page() {
+    PredecodedPage* page;
+
+    if (pd_free_pages.empty()) {
+        if (pd_storage.size() >= PD_MAX_PAGES) {
+            // out of pages -> start over
+            ppc_predecode_flush();
+            pd_free_pages.swap(pd_retired_pages);
+        } else {
+            pd_storage.push_back(std::make_unique<PredecodedPage>());
+            return pd_storage.back().get();
+        }
+    }
+
+    page = pd_free_pages.back();
+    pd_free_pages.pop_back();
+    return page;
+}
+
+#ifdef PPC_IDLE_SKIP
+/** Tell if an instruction inside an idle loop cannot change anything
+    but GPRs and CR. Loads are allowed, stores and SPR accesses aren't. */
+static bool pd_is_idle_safe(uint32_t opcode) {
+    switch (opcode >> 26) {
+    case 10: // cmpli
+    case 11: // cmpi
+    case 14: // addi
+    case 15: // addis
+    case 21: // rlwinm
+    case 24: // ori
+    case 25: // oris
+    case 26: // xori
+    case 27: // xoris
+    case 28: // andi.
+    case 29: // andis.
+    case 32: // lwz
+    case 34: // lbz
+    case 40: // lhz
+    case 42: // lha
+        return true;
+    case 16: // bc without link that leaves CTR alone
+        return !(opcode & 1) && (opcode & 0x00800000);
+    case 18: // b without link
+        return !(opcode & 1);
+    case 19:
+        return (opcode & 0x7FF) == (150 << 1); // isync
+    case 31:
+        switch ((opcode >> 1) & 0x3FF) {
+        case 0:   // cmp
+        case 32:  // cmpl
+        case 23:  // lwzx
+        case 87:  // lbzx
+        case 279: // lhzx
+        case 343: // lhax
+        case 28:  // and
+        case 60:  // andc
+        case 124: // nor
+        case 316: // xor
+        case 444: // or
+        case 598: // sync
+        case 854: // eieio
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+/** Tell if the instruction at idx is a backward branch closing
+    a short loop made of idle-safe instructions only. */
+static bool pd_closes_idle_loop(const PredecodedPage* page, int idx) {
+    uint32_t opcode = page->instrs[idx].opcode;
+    int32_t  disp;
+
+    switch (opcode >> 26) {
+    case 16:
+        if ((opcode & 3) || !(opcode & 0x00800000))
+            return false;
+        disp = int16_t(opcode & 0xFFFC);
+        break;
+    case 18:
+        if (opcode & 3)
+            return false;
+        disp = int32_t((opcode & 0x03FFFFFC) << 6) >> 6;
+        break;
+    default:
+        return false;
+    }
+
+    int first = idx + (disp >> 2);
+    if (disp > 0 || idx - first >= PD_IDLE_MAX_INSTRS || first < 0)
+        return false;
+
+    for (int i = first; i < idx; i++)
+        if (!pd_is_idle_safe(page->instrs[i].opcode))
+            return false;
+
+    return true;
+}
+#endif
+
+static PredecodedPage* pd_decode_page(const uint8_t* host_page, uint32_t phys_tag) {
+    PredecodedPage* page = pd_alloc_page();
+
+    for (int i = 0; i < (PAGE_SIZE >> 2); i++) {
+        uint32_t opcode = READ_DWORD_BE_A(&host_page[i << 2]);
+        page->instrs[i].handler = ppc_decode_opcode(opcode);
+        page->instrs[i].opcode  = opcode;
+#ifdef PPC_IDLE_SKIP
+        if (pd_closes_idle_loop(page, i))
+            page->instrs[i].handler = ppc_idle_branch;
+#endif
+        ppc_threaded_decode(&page->instrs[i]);
+    }
+
+    page->phys_tag = phys_tag;
+
+    // ROM pages cannot change so only RAM pages need to be watched
+    AddressMapEntry* rgn_desc = mem_ctrl_instance->find_range(phys_tag);
+    page->is_watched = rgn_desc && (rgn_desc->type & RT_RAM);
+    if (page->is_watched)
+        mmu_watch_code_page(phys_tag);
+
+    return page;
+}
+
+PredecodedInstr* ppc_predecode_lookup(uint32_t ea) {
+    uint32_t phys_addr;
+
+    if (!pd_retired_pages.empty()) {
+        pd_free_pages.insert(pd_free_pages.end(), pd_retired_pages.begin(),
+                             pd_retired_pages.end());
+        pd_retired_pages.clear();
+    }
+
+    uint8_t* host_va = mmu_translate_imem(ea, &phys_addr);
+    if (host_va == nullptr)
+        return nullptr; // ISI
+
+    auto& dir = pd_dir[phys_addr >> (32 - PD_L1_BITS)];
+    if (!dir)
+        dir = std::make_unique<PredecodeDir>();
+
+    int idx = (phys_addr >> PAGE_SIZE_BITS) & PD_L2_MASK;
+
+    PredecodedPage* page = dir->pages[idx];
+    if (page == nullptr) {
+        if (dir->inval_cnt[idx] >= PD_SMC_THRESHOLD) {
+            if (!pd_live_page_init) {
+                for (auto& instr : pd_live_page.instrs)
+                    instr = {ppc_exec_live, 0};
+                pd_live_page_init = true;
+            }
+            page = &pd_live_page;
+        } else {
+            page = pd_decode_page(host_va - (ea & (PAGE_SIZE - 1)),
+                                  phys_addr & PAGE_MASK);
+            dir->pages[idx] = page;
+        }
+    }
+
+    return &page->instrs[(ea & (PAGE_SIZE - 1)) >> 2];
+}
+
+// Virtual addresses are cached per translation mode (MSR[IR] and MSR[PR]).
+// Instruction addresses are word aligned so the mode goes into the lower bits.
+static inline uint32_t pd_target_tag(uint32_t ea) {
+    return (ea & ~3UL) | ((ppc_state.msr >> 4) & 2) | ((ppc_state.msr >> 14) & 1);
+}
+
+PredecodedInstr* ppc_predecode_lookup_branch(uint32_t target, uint32_t from_pc,
+                                             const PredecodedInstr* from_instr,
+                                             uint32_t from_gen) {
+    uint32_t tag      = pd_target_tag(target);
+    uint32_t ret_addr = from_pc + 4;
+
+    if (ppc_state.spr[SPR::LR] == ret_addr) {
+        // call leaving its page -> remember where to return to
+        if ((ret_addr & (PAGE_SIZE - 1)) && from_gen == predecode_gen) {
+            pd_ras_top = (pd_ras_top + 1) % PD_RAS_SIZE;
+            pd_ras[pd_ras_top] = {pd_target_tag(ret_addr), predecode_gen,
+                                  const_cast<PredecodedInstr*>(from_instr) + 1};
+        }
+    } else {
+        PdTarget& ras = pd_ras[pd_ras_top];
+        if (ras.tag == tag && ras.gen == predecode_gen && ras.instr) {
+#ifdef TLB_PROFILING
+            num_ras_hits++;
+#endif
+            PredecodedInstr* instr = ras.instr;
+            ras.instr  = nullptr;
+            pd_ras_top = (pd_ras_top + PD_RAS_SIZE - 1) % PD_RAS_SIZE;
+            return instr;
+        }
+    }
+
+    PdTarget& entry = pd_targets[(target >> PAGE_SIZE_BITS) & ((1 << PD_TARGET_BITS) - 1)];
+    if (!((entry.tag ^ tag) & (PAGE_MASK | 3)) && entry.gen == predecode_gen && entry.instr) {
+#ifdef TLB_PROFILING
+        num_btc_hits++;
+#endif
+        return entry.instr + ((target & (PAGE_SIZE - 1)) >> 2);
+    }
+
+    PredecodedInstr* instr = ppc_predecode_lookup(target);
+    if (instr == nullptr)
+        return nullptr;
+
+    entry = {tag & (PAGE_MASK | 3), predecode_gen, instr - ((target & (PAGE_SIZE - 1)) >> 2)};
+
+    return instr;
+}
+
+void ppc_predecode_flush_targets() {
+    for (auto& entry : pd_targets)
+        entry.instr = nullptr;
+    for (auto& entry : pd_ras)
+        entry.instr = nullptr;
+}
+
+void ppc_predecode_flush() {
+    for (auto& dir : pd_dir) {
+        if (!dir)
+            continue;
+        for (int idx = 0; idx <= PD_L2_MASK; idx++) {
+            if (dir->pages[idx] != nullptr)
+                pd_retire_page(dir.get(), idx);
+            dir->inval_cnt[idx] = 0;
+        }
+    }
+    predecode_gen++;
+}
+
+bool ppc_predecode_is_live(const PredecodedInstr* instr) {
+    return instr >= &pd_live_page.instrs[0] && instr < &pd_live_page.instrs[PAGE_SIZE >> 2];
+}
+
+bool ppc_predecode_is_watched(uint32_t phys_addr) {
+    PredecodeDir* dir = pd_get_dir(phys_addr);
+    if (dir == nullptr)
+        return false;
+
+    PredecodedPage* page = dir->pages[(phys_addr >> PAGE_SIZE_BITS) & PD_L2_MASK];
+    return page != nullptr && page->is_watched;
+}
+
+void ppc_predecode_invalidate(uint32_t phys_addr) {
+    PredecodeDir* dir = pd_get_dir(phys_addr);
+    if (dir == nullptr)
+        return;
+
+    int idx = (phys_addr >> PAGE_SIZE_BITS) & PD_L2_MASK;
+
+    if (dir->pages[idx] != nullptr) {
+        pd_retire_page(dir, idx);
+        if (dir->inval_cnt[idx] < PD_SMC_THRESHOLD)
+            dir->inval_cnt[idx]++;
+    }
+}
+
+void ppc_predecode_invalidate_range(uint32_t phys_addr, uint32_t size) {
+    if (!size)
+        return;
+
+    uint32_t last_page = (phys_addr + size - 1) & PAGE_MASK;
+
+    for (uint32_t page = phys_addr & PAGE_MASK;; page += PAGE_SIZE) {
+        ppc_predecode_invalidate(page);
+        if (page == last_page)
+            break;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Cache of predecoded PowerPC instructions.
+
+    Guest code is decoded one physical page at a time. Each instruction
+    slot holds the final handler (no intermediate dispatch through
+    the secondary opcode tables) and the instruction word itself
+    so the interpreter loop can skip fetching and decoding.
+    Operands used by the threaded interpreter are pre-extracted as well.
+
+    Pages backed by RAM are watched by the soft TLB: the first write
+    to such a page drops its predecoded copy.
+ */
+
+#ifndef PPC_PREDECODE_H
+#define PPC_PREDECODE_H
+
+#include "ppcemu.h"
+
+#include <cinttypes>
+
+/* Computed goto is required by the threaded interpreter. */
+#if defined(__GNUC__)
+#define PPC_THREADED_INT
+#endif
+
+/** Predecoded instruction slot. */
+typedef struct PredecodedInstr {
+    PPCOpcode   handler;    // final instruction handler
+    uint32_t    opcode;     // instruction word in host byte order
+    uint8_t     t_op;       // threaded interpreter operation
+    uint8_t     t_d;        // pre-extracted rD/rS/BO field
+    uint8_t     t_a;        // pre-extracted rA/BI field
+    uint8_t     t_b;        // pre-extracted rB/SH field or SPR number
+} PredecodedInstr;
+
+/** Incremented each time a predecoded page gets invalidated.
+    Used by the interpreter to detect writes to the page being executed. */
+extern uint32_t predecode_gen;
+
+/** Resolve the final handler for the given instruction word. */
+extern PPCOpcode ppc_decode_opcode(uint32_t opcode);
+
+/** Return the predecoded slot for the instruction at the effective address ea.
+    Performs instruction address translation so it may raise an ISI.
+    Returns nullptr if it did and the exception handler has returned. */
+extern PredecodedInstr* ppc_predecode_lookup(uint32_t ea);
+
+/** Return the predecoded slot for the target of a branch leaving the current
+    page. Recently used targets and return addresses of calls made through
+    bl/blr pairs are served from small caches without an ITLB lookup.
+    from_pc, from_instr and from_gen describe the branch instruction. */
+extern PredecodedInstr* ppc_predecode_lookup_branch(uint32_t target, uint32_t from_pc,
+                                                    const PredecodedInstr* from_instr,
+                                                    uint32_t from_gen);
+
+/** Drop cached branch targets. Must be called when the ITLB contents change. */
+extern void ppc_predecode_flush_targets();
+
+/** Tell if instr belongs to a self-modifying page fetched from memory every time. */
+extern bool ppc_predecode_is_live(const PredecodedInstr* instr);
+
+/** Drop all predecoded pages. */
+extern void ppc_predecode_flush();
+
+/** Tell if the physical page containing phys_addr needs write watching. */
+extern bool ppc_predecode_is_watched(uint32_t phys_addr);
+
+/** Drop the predecoded page containing phys_addr. */
+extern void ppc_predecode_invalidate(uint32_t phys_addr);
+
+/** Drop all predecoded pages overlapping the specified physical range. */
+extern void ppc_predecode_invalidate_range(uint32_t phys_addr, uint32_t size);
+
+#ifdef PPC_IDLE_SKIP
+/** Maximum number of instructions in a loop closed by ppc_idle_branch(). */
+#define PD_IDLE_MAX_INSTRS  16
+
+/** Handler installed for branches closing loops without side effects. */
+extern void ppc_idle_branch();
+#endif
+
+/** Fill in the threaded interpreter fields of a predecoded slot. */
+extern void ppc_threaded_decode(PredecodedInstr* instr);
+
+#ifdef PPC_THREADED_INT
+extern void ppc_exec_threaded_inner();
+extern void ppc_exec_threaded_until_inner(uint32_t goal_addr);
+#endif
+
+inline void ppc_exec_predecoded(const PredecodedInstr* instr) {
+#ifdef CPU_PROFILING
+    num_executed_instrs++;
+#endif
+    ppc_cur_instruction = instr->opcode;
+    instr->handler();
+}
+
+#endif // PPC_PREDECODE_H
@@ -0,0 +1,602 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-24 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Threaded PowerPC interpreter.
+
+    Walks the predecoded instruction records using computed goto.
+    The most frequent integer instructions are executed in place,
+    everything else goes through the regular handler.
+ */
+
+#include "ppcemu.h"
+#include "ppcmmu.h"
+#include "ppcpredecode.h"
+
+#include <cinttypes>
+
+/** Instructions executed in place by the threaded interpreter. */
+enum ThreadedOp : uint8_t {
+    TOP_GENERIC = 0, // call the instruction handler
+    TOP_ADDI,
+    TOP_ADDIS,
+    TOP_ORI,
+    TOP_ORIS,
+    TOP_ANDI,
+    TOP_RLWINM,
+    TOP_CMPI,
+    TOP_CMPLI,
+    TOP_CMP,
+    TOP_CMPL,
+    TOP_ADD,
+    TOP_ADDE,
+    TOP_SUBF,
+    TOP_AND,
+    TOP_OR,
+    TOP_LWZ,
+    TOP_LWZU,
+    TOP_LHZ,
+    TOP_LBZ,
+    TOP_STW,
+    TOP_STWU,
+    TOP_STH,
+    TOP_STB,
+    TOP_MFSPR,
+    TOP_MTSPR,
+    TOP_B,
+    TOP_BC,
+    TOP_BCLR,
+    TOP_LAST
+};
+
+void ppc_threaded_decode(PredecodedInstr* instr)
+{
+    uint32_t opcode = instr->opcode;
+    uint8_t  t_op   = TOP_GENERIC;
+
+#ifdef PPC_IDLE_SKIP
+    // the idle loop handler does more than branching
+    if (instr->handler == ppc_idle_branch) {
+        instr->t_op = TOP_GENERIC;
+        return;
+    }
+#endif
+
+    switch (opcode >> 26) {
+    case 10:
+        if (!(opcode & 0x200000))
+            t_op = TOP_CMPLI;
+        break;
+    case 11:
+        if (!(opcode & 0x200000))
+            t_op = TOP_CMPI;
+        break;
+    case 14:
+        t_op = TOP_ADDI;
+        break;
+    case 15:
+        t_op = TOP_ADDIS;
+        break;
+    case 16:
+        t_op = TOP_BC;
+        break;
+    case 18:
+        t_op = TOP_B;
+        break;
+    case 19:
+        if ((opcode & 0x7FE) == 32) // bclr, bclrl
+            t_op = TOP_BCLR;
+        break;
+    case 21:
+        t_op = TOP_RLWINM;
+        break;
+    case 24:
+        t_op = TOP_ORI;
+        break;
+    case 25:
+        t_op = TOP_ORIS;
+        break;
+    case 28:
+        t_op = TOP_ANDI;
+        break;
+    case 31:
+        switch (opcode & 0x7FF) {
+        case 0:
+            if (!(opcode & 0x200000))
+                t_op = TOP_CMP;
+            break;
+        case 32 << 1:
+            if (!(opcode & 0x200000))
+                t_op = TOP_CMPL;
+            break;
+        case 266 << 1:
+            t_op = TOP_ADD;
+            break;
+        case 138 << 1:
+            t_op = TOP_ADDE;
+            break;
+        case 40 << 1:
+            t_op = TOP_SUBF;
+            break;
+        case 28 << 1:
+            t_op = TOP_AND;
+            break;
+        case 444 << 1:
+            t_op = TOP_OR;
+            break;
+        case 339 << 1:
+        case 467 << 1: {
+            // only LR and CTR accesses have no side effects
+            uint32_t ref_spr = (((opcode >> 11) & 0x1F) << 5) | ((opcode >> 16) & 0x1F);
+            if (ref_spr == SPR::LR || ref_spr == SPR::CTR) {
+                t_op = ((opcode & 0x7FF) == (339 << 1)) ? TOP_MFSPR : TOP_MTSPR;
+                instr->t_b = ref_spr;
+            }
+            break;
+        }
+        }
+        break;
+    case 32:
+        t_op = TOP_LWZ;
+        break;
+    case 33:
+        // invalid forms are left to the handler
+        if (((opcode >> 16) & 0x1F) && ((opcode >> 16) & 0x1F) != ((opcode >> 21) & 0x1F))
+            t_op = TOP_LWZU;
+        break;
+    case 34:
+        t_op = TOP_LBZ;
+        break;
+    case 36:
+        t_op = TOP_STW;
+        break;
+    case 37:
+        if ((opcode >> 16) & 0x1F)
+            t_op = TOP_STWU;
+        break;
+    case 38:
+        t_op = TOP_STB;
+        break;
+    case 40:
+        t_op = TOP_LHZ;
+        break;
+    case 44:
+        t_op = TOP_STH;
+        break;
+    }
+
+    instr->t_op = t_op;
+    instr->t_d  = (opcode >> 21) & 0x1F;
+    instr->t_a  = (opcode >> 16) & 0x1F;
+    if (t_op != TOP_MFSPR && t_op != TOP_MTSPR)
+        instr->t_b = (opcode >> 11) & 0x1F;
+}
+
+#ifdef PPC_THREADED_INT
+
+/** mask generator for rotate and shift instructions (§ 4.2.1.4 PowerpC PEM) */
+static inline uint32_t rot_mask(unsigned rot_mb, unsigned rot_me) {
+    uint32_t m1 = 0xFFFFFFFFUL >> rot_mb;
+    uint32_t m2 = (uint32_t)(0xFFFFFFFFUL << (31 - rot_me));
+    return ((rot_mb <= rot_me) ? m2 & m1 : m1 | m2);
+}
+
+static inline uint32_t cmp_xercon() {
+    return (ppc_state.spr[SPR::XER] & XER::SO) >> 3;
+}
+
+#ifdef CPU_PROFILING
+#define PROF_INSTR()    num_executed_instrs++
+#define PROF_LOAD()     num_int_loads++
+#define PROF_STORE()    num_int_stores++
+#else
+#define PROF_INSTR()
+#define PROF_LOAD()
+#define PROF_STORE()
+#endif
+
+#define DISPATCH() \
+    do { \
+        PROF_INSTR(); \
+        ppc_cur_instruction = pd_instr->opcode; \
+        goto *dispatch_tbl[pd_instr->t_op]; \
+    } while (0)
+
+/* Advance to the next sequential instruction. A new block is started
+   when crossing a page boundary. */
+#define NEXT_SEQ() \
+    do { \
+        ppc_state.pc += 4; \
+        pd_instr++; \
+        if (until && ppc_state.pc == goal_addr) \
+            return; \
+        if (!(ppc_state.pc & (PAGE_SIZE - 1)) || !power_on) \
+            goto new_block; \
+        DISPATCH(); \
+    } while (0)
+
+/* Finish an instruction executed in place. Timer callbacks invoked
+   by process_events() may raise an interrupt. */
+#define NEXT_INSTR() \
+    do { \
+        if (g_icycles++ >= max_cycles || exec_timer) { \
+            max_cycles = process_events(); \
+            if (exec_flags) \
+                goto flow_change; \
+        } \
+        NEXT_SEQ(); \
+    } while (0)
+
+/* Finish a branch instruction that updated exec_flags. */
+#define NEXT_BRANCH() \
+    do { \
+        if (g_icycles++ >= max_cycles || exec_timer) \
+            max_cycles = process_events(); \
+        if (exec_flags) \
+            goto flow_change; \
+        NEXT_SEQ(); \
+    } while (0)
+
+/* Leave an instruction whose memory access raised an exception. */
+#define CHECK_ABORT() \
+    do { \
+        if (ppc_exc_aborted()) \
+            goto flow_change; \
+    } while (0)
+
+/** Threaded interpreter loop.
+
+    Follows ppc_exec_inner() exactly: without PPC_EXC_RETURN, the caller
+    is responsible for setting up the exception context via setjmp().
+    Returns when power is turned off or, for until = true,
+    when goal_addr has been reached.
+ */
+template <bool until>
+static void ppc_exec_threaded_loop(uint32_t goal_addr)
+{
+    static const void* const dispatch_tbl[TOP_LAST] = {
+        &&op_generic, &&op_addi, &&op_addis, &&op_ori, &&op_oris, &&op_andi,
+        &&op_rlwinm, &&op_cmpi, &&op_cmpli, &&op_cmp, &&op_cmpl, &&op_add,
+        &&op_adde, &&op_subf, &&op_and, &&op_or, &&op_lwz, &&op_lwzu, &&op_lhz,
+        &&op_lbz, &&op_stw, &&op_stwu, &&op_sth, &&op_stb, &&op_mfspr, &&op_mtspr,
+        &&op_b, &&op_bc, &&op_bclr
+    };
+
+    uint64_t max_cycles = 0;
+    uint32_t page_start, eb_start, pd_gen;
+    uint32_t load_val; // committed once the access has succeeded
+    PredecodedInstr* pd_instr;
+
+new_block:
+    if (!power_on)
+        return;
+
+    pd_instr = ppc_predecode_lookup(ppc_state.pc);
+    if (pd_instr == nullptr)
+        goto fetch_fault;
+
+new_page:
+    if (!power_on)
+        return;
+
+    // execution block = the remainder of the current page
+    page_start = ppc_state.pc & PAGE_MASK;
+    exec_flags = 0;
+    pd_gen     = predecode_gen;
+    DISPATCH();
+
+flow_change:
+    eb_start = ppc_next_instruction_address;
+    if (!(exec_flags & (EXEF_RFI | EXEF_EXCEPTION)) && (eb_start & PAGE_MASK) == page_start &&
+        pd_gen == predecode_gen) {
+        pd_instr += ((int)eb_start - (int)ppc_state.pc) >> 2;
+        ppc_state.pc = eb_start;
+        exec_flags   = 0;
+        if (until && ppc_state.pc == goal_addr)
+            return;
+        if (!power_on)
+            return;
+        DISPATCH();
+    }
+    if (until && eb_start == goal_addr) {
+        ppc_state.pc = eb_start;
+        exec_flags   = 0;
+        return;
+    }
+    if (exec_flags & (EXEF_RFI | EXEF_EXCEPTION)) {
+        ppc_state.pc = eb_start;
+        goto new_block;
+    }
+    pd_instr     = ppc_predecode_lookup_branch(eb_start, ppc_state.pc, pd_instr, pd_gen);
+    if (pd_instr == nullptr)
+        goto fetch_fault;
+    ppc_state.pc = eb_start;
+    goto new_page;
+
+fetch_fault:
+    // instruction fetch raised ISI, continue at the exception vector
+    ppc_state.pc = ppc_next_instruction_address;
+    exec_flags   = 0;
+    if (until && ppc_state.pc == goal_addr)
+        return;
+    goto new_block;
+
+op_generic:
+    pd_instr->handler();
+    NEXT_BRANCH();
+
+op_addi:
+    ppc_state.gpr[pd_instr->t_d] = (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0) +
+                                   int32_t(int16_t(pd_instr->opcode));
+    NEXT_INSTR();
+
+op_addis:
+    ppc_state.gpr[pd_instr->t_d] = (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0) +
+                                   (pd_instr->opcode << 16);
+    NEXT_INSTR();
+
+op_ori:
+    ppc_state.gpr[pd_instr->t_a] = ppc_state.gpr[pd_instr->t_d] | uint16_t(pd_instr->opcode);
+    NEXT_INSTR();
+
+op_oris:
+    ppc_state.gpr[pd_instr->t_a] = ppc_state.gpr[pd_instr->t_d] | (pd_instr->opcode << 16);
+    NEXT_INSTR();
+
+op_andi: {
+        uint32_t ppc_result_a = ppc_state.gpr[pd_instr->t_d] & uint16_t(pd_instr->opcode);
+        ppc_changecrf0(ppc_result_a);
+        ppc_state.gpr[pd_instr->t_a] = ppc_result_a;
+    }
+    NEXT_INSTR();
+
+op_rlwinm: {
+        uint32_t rs     = ppc_state.gpr[pd_instr->t_d];
+        unsigned rot_sh = pd_instr->t_b;
+        uint32_t r      = rot_sh ? ((rs << rot_sh) | (rs >> (32 - rot_sh))) : rs;
+        uint32_t ppc_result_a = r & rot_mask((pd_instr->opcode >> 6) & 0x1F,
+                                             (pd_instr->opcode >> 1) & 0x1F);
+        if (pd_instr->opcode & 1)
+            ppc_changecrf0(ppc_result_a);
+        ppc_state.gpr[pd_instr->t_a] = ppc_result_a;
+    }
+    NEXT_INSTR();
+
+op_cmpi: {
+        int      crf_d = pd_instr->t_d & 0x1C;
+        int32_t  ra    = int32_t(ppc_state.gpr[pd_instr->t_a]);
+        int32_t  simm  = int32_t(int16_t(pd_instr->opcode));
+        uint32_t cmp_c = (ra == simm) ? 0x20000000UL : (ra > simm) ? 0x40000000UL : 0x80000000UL;
+        ppc_state.cr = ((ppc_state.cr & ~(0xf0000000UL >> crf_d)) |
+                        ((cmp_c + cmp_xercon()) >> crf_d));
+    }
+    NEXT_INSTR();
+
+op_cmpli: {
+        int      crf_d = pd_instr->t_d & 0x1C;
+        uint32_t ra    = ppc_state.gpr[pd_instr->t_a];
+        uint32_t uimm  = uint16_t(pd_instr->opcode);
+        uint32_t cmp_c = (ra == uimm) ? 0x20000000UL : (ra > uimm) ? 0x40000000UL : 0x80000000UL;
+        ppc_state.cr = ((ppc_state.cr & ~(0xf0000000UL >> crf_d)) |
+                        ((cmp_c + cmp_xercon()) >> crf_d));
+    }
+    NEXT_INSTR();
+
+op_cmp: {
+        int      crf_d = pd_instr->t_d & 0x1C;
+        int32_t  ra    = int32_t(ppc_state.gpr[pd_instr->t_a]);
+        int32_t  rb    = int32_t(ppc_state.gpr[pd_instr->t_b]);
+        uint32_t cmp_c = (ra == rb) ? 0x20000000UL : (ra > rb) ? 0x40000000UL : 0x80000000UL;
+        ppc_state.cr = ((ppc_state.cr & ~(0xf0000000UL >> crf_d)) |
+                        ((cmp_c + cmp_xercon()) >> crf_d));
+    }
+    NEXT_INSTR();
+
+op_cmpl: {
+        int      crf_d = pd_instr->t_d & 0x1C;
+        uint32_t ra    = ppc_state.gpr[pd_instr->t_a];
+        uint32_t rb    = ppc_state.gpr[pd_instr->t_b];
+        uint32_t cmp_c = (ra == rb) ? 0x20000000UL : (ra > rb) ? 0x40000000UL : 0x80000000UL;
+        ppc_state.cr = ((ppc_state.cr & ~(0xf0000000UL >> crf_d)) |
+                        ((cmp_c + cmp_xercon()) >> crf_d));
+    }
+    NEXT_INSTR();
+
+op_add:
+    ppc_state.gpr[pd_instr->t_d] = ppc_state.gpr[pd_instr->t_a] + ppc_state.gpr[pd_instr->t_b];
+    NEXT_INSTR();
+
+op_adde: {
+        uint32_t ppc_result_a = ppc_state.gpr[pd_instr->t_a];
+        uint32_t xer_ca       = !!(ppc_state.spr[SPR::XER] & XER::CA);
+        uint32_t ppc_result_d = ppc_result_a + ppc_state.gpr[pd_instr->t_b] + xer_ca;
+
+        if ((ppc_result_d < ppc_result_a) || (xer_ca && (ppc_result_d == ppc_result_a))) {
+            ppc_state.spr[SPR::XER] |= XER::CA;
+        } else {
+            ppc_state.spr[SPR::XER] &= ~XER::CA;
+        }
+        ppc_state.gpr[pd_instr->t_d] = ppc_result_d;
+    }
+    NEXT_INSTR();
+
+op_subf:
+    ppc_state.gpr[pd_instr->t_d] = ppc_state.gpr[pd_instr->t_b] - ppc_state.gpr[pd_instr->t_a];
+    NEXT_INSTR();
+
+op_and:
+    ppc_state.gpr[pd_instr->t_a] = ppc_state.gpr[pd_instr->t_d] & ppc_state.gpr[pd_instr->t_b];
+    NEXT_INSTR();
+
+op_or:
+    ppc_state.gpr[pd_instr->t_a] = ppc_state.gpr[pd_instr->t_d] | ppc_state.gpr[pd_instr->t_b];
+    NEXT_INSTR();
+
+op_lwz:
+    PROF_LOAD();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    load_val = mmu_read_vmem<uint32_t>(ppc_effective_address);
+    CHECK_ABORT();
+    ppc_state.gpr[pd_instr->t_d] = load_val;
+    NEXT_INSTR();
+
+op_lwzu:
+    PROF_LOAD();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) + ppc_state.gpr[pd_instr->t_a];
+    load_val = mmu_read_vmem<uint32_t>(ppc_effective_address);
+    CHECK_ABORT();
+    ppc_state.gpr[pd_instr->t_d] = load_val;
+    ppc_state.gpr[pd_instr->t_a] = ppc_effective_address;
+    NEXT_INSTR();
+
+op_lhz:
+    PROF_LOAD();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    load_val = mmu_read_vmem<uint16_t>(ppc_effective_address);
+    CHECK_ABORT();
+    ppc_state.gpr[pd_instr->t_d] = load_val;
+    NEXT_INSTR();
+
+op_lbz:
+    PROF_LOAD();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    load_val = mmu_read_vmem<uint8_t>(ppc_effective_address);
+    CHECK_ABORT();
+    ppc_state.gpr[pd_instr->t_d] = load_val;
+    NEXT_INSTR();
+
+op_stw:
+    PROF_STORE();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_state.gpr[pd_instr->t_d]);
+    CHECK_ABORT();
+    NEXT_INSTR();
+
+op_stwu:
+    PROF_STORE();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) + ppc_state.gpr[pd_instr->t_a];
+    mmu_write_vmem<uint32_t>(ppc_effective_address, ppc_state.gpr[pd_instr->t_d]);
+    CHECK_ABORT();
+    ppc_state.gpr[pd_instr->t_a] = ppc_effective_address;
+    NEXT_INSTR();
+
+op_sth:
+    PROF_STORE();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    mmu_write_vmem<uint16_t>(ppc_effective_address, ppc_state.gpr[pd_instr->t_d]);
+    CHECK_ABORT();
+    NEXT_INSTR();
+
+op_stb:
+    PROF_STORE();
+    ppc_effective_address = int32_t(int16_t(pd_instr->opcode)) +
+                            (pd_instr->t_a ? ppc_state.gpr[pd_instr->t_a] : 0);
+    mmu_write_vmem<uint8_t>(ppc_effective_address, ppc_state.gpr[pd_instr->t_d]);
+    CHECK_ABORT();
+    NEXT_INSTR();
+
+op_mfspr:
+    ppc_state.gpr[pd_instr->t_d] = ppc_state.spr[pd_instr->t_b];
+    NEXT_INSTR();
+
+op_mtspr:
+    ppc_state.spr[pd_instr->t_b] = ppc_state.gpr[pd_instr->t_d];
+    NEXT_INSTR();
+
+op_b: {
+        int32_t adr_li = int32_t((pd_instr->opcode & ~3UL) << 6) >> 6;
+
+        if (pd_instr->opcode & 2) // AA
+            ppc_next_instruction_address = adr_li;
+        else
+            ppc_next_instruction_address = uint32_t(ppc_state.pc + adr_li);
+
+        if (pd_instr->opcode & 1) // LK
+            ppc_state.spr[SPR::LR] = uint32_t(ppc_state.pc + 4);
+
+        exec_flags = EXEF_BRANCH;
+    }
+    NEXT_BRANCH();
+
+op_bc: {
+        uint32_t br_bo = pd_instr->t_d;
+        uint32_t br_bi = pd_instr->t_a;
+
+        if (!(br_bo & 0x04)) {
+            (ppc_state.spr[SPR::CTR])--; /* decrement CTR */
+        }
+        uint32_t ctr_ok = (br_bo & 0x04) |
+                          ((ppc_state.spr[SPR::CTR] != 0) == !(br_bo & 0x02));
+        uint32_t cnd_ok = (br_bo & 0x10) |
+                          (!(ppc_state.cr & (0x80000000UL >> br_bi)) == !(br_bo & 0x08));
+
+        if (ctr_ok && cnd_ok) {
+            int32_t br_bd = int32_t(int16_t(pd_instr->opcode & ~3UL));
+            if (pd_instr->opcode & 2) // AA
+                ppc_next_instruction_address = br_bd;
+            else
+                ppc_next_instruction_address = uint32_t(ppc_state.pc + br_bd);
+            exec_flags = EXEF_BRANCH;
+        }
+
+        if (pd_instr->opcode & 1) // LK
+            ppc_state.spr[SPR::LR] = ppc_state.pc + 4;
+    }
+    NEXT_BRANCH();
+
+op_bclr: {
+        uint32_t br_bo = pd_instr->t_d;
+        uint32_t br_bi = pd_instr->t_a;
+
+        if (!(br_bo & 0x04)) {
+            (ppc_state.spr[SPR::CTR])--; /* decrement CTR */
+        }
+        uint32_t ctr_ok = (br_bo & 0x04) |
+                          ((ppc_state.spr[SPR::CTR] != 0) == !(br_bo & 0x02));
+        uint32_t cnd_ok = (br_bo & 0x10) |
+                          (!(ppc_state.cr & (0x80000000UL >> br_bi)) == !(br_bo & 0x08));
+
+        if (ctr_ok && cnd_ok) {
+            ppc_next_instruction_address = (ppc_state.spr[SPR::LR] & ~3UL);
+            exec_flags = EXEF_BRANCH;
+        }
+
+        if (pd_instr->opcode & 1) // LK
+            ppc_state.spr[SPR::LR] = ppc_state.pc + 4;
+    }
+    NEXT_BRANCH();
+}
+
+void ppc_exec_threaded_inner()
+{
+    ppc_exec_threaded_loop<false>(0);
+}
+
+void ppc_exec_threaded_until_inner(uint32_t goal_addr)
+{
+    ppc_exec_threaded_loop<true>(goal_addr);
+}
+
+#endif // PPC_THREADED_INT
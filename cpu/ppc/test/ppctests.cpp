@@ -21,6 +21,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "../ppcdisasm.h"
 #include "../ppcemu.h"
+#include "../ppcjit.h"
+#include "../ppcmmu.h"
+#include "../ppcpredecode.h"
 #include <cfenv>
 #include <cmath>
 #include <fstream>
@@ -80,8 +83,35 @@ void xer_update_test() {
     xer_ov_test("SUBFZEO.", 0x7C630591);
 }
 
+/* Execute the instruction using regular dispatch. */
+static void exec_interpreter(uint32_t opcode) {
+    ppc_cur_instruction = opcode;
+    ppc_main_opcode();
+}
+
+#ifdef PPC_THREADED_INT
+/* Execute the instruction from guest memory using the threaded interpreter. */
+static void exec_threaded(uint32_t opcode) {
+    mmu_write_vmem<uint32_t>(0, opcode);
+    ppc_predecode_flush(); // don't let the test page look self-modifying
+    ppc_state.pc = 0;
+    ppc_exec_until(4);
+}
+#endif
+
+#ifdef PPC_JIT
+/* Compile the instruction followed by a branch out of the block and run it. */
+static void exec_jit(uint32_t opcode) {
+    mmu_write_vmem<uint32_t>(0, opcode);
+    mmu_write_vmem<uint32_t>(4, 0x480000FCUL); // b 0x100
+    ppc_predecode_flush();
+    ppc_state.pc = 0;
+    ppc_exec_until(0x100);
+}
+#endif
+
 /** testing vehicle */
-static void read_test_data() {
+static void read_test_data(void (*exec_instr)(uint32_t opcode)) {
     string line, token;
     int i, lineno;
     uint32_t opcode, dest, src1, src2, check_xer, check_cr;
@@ -145,9 +175,7 @@ static void read_test_data() {
         ppc_state.spr[SPR::XER] = 0;
         ppc_state.cr            = 0;
 
-        ppc_cur_instruction = opcode;
-
-        ppc_main_opcode();
+        exec_instr(opcode);
 
         ntested++;
 
@@ -314,6 +342,117 @@ static void read_test_float_data() {
     }
 }
 
+static void set_dbat(int num, uint32_t upper, uint32_t lower) {
+    ppc_state.spr[536 + num * 2] = upper;
+    ppc_state.spr[537 + num * 2] = lower;
+    dbat_update(536 + num * 2);
+    do_ctx_sync();
+}
+
+static void tlb1_check_read(uint32_t ea, uint64_t expected) {
+    uint64_t val = mmu_read_vmem<uint64_t>(ea);
+    if (val != expected) {
+        cout << "Stale TLB1 translation at 0x" << hex << ea << ": got 0x" << val
+             << ", expected 0x" << expected << endl;
+        nfailed++;
+    }
+    ntested++;
+}
+
+// Fills a primary DTLB entry at the top of the address space, runs the TLB
+// generation through a wrap-around and changes the mapping. Accesses that
+// follow must go through the new translation, also in the last generation
+// before the next wrap-around.
+void tlb1_gen_wrap_test() {
+    MemCtrlBase* mem_ctrl = new MemCtrlBase;
+    mem_ctrl->add_ram_region(0, 0x80000);
+    ppc_cpu_init(mem_ctrl, PPC_VER::MPC750, 16705000);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        *mmu_map_dma_mem(0x1FFF0 + i, 1, false).host_va = 0x10 + i; // old page
+        *mmu_map_dma_mem(0x3FFF0 + i, 1, false).host_va = 0x20 + i; // new page
+    }
+
+    // 128 KB block at EA 0xFFFE0000 -> PA 0
+    set_dbat(0, 0xFFFE0003, 0x00000002);
+    ppc_state.msr = MSR::DR;
+    mmu_change_mode();
+
+    tlb1_check_read(0xFFFFFFF8, 0x18191A1B1C1D1E1FULL);
+
+    // pages becoming clean advance the generation by a single step
+    uint32_t prev_gen;
+    do {
+        prev_gen = tlb1_gen;
+        mem_ctrl->notify_dirty_change(0, PAGE_SIZE, true);
+    } while (tlb1_gen > prev_gen);
+
+    // EA 0xFFFE0000 -> PA 0x20000
+    set_dbat(0, 0xFFFE0003, 0x00020002);
+
+    while (tlb1_gen != TLB1_GEN_MASK)
+        mem_ctrl->notify_dirty_change(0, PAGE_SIZE, true);
+
+    // the lookup key of this access has all low bits set, it must not hit
+    // the stale entry but raise an alignment exception
+    ppc_cur_instruction = 0xC8230000; // lfd f1,0(r3)
+    mmu_read_vmem<uint64_t>(0xFFFFFFF7);
+    if (!ppc_exc_aborted()) {
+        cout << "Unaligned access at 0xfffffff7 hit a stale TLB1 entry" << endl;
+        nfailed++;
+    }
+    ntested++;
+    exec_flags    = 0;
+    ppc_state.msr = MSR::DR;
+    mmu_change_mode();
+
+    tlb1_check_read(0xFFFFFFF8, 0x28292A2B2C2D2E2FULL);
+
+    ppc_state.msr = 0;
+    mmu_change_mode();
+    delete mem_ctrl;
+}
+
+#ifdef PPC_JIT
+// Runs a compiled lha that raises DSI from the slow path of its load.
+// The block must leave at the faulting instruction without writing rD.
+void jit_load_fault_test() {
+    MemCtrlBase* mem_ctrl = new MemCtrlBase;
+    mem_ctrl->add_ram_region(0, 0x10000); // zeroed page table at PA 0
+    ppc_cpu_init(mem_ctrl, PPC_VER::MPC750, 16705000);
+    power_on  = true;
+    exec_mode = jit;
+
+    mmu_write_vmem<uint32_t>(0x000, 0xA8830000UL); // lha r4,0(r3)
+    mmu_write_vmem<uint32_t>(0x004, 0x480000FCUL); // b 0x100
+    mmu_write_vmem<uint32_t>(0x300, 0x4BFFFE00UL); // DSI vector: b 0x100
+    ppc_predecode_flush();
+
+    // no BAT maps EA 0x8000 and the page table is empty
+    ppc_state.gpr[3] = 0x8000;
+    ppc_state.gpr[4] = 0xDEADBEEF;
+    ppc_state.msr    = MSR::DR;
+    mmu_change_mode();
+    ppc_state.pc = 0;
+    ppc_exec_until(0x100);
+
+    if (ppc_state.gpr[4] != 0xDEADBEEF || ppc_state.spr[SPR::SRR0] != 0 ||
+        ppc_state.spr[SPR::DAR] != 0x8000) {
+        cout << "Faulting lha in compiled code: r4=0x" << hex << ppc_state.gpr[4]
+             << ", SRR0=0x" << ppc_state.spr[SPR::SRR0] << ", DAR=0x"
+             << ppc_state.spr[SPR::DAR] << endl;
+        nfailed++;
+    }
+    ntested++;
+
+    exec_mode     = interpreter;
+    power_on      = false;
+    ppc_state.msr = 0;
+    mmu_change_mode();
+    delete mem_ctrl;
+}
+#endif
+
 int main() {
     initialize_ppc_opcode_tables(); //kludge
 
@@ -328,7 +467,7 @@ int main() {
 
     cout << endl << "Testing integer instructions:" << endl;
 
-    read_test_data();
+    read_test_data(exec_interpreter);
 
     cout << endl << "Float IEEE suport: " << (bool)std::numeric_limits<float>::is_iec559 << endl;
     cout << endl << "Double IEEE suport: " << (bool)std::numeric_limits<double>::is_iec559 << endl;
@@ -337,6 +476,48 @@ int main() {
 
     read_test_float_data();
 
+    cout << endl << "Testing TLB generation wrap-around..." << endl;
+
+    tlb1_gen_wrap_test();
+
+#ifdef PPC_THREADED_INT
+    cout << endl << "Testing integer instructions (threaded interpreter):" << endl;
+
+    MemCtrlBase* mem_ctrl = new MemCtrlBase;
+    mem_ctrl->add_ram_region(0, 0x1000);
+    ppc_cpu_init(mem_ctrl, PPC_VER::MPC750, 16705000);
+    power_on  = true;
+    exec_mode = threaded_int;
+
+    read_test_data(exec_threaded);
+
+    exec_mode = interpreter;
+    power_on  = false;
+    delete mem_ctrl;
+#endif
+
+#ifdef PPC_JIT
+    if (ppc_jit_init()) {
+        cout << endl << "Testing integer instructions (JIT):" << endl;
+
+        MemCtrlBase* jit_mem_ctrl = new MemCtrlBase;
+        jit_mem_ctrl->add_ram_region(0, 0x1000);
+        ppc_cpu_init(jit_mem_ctrl, PPC_VER::MPC750, 16705000);
+        power_on  = true;
+        exec_mode = jit;
+
+        read_test_data(exec_jit);
+
+        exec_mode = interpreter;
+        power_on  = false;
+        delete jit_mem_ctrl;
+
+        cout << endl << "Testing faulting loads (JIT)..." << endl;
+
+        jit_load_fault_test();
+    }
+#endif
+
     cout << "... completed." << endl;
     cout << "--> Tested instructions: " << dec << ntested << endl;
     cout << "--> Failed: " << dec << nfailed << endl << endl;
@@ -76,6 +76,11 @@ static void show_help() {
     cout << "  ni           -- shortcut for next" << endl;
     cout << "  until X      -- execute until address X is reached" << endl;
     cout << "  go           -- exit debugger and continue emulator execution" << endl;
+    cout << "                  stops at breakpoints if there are any" << endl;
+    cout << "  break [X]    -- set breakpoint at address X" << endl;
+    cout << "                  break with no arguments lists breakpoints" << endl;
+    cout << "  delete [X]   -- delete breakpoint at address X" << endl;
+    cout << "                  delete with no arguments deletes all breakpoints" << endl;
     cout << "  regs         -- dump content of the GRPs" << endl;
     cout << "  mregs        -- dump content of the MMU registers" << endl;
     cout << "  set R=X      -- assign value X to register R" << endl;
@@ -639,7 +644,40 @@ void enter_debugger() {
         } else if (cmd == "go") {
             cmd = "";
             power_on = true;
-            ppc_exec();
+            if (ppc_get_breakpoints().empty()) {
+                ppc_exec();
+            } else if (ppc_exec_until_bp()) {
+                cout << "Breakpoint hit at " << uppercase << hex << ppc_state.pc << endl;
+            }
+        } else if (cmd == "break") {
+            cmd = "";
+            expr_str = "";
+            ss >> expr_str;
+            if (expr_str.length() > 0) {
+                try {
+                    ppc_set_breakpoint(str2addr(expr_str));
+                } catch (invalid_argument& exc) {
+                    cout << exc.what() << endl;
+                }
+            } else {
+                for (uint32_t bp_addr : ppc_get_breakpoints()) {
+                    cout << uppercase << hex << bp_addr << endl;
+                }
+            }
+        } else if (cmd == "delete") {
+            cmd = "";
+            expr_str = "";
+            ss >> expr_str;
+            if (expr_str.length() > 0) {
+                try {
+                    if (!ppc_clear_breakpoint(str2addr(expr_str)))
+                        cout << "No breakpoint at " << expr_str << endl;
+                } catch (invalid_argument& exc) {
+                    cout << exc.what() << endl;
+                }
+            } else {
+                ppc_clear_breakpoints();
+            }
         } else if (cmd == "disas" || cmd == "da") {
             expr_str = "";
             ss >> expr_str;
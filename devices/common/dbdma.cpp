@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 /** @file Descriptor-based direct memory access emulation. */
 
+#include <core/timermanager.h>
 #include <cpu/ppc/ppcmmu.h>
 #include <devices/common/dbdma.h>
 #include <devices/common/dmacore.h>
@@ -85,6 +86,7 @@ uint8_t DMAChannel::interpret_cmd() {
         if (this->queue_len) {
             res = mmu_map_dma_mem(cmd_struct.address, cmd_struct.req_count, false);
             this->queue_data = res.host_va;
+            this->queue_addr = cmd_struct.address;
             this->res_count  = 0;
             this->cmd_in_progress = true;
         } else
@@ -123,10 +125,11 @@ uint8_t DMAChannel::interpret_cmd() {
 }
 
 void DMAChannel::finish_cmd() {
-    bool   branch_taken = false;
+    bool     branch_taken = false;
+    uint32_t cmd_addr     = this->cmd_ptr;
 
     // obtain real pointer to the descriptor of the command to be finished
-    MapDmaResult res  = mmu_map_dma_mem(this->cmd_ptr, 16, false);
+    MapDmaResult res  = mmu_map_dma_mem(cmd_addr, 16, false);
     uint8_t *cmd_desc = res.host_va;
 
     // get command code
@@ -179,6 +182,10 @@ void DMAChannel::finish_cmd() {
         this->res_count = 0;
     }
 
+    // the descriptor got its status and residual count
+    if (this->cur_cmd < DBDMA_Cmd::STOP && res.is_writable)
+        mmu_dma_mem_written(cmd_addr, 16);
+
     if (!branch_taken)
         this->cmd_ptr += 16;
 
@@ -218,6 +225,7 @@ void DMAChannel::xfer_quad(const DMACmd *cmd_desc, DMACmd *cmd_host) {
                 case 2: WRITE_WORD_LE_A(res.host_va, cmd_desc->cmd_arg); break;
                 case 4: WRITE_DWORD_LE_A(res.host_va, cmd_desc->cmd_arg); break;
             }
+            mmu_dma_mem_written(addr, xfer_size);
         } else {
             LOG_F(ERROR, "SOS: DMA access is not to RAM %08X!\n", addr);
         }
@@ -234,6 +242,7 @@ void DMAChannel::xfer_quad(const DMACmd *cmd_desc, DMACmd *cmd_host) {
             }
         }
         WRITE_DWORD_LE_A(&cmd_host->cmd_arg, value);
+        mmu_dma_mem_written(this->cmd_ptr, 16);
     }
 
     if (cmd_desc->cmd_bits & 0xC)
@@ -261,10 +270,17 @@ void DMAChannel::update_irq() {
                 }
             }
             if (cond) {
-                if (int_ctrl)
-                    this->int_ctrl->ack_dma_int(this->irq_id, 1);
-                else
+                // sound channels run commands on the audio thread too,
+                // their interrupts are handed over to the emulation thread
+                if (!int_ctrl)
                     LOG_F(ERROR, "%s Interrupt ignored", this->get_name().c_str());
+                else if (TimerManager::get_instance()->on_timer_thread())
+                    this->int_ctrl->ack_dma_int(this->irq_id, 1);
+                else if (!TimerManager::get_instance()->post_event([this]() {
+                             this->int_ctrl->ack_dma_int(this->irq_id, 1);
+                         }))
+                    LOG_F(ERROR, "%s: event queue full, interrupt lost",
+                          this->get_name().c_str());
             }
         }
     }
@@ -430,6 +446,7 @@ int DMAChannel::push_data(const char* src_ptr, int len) {
     if (this->queue_len) {
         len = std::min((int)this->queue_len, len);
         std::memcpy(this->queue_data, src_ptr, len);
+        mmu_dma_mem_written(this->queue_addr + this->res_count, len);
         this->queue_data += len;
         this->res_count  += len;
         this->queue_len  -= len;
@@ -53,6 +53,17 @@ bool PCIBridgeBase::pci_unregister_mmio_region(uint32_t start_addr, uint32_t siz
     return this->host_instance->pci_unregister_mmio_region(start_addr, size, obj);
 }
 
+bool PCIBridgeBase::pci_register_mem_aperture(uint32_t start_addr, uint32_t size, uint8_t* host_ptr, PCIBase* obj)
+{
+    // FIXME: constrain region to memory range
+    return this->host_instance->pci_register_mem_aperture(start_addr, size, host_ptr, obj);
+}
+
+bool PCIBridgeBase::pci_unregister_mem_aperture(uint32_t start_addr, uint32_t size, PCIBase* obj)
+{
+    return this->host_instance->pci_unregister_mem_aperture(start_addr, size, obj);
+}
+
 uint32_t PCIBridgeBase::pci_cfg_read(uint32_t reg_offs, AccessDetails &details)
 {
     switch (reg_offs) {
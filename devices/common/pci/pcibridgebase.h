@@ -45,6 +45,8 @@ public:
     // PCIHost methods
     virtual bool pci_register_mmio_region(uint32_t start_addr, uint32_t size, PCIBase* obj);
     virtual bool pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCIBase* obj);
+    virtual bool pci_register_mem_aperture(uint32_t start_addr, uint32_t size, uint8_t* host_ptr, PCIBase* obj);
+    virtual bool pci_unregister_mem_aperture(uint32_t start_addr, uint32_t size, PCIBase* obj);
 
     // PCIBase methods
     virtual uint32_t pci_cfg_read(uint32_t reg_offs, AccessDetails &details);
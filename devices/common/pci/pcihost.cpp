@@ -19,6 +19,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cpu/ppc/ppcmmu.h>
 #include <devices/common/hwcomponent.h>
 #include <devices/common/pci/pcibridge.h>
 #include <devices/common/pci/pcihost.h>
@@ -91,7 +92,9 @@ bool PCIHost::pci_register_mmio_region(uint32_t start_addr, uint32_t size, PCIBa
     MemCtrlBase *mem_ctrl = dynamic_cast<MemCtrlBase *>
                            (gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
     // FIXME: add sanity checks!
-    return mem_ctrl->add_mmio_region(start_addr, size, obj);
+    bool result = mem_ctrl->add_mmio_region(start_addr, size, obj);
+    mmu_phys_map_changed();
+    return result;
 }
 
 bool PCIHost::pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCIBase* obj)
@@ -99,7 +102,30 @@ bool PCIHost::pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCI
     MemCtrlBase *mem_ctrl = dynamic_cast<MemCtrlBase *>
                            (gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
     // FIXME: add sanity checks!
-    return mem_ctrl->remove_mmio_region(start_addr, size, obj);
+    bool result = mem_ctrl->remove_mmio_region(start_addr, size, obj);
+    mmu_phys_map_changed();
+    return result;
+}
+
+bool PCIHost::pci_register_mem_aperture(uint32_t start_addr, uint32_t size, uint8_t* host_ptr,
+                                        PCIBase* obj)
+{
+    MemCtrlBase *mem_ctrl = dynamic_cast<MemCtrlBase *>
+                           (gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+    // FIXME: add sanity checks!
+    bool result = mem_ctrl->add_mem_aperture(start_addr, size, host_ptr, obj);
+    mmu_phys_map_changed();
+    return result;
+}
+
+bool PCIHost::pci_unregister_mem_aperture(uint32_t start_addr, uint32_t size, PCIBase* obj)
+{
+    MemCtrlBase *mem_ctrl = dynamic_cast<MemCtrlBase *>
+                           (gMachineObj->get_comp_by_type(HWCompType::MEM_CTRL));
+    // FIXME: add sanity checks!
+    bool result = mem_ctrl->remove_mem_aperture(start_addr, size, obj);
+    mmu_phys_map_changed();
+    return result;
 }
 
 void PCIHost::attach_pci_device(const std::string& dev_name, int slot_id)
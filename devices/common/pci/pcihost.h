@@ -65,6 +65,8 @@ public:
 
     virtual bool pci_register_mmio_region(uint32_t start_addr, uint32_t size, PCIBase* obj);
     virtual bool pci_unregister_mmio_region(uint32_t start_addr, uint32_t size, PCIBase* obj);
+    virtual bool pci_register_mem_aperture(uint32_t start_addr, uint32_t size, uint8_t* host_ptr, PCIBase* obj);
+    virtual bool pci_unregister_mem_aperture(uint32_t start_addr, uint32_t size, PCIBase* obj);
 
     virtual void attach_pci_device(const std::string& dev_name, int slot_id);
     PCIBase *attach_pci_device(const std::string& dev_name, int slot_id,
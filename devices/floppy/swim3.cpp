@@ -296,6 +296,7 @@ void Swim3Ctrl::start_disk_access()
     this->access_timer_id = TimerManager::get_instance()->add_oneshot_timer(
         this->int_drive->sync_to_disk(),
         [this]() {
+            this->access_timer_id = 0;
             this->cur_state = SWIM3_ADDR_MARK_SEARCH;
             this->disk_access();
         }
@@ -348,6 +349,7 @@ void Swim3Ctrl::disk_access()
     this->access_timer_id = TimerManager::get_instance()->add_oneshot_timer(
         delay,
         [this]() {
+            this->access_timer_id = 0;
             this->disk_access();
         }
     );
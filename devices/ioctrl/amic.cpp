@@ -573,9 +573,14 @@ void AmicSndOutDma::update_irq() {
     uint8_t new_level = !!((this->dma_out_ctrl >> 4) & this->dma_out_ctrl);
     if (new_level != this->irq_level) {
         this->irq_level = new_level;
-        TimerManager::get_instance()->add_immediate_timer([this] {
+        // hand the interrupt over to the emulation thread when
+        // called from the audio thread
+        if (TimerManager::get_instance()->on_timer_thread())
             this->int_ctrl->ack_dma_int(this->irq_id, this->irq_level);
-        });
+        else if (!TimerManager::get_instance()->post_event([this] {
+                this->int_ctrl->ack_dma_int(this->irq_id, this->irq_level);
+            }))
+            LOG_F(ERROR, "AMIC: event queue full, sound DMA interrupt lost");
     }
 }
 
@@ -667,6 +672,7 @@ int AmicFloppyDma::push_data(const char* src_ptr, int len)
         ABORT_F("AMIC: attempting DMA write to read-only memory");
     }
     std::memcpy(p_data, src_ptr, len);
+    mmu_dma_mem_written(this->addr_ptr, len);
 
     this->addr_ptr += len;
     this->byte_count -= len;
@@ -713,6 +719,7 @@ int AmicScsiDma::push_data(const char* src_ptr, int len)
     MapDmaResult res = mmu_map_dma_mem(this->addr_ptr, len, false);
     uint8_t *p_data = res.host_va;
     std::memcpy(p_data, src_ptr, len);
+    mmu_dma_mem_written(this->addr_ptr, len);
 
     this->addr_ptr += len;
 
@@ -23,11 +23,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <devices/common/mmiodevice.h>
 
 #include <algorithm>
+#include <bit>
 #include <cstring>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <loguru.hpp>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 MemCtrlBase::~MemCtrlBase() {
     for (auto& entry : address_map) {
         if (entry)
@@ -35,11 +42,49 @@ MemCtrlBase::~MemCtrlBase() {
     }
 
     for (auto& reg : mem_regions) {
-        if (reg)
-            delete (reg);
+        if (reg.fd >= 0) {
+#ifdef __linux__
+            munmap(reg.host_ptr, reg.size);
+            close(reg.fd);
+#endif
+        } else {
+            delete[] reg.host_ptr;
+        }
     }
     this->mem_regions.clear();
     this->address_map.clear();
+    this->range_index.clear();
+    this->sorted_map.clear();
+    this->dirty_maps.clear();
+}
+
+// Memory regions are allocated from shared memory objects where possible
+// so the CPU can map them at additional host addresses (see PPC_FASTMEM).
+static uint8_t* alloc_mem_region(uint32_t size, int& fd) {
+#ifdef __linux__
+    fd = memfd_create("dppc-mem", MFD_CLOEXEC);
+    if (fd >= 0) {
+        if (!ftruncate(fd, size)) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED)
+                return (uint8_t*)ptr; // zero-filled
+        }
+        close(fd);
+    }
+#endif
+    fd = -1;
+    return new uint8_t[size](); // allocate and clear to zero
+}
+
+bool MemCtrlBase::get_mem_backing(const uint8_t* host_ptr, int& fd, uint32_t& offset) {
+    for (auto& reg : mem_regions) {
+        if (reg.fd >= 0 && host_ptr >= reg.host_ptr && host_ptr < reg.host_ptr + reg.size) {
+            fd     = reg.fd;
+            offset = uint32_t(host_ptr - reg.host_ptr);
+            return true;
+        }
+    }
+    return false;
 }
 
 
@@ -52,11 +97,54 @@ static inline bool match_mem_entry(const AddressMapEntry* entry,
 }
 
 
-AddressMapEntry* MemCtrlBase::find_range(uint32_t addr) {
-    for (auto& entry : address_map) {
-        if (addr >= entry->start && addr <= entry->end)
-            return entry;
+// The address map is searched on every TLB miss and DMA mapping, and
+// PCI BAR writes add and remove MMIO regions at run time, so lookups go
+// through sorted copies of the map that are rebuilt whenever it changes.
+void MemCtrlBase::rebuild_range_index() {
+    this->sorted_map = this->address_map;
+    std::stable_sort(this->sorted_map.begin(), this->sorted_map.end(),
+        [](const AddressMapEntry* a, const AddressMapEntry* b) {
+            return a->start < b->start;
+        });
+
+    this->range_index.clear();
+    this->has_overlaps = false;
+
+    // give each entry the parts of its range not owned by an earlier entry
+    for (auto& entry : this->address_map) {
+        std::vector<RangeIndexEntry> parts;
+        uint64_t cur = entry->start;
+
+        for (auto& rng : this->range_index) {
+            if (cur > entry->end || rng.start > entry->end)
+                break;
+            if (rng.end < cur)
+                continue;
+            this->has_overlaps = true;
+            if (rng.start > cur)
+                parts.push_back({uint32_t(cur), rng.start - 1, entry});
+            cur = uint64_t(rng.end) + 1;
+        }
+        if (cur <= entry->end)
+            parts.push_back({uint32_t(cur), entry->end, entry});
+
+        this->range_index.insert(this->range_index.end(), parts.begin(), parts.end());
+        std::sort(this->range_index.begin(), this->range_index.end(),
+            [](const RangeIndexEntry& a, const RangeIndexEntry& b) {
+                return a.start < b.start;
+            });
     }
+}
+
+
+AddressMapEntry* MemCtrlBase::find_range(uint32_t addr) {
+    auto it = std::upper_bound(this->range_index.begin(), this->range_index.end(), addr,
+        [](uint32_t addr, const RangeIndexEntry& rng) {
+            return addr < rng.start;
+        });
+
+    if (it != this->range_index.begin() && addr <= (--it)->end)
+        return it->entry;
 
     return nullptr;
 }
@@ -67,9 +155,13 @@ AddressMapEntry* MemCtrlBase::find_range_exact(uint32_t addr, uint32_t size,
 {
     if (size) {
         const uint32_t end = addr + size - 1;
-        for (auto& entry : address_map) {
-            if (match_mem_entry(entry, addr, end, dev_instance))
-                return entry;
+        auto it = std::lower_bound(this->sorted_map.begin(), this->sorted_map.end(), addr,
+            [](const AddressMapEntry* entry, uint32_t addr) {
+                return entry->start < addr;
+            });
+        for (; it != this->sorted_map.end() && (*it)->start == addr; ++it) {
+            if (match_mem_entry(*it, addr, end, dev_instance))
+                return *it;
         }
     }
 
@@ -80,9 +172,16 @@ AddressMapEntry* MemCtrlBase::find_range_exact(uint32_t addr, uint32_t size,
 AddressMapEntry* MemCtrlBase::find_range_contains(uint32_t addr, uint32_t size) {
     if (size) {
         uint32_t end = addr + size - 1;
-        for (auto& entry : address_map) {
-            if (addr >= entry->start && end <= entry->end)
-                return entry;
+        AddressMapEntry* entry = find_range(addr);
+        if (!entry || end <= entry->end)
+            return entry;
+
+        // a mirror added later may still contain the whole range
+        if (this->has_overlaps) {
+            for (auto& entry : address_map) {
+                if (addr >= entry->start && end <= entry->end)
+                    return entry;
+            }
         }
     }
 
@@ -93,10 +192,14 @@ AddressMapEntry* MemCtrlBase::find_range_contains(uint32_t addr, uint32_t size)
 AddressMapEntry* MemCtrlBase::find_range_overlaps(uint32_t addr, uint32_t size) {
     if (size) {
         uint32_t end = addr + size - 1;
-        for (auto& entry : address_map) {
-            if (end >= entry->start && addr <= entry->end)
-                return entry;
-        }
+        auto it = std::upper_bound(this->range_index.begin(), this->range_index.end(), addr,
+            [](uint32_t addr, const RangeIndexEntry& rng) {
+                return addr < rng.start;
+            });
+        if (it != this->range_index.begin() && addr <= std::prev(it)->end)
+            return std::prev(it)->entry;
+        if (it != this->range_index.end() && end >= it->start)
+            return it->entry;
     }
 
     return nullptr;
@@ -107,7 +210,21 @@ bool MemCtrlBase::is_range_free(uint32_t addr, uint32_t size) {
     bool result = true;
     if (size) {
         uint32_t end = addr + size - 1;
-        for (auto& entry : address_map) {
+
+        // without overlapping entries, only the entry starting at or below
+        // addr and the ones starting inside the range can overlap it
+        auto it = this->sorted_map.begin();
+        if (!this->has_overlaps) {
+            it = std::upper_bound(this->sorted_map.begin(), this->sorted_map.end(), addr,
+                [](uint32_t addr, const AddressMapEntry* entry) {
+                    return addr < entry->start;
+                });
+            if (it != this->sorted_map.begin())
+                --it;
+        }
+
+        for (; it != this->sorted_map.end() && (*it)->start <= end; ++it) {
+            AddressMapEntry* entry = *it;
             if (addr == entry->start && end == entry->end) {
                 LOG_F(WARNING, "memory region 0x%X..0x%X%s%s%s already exists",
                     addr, end,
@@ -154,9 +271,12 @@ bool MemCtrlBase::add_mem_region(uint32_t start_addr, uint32_t size,
     if (!is_range_free(start_addr, size))
         return false;
 
-    uint8_t* reg_content = new uint8_t[size](); // allocate and clear to zero
+    int reg_fd;
+    uint8_t* reg_content = alloc_mem_region(size, reg_fd);
 
-    this->mem_regions.push_back(reg_content);
+    this->mem_regions.push_back({reg_content, size, reg_fd});
+    if (type == RT_RAM)
+        this->add_dirty_page_map(reg_content, size);
 
     entry = new AddressMapEntry;
 
@@ -169,6 +289,8 @@ bool MemCtrlBase::add_mem_region(uint32_t start_addr, uint32_t size,
     entry->mem_ptr = reg_content;
 
     this->address_map.push_back(entry);
+    this->rebuild_range_index();
+    this->map_gen++;
 
     LOG_F(INFO, "Added mem region 0x%X..0x%X (%s%s%s%s) -> 0x%X", start_addr, end,
         entry->type & RT_ROM ? "ROM," : "",
@@ -221,6 +343,8 @@ bool MemCtrlBase::add_mem_mirror_common(uint32_t start_addr, uint32_t dest_addr,
     entry->mem_ptr = ref_entry->mem_ptr + offset;
 
     this->address_map.push_back(entry);
+    this->rebuild_range_index();
+    this->map_gen++;
 
     LOG_F(INFO, "Added mem region mirror 0x%X..0x%X (%s%s%s%s) -> 0x%X : 0x%X..0x%X%s%s%s",
         start_addr, end,
@@ -251,6 +375,15 @@ bool MemCtrlBase::add_mem_mirror_partial(uint32_t start_addr, uint32_t dest_addr
 }
 
 
+void MemCtrlBase::move_mem_region(AddressMapEntry* entry, uint32_t new_start) {
+    entry->end   = new_start + (entry->end - entry->start);
+    entry->start = new_start;
+
+    this->rebuild_range_index();
+    this->map_gen++;
+}
+
+
 bool MemCtrlBase::set_data(uint32_t load_addr, const uint8_t* data, uint32_t size) {
     AddressMapEntry* ref_entry;
     uint32_t cpy_size;
@@ -287,6 +420,7 @@ bool MemCtrlBase::add_mmio_region(uint32_t start_addr, uint32_t size, MMIODevice
     entry->mem_ptr = 0;
 
     this->address_map.push_back(entry);
+    this->rebuild_range_index();
 
     LOG_F(INFO, "Added mmio region 0x%X..0x%X%s%s%s",
         start_addr, end,
@@ -312,6 +446,8 @@ bool MemCtrlBase::remove_mmio_region(uint32_t start_addr, uint32_t size, MMIODev
         }
     ), address_map.end());
 
+    this->rebuild_range_index();
+
     if (found == 0)
         LOG_F(ERROR, "Cannot find mmio region 0x%X..0x%X%s%s%s to remove",
             start_addr, end,
@@ -340,6 +476,207 @@ bool MemCtrlBase::remove_mmio_region(uint32_t start_addr, uint32_t size, MMIODev
     return (found > 0);
 }
 
+// Device memory is mapped like RAM so that the CPU can access it directly
+// instead of going through the MMIO callbacks of the device. The memory
+// stays owned by the device.
+bool MemCtrlBase::add_mem_aperture(uint32_t start_addr, uint32_t size, uint8_t* host_ptr,
+                                   MMIODevice* dev_instance)
+{
+    AddressMapEntry *entry;
+
+    // bail out if a memory region for the given range already exists
+    if (!is_range_free(start_addr, size))
+        return false;
+
+    entry = new AddressMapEntry;
+
+    uint32_t end   = start_addr + size - 1;
+    entry->start   = start_addr;
+    entry->end     = end;
+    entry->mirror  = 0;
+    entry->type    = RT_RAM;
+    entry->devobj  = dev_instance;
+    entry->mem_ptr = host_ptr;
+
+    this->address_map.push_back(entry);
+    this->rebuild_range_index();
+    this->map_gen++;
+
+    // device memory keeps its dirty state while the aperture moves around
+    if (!this->find_dirty_page_map(host_ptr, size))
+        this->add_dirty_page_map(host_ptr, size);
+
+    LOG_F(INFO, "Added mem aperture 0x%X..0x%X%s%s%s",
+        start_addr, end,
+        dev_instance ? " (" : "",
+            dev_instance ? dev_instance->get_name().c_str() : "",
+            dev_instance ? ")"
+            : ""
+    );
+
+    return true;
+}
+
+bool MemCtrlBase::remove_mem_aperture(uint32_t start_addr, uint32_t size, MMIODevice* dev_instance)
+{
+    if (!this->remove_mmio_region(start_addr, size, dev_instance))
+        return false;
+
+    this->map_gen++;
+    return true;
+}
+
+void MemCtrlBase::add_dirty_page_map(uint8_t* host_ptr, uint32_t size) {
+    const uint32_t num_pages = uint32_t((uint64_t(size) + (1 << DIRTY_PAGE_BITS) - 1)
+                                        >> DIRTY_PAGE_BITS);
+    const uint32_t num_words = (num_pages + 63) >> 6;
+
+    DirtyPageMap map = {host_ptr, size,
+                        std::make_unique<std::atomic<uint64_t>[]>(num_words)};
+
+    // all pages start out dirty
+    for (uint32_t i = 0; i < num_words; i++)
+        map.bits[i].store(~0ULL, std::memory_order_relaxed);
+
+    this->dirty_maps.push_back(std::move(map));
+}
+
+DirtyPageMap* MemCtrlBase::find_dirty_page_map(const uint8_t* host_ptr, uint32_t size) {
+    for (auto& map : this->dirty_maps) {
+        uintptr_t offset = host_ptr - map.host_ptr;
+        if (offset < map.size && offset + size <= map.size)
+            return &map;
+    }
+    return nullptr;
+}
+
+const uint8_t* MemCtrlBase::get_dirty_page_start(const uint8_t* host_ptr) {
+    DirtyPageMap* map = this->find_dirty_page_map(host_ptr, 1);
+    if (!map)
+        return nullptr;
+
+    return map->host_ptr +
+        (uint32_t(host_ptr - map->host_ptr) & ~((1U << DIRTY_PAGE_BITS) - 1));
+}
+
+// Report a change of the dirty state of host memory for every physical
+// address range mapping it, mirrors and apertures included.
+void MemCtrlBase::notify_dirty_aliases(const uint8_t* host_ptr, uint32_t size, bool is_clean) {
+    if (!this->notify_dirty_change)
+        return;
+
+    const uintptr_t start = uintptr_t(host_ptr);
+    const uintptr_t end   = start + size;
+
+    for (auto& entry : this->address_map) {
+        if (!(entry->type & RT_RAM))
+            continue;
+
+        const uintptr_t rgn_start = uintptr_t(entry->mem_ptr);
+        const uintptr_t rgn_end   = rgn_start + (entry->end - entry->start) + 1;
+        const uintptr_t lo = std::max(start, rgn_start);
+        const uintptr_t hi = std::min(end, rgn_end);
+        if (lo < hi)
+            this->notify_dirty_change(entry->start + uint32_t(lo - rgn_start),
+                                      uint32_t(hi - lo), is_clean);
+    }
+}
+
+bool MemCtrlBase::harvest_dirty_pages(uint32_t start_addr, uint32_t size,
+                                      std::vector<uint64_t>& dirty)
+{
+    AddressMapEntry* entry = this->find_range_contains(start_addr, size);
+    if (!entry || !(entry->type & RT_RAM))
+        return false;
+
+    return this->harvest_dirty_pages(entry->mem_ptr + (start_addr - entry->start),
+                                     size, dirty);
+}
+
+bool MemCtrlBase::harvest_dirty_pages(const uint8_t* host_ptr, uint32_t size,
+                                      std::vector<uint64_t>& dirty)
+{
+    DirtyPageMap* map = this->find_dirty_page_map(host_ptr, size);
+    if (!map || !size)
+        return false;
+
+    const uint32_t offset     = uint32_t(host_ptr - map->host_ptr);
+    const uint32_t first_page = offset >> DIRTY_PAGE_BITS;
+    const uint32_t last_page  = (offset + size - 1) >> DIRTY_PAGE_BITS;
+
+    dirty.assign(((last_page - first_page) >> 6) + 1, 0);
+
+    uint32_t num_cleaned = 0;
+
+    for (uint32_t page = first_page; page <= last_page;) {
+        const uint32_t bit   = page & 63;
+        const uint32_t count = std::min(64 - bit, last_page - page + 1);
+        const uint64_t mask  = ((count == 64) ? ~0ULL : ((1ULL << count) - 1)) << bit;
+
+        uint64_t bits = map->bits[page >> 6].fetch_and(~mask) & mask;
+        num_cleaned += std::popcount(bits);
+
+        for (bits >>= bit; bits; bits &= bits - 1) {
+            uint32_t idx = page - first_page + std::countr_zero(bits);
+            dirty[idx >> 6] |= 1ULL << (idx & 63);
+        }
+
+        page += count;
+    }
+
+    if (num_cleaned) {
+        this->num_clean_pages += num_cleaned;
+        this->notify_dirty_aliases(map->host_ptr + (first_page << DIRTY_PAGE_BITS),
+                                   (last_page - first_page + 1) << DIRTY_PAGE_BITS, true);
+    }
+
+    return true;
+}
+
+void MemCtrlBase::mark_pages_dirty(uint32_t addr, uint32_t size) {
+    if (!this->num_clean_pages || !size)
+        return;
+
+    AddressMapEntry* entry = this->find_range_contains(addr, size);
+    if (!entry || !(entry->type & RT_RAM))
+        return;
+
+    this->mark_pages_dirty(entry->mem_ptr + (addr - entry->start), size);
+}
+
+void MemCtrlBase::mark_pages_dirty(const uint8_t* host_ptr, uint32_t size) {
+    if (!this->num_clean_pages || !size)
+        return;
+
+    for (auto& map : this->dirty_maps) {
+        uintptr_t offset = host_ptr - map.host_ptr;
+        if (offset >= map.size)
+            continue;
+
+        const uint32_t first_page = uint32_t(offset >> DIRTY_PAGE_BITS);
+        const uint32_t last_page  = uint32_t(
+            (std::min<uint64_t>(offset + size, map.size) - 1) >> DIRTY_PAGE_BITS);
+
+        uint32_t num_dirtied = 0;
+
+        for (uint32_t page = first_page; page <= last_page;) {
+            const uint32_t bit   = page & 63;
+            const uint32_t count = std::min(64 - bit, last_page - page + 1);
+            const uint64_t mask  = ((count == 64) ? ~0ULL : ((1ULL << count) - 1)) << bit;
+
+            num_dirtied += std::popcount(~map.bits[page >> 6].fetch_or(mask) & mask);
+            page += count;
+        }
+
+        if (num_dirtied) {
+            this->num_clean_pages -= num_dirtied;
+            this->notify_dirty_aliases(map.host_ptr + (first_page << DIRTY_PAGE_BITS),
+                                       (last_page - first_page + 1) << DIRTY_PAGE_BITS, false);
+        }
+        return;
+    }
+}
+
 AddressMapEntry* MemCtrlBase::find_rom_region()
 {
     for (auto& entry : address_map) {
@@ -22,7 +22,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef MEMORY_CONTROLLER_BASE_H
 #define MEMORY_CONTROLLER_BASE_H
 
+#include <atomic>
 #include <cinttypes>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -59,6 +62,16 @@ typedef struct AddressMapEntry {
 } AddressMapEntry;
 
 
+#define DIRTY_PAGE_BITS 12 // dirty state is tracked per 4 KB page
+
+/** Dirty state of the pages of a host memory block backing guest memory. */
+typedef struct DirtyPageMap {
+    uint8_t*                                    host_ptr;
+    uint32_t                                    size;
+    std::unique_ptr<std::atomic<uint64_t>[]>    bits; // set for dirty pages
+} DirtyPageMap;
+
+
 /** Base class for memory controllers. */
 class MemCtrlBase {
 public:
@@ -75,6 +88,12 @@ public:
     virtual bool remove_mmio_region(uint32_t start_addr, uint32_t size,
                                     MMIODevice* dev_instance);
 
+    // Device memory (e.g. VRAM) accessed by the CPU like RAM.
+    virtual bool add_mem_aperture(uint32_t start_addr, uint32_t size,
+                                  uint8_t* host_ptr, MMIODevice* dev_instance);
+    virtual bool remove_mem_aperture(uint32_t start_addr, uint32_t size,
+                                     MMIODevice* dev_instance);
+
     virtual bool set_data(uint32_t reg_addr, const uint8_t* data, uint32_t size);
 
     AddressMapEntry* find_range(uint32_t addr);
@@ -86,6 +105,48 @@ public:
 
     AddressMapEntry* find_rom_region();
 
+    const std::vector<AddressMapEntry*>& get_address_map() const {
+        return this->address_map;
+    }
+
+    // Look up the shared memory object backing a memory region.
+    // Returns false if host_ptr doesn't point into shared memory.
+    bool get_mem_backing(const uint8_t* host_ptr, int& fd, uint32_t& offset);
+
+    // Changes whenever memory regions are added or moved.
+    uint32_t get_map_gen() const {
+        return this->map_gen;
+    }
+
+    // Dirty page tracking for RAM and device memory. Pages are dirty until
+    // their state is harvested and become dirty again on their next write.
+    // Harvesting returns one bit per page, set for pages written since the
+    // last harvest, and resets them. Must be called from the emulation thread.
+    bool harvest_dirty_pages(uint32_t start_addr, uint32_t size, std::vector<uint64_t>& dirty);
+    bool harvest_dirty_pages(const uint8_t* host_ptr, uint32_t size, std::vector<uint64_t>& dirty);
+    void mark_pages_dirty(uint32_t addr, uint32_t size);
+    void mark_pages_dirty(const uint8_t* host_ptr, uint32_t size);
+
+    // Start of the tracked page holding host_ptr, nullptr if untracked.
+    const uint8_t* get_dirty_page_start(const uint8_t* host_ptr);
+
+    bool is_page_clean(const uint8_t* host_ptr) const {
+        if (!this->num_clean_pages)
+            return false;
+        for (const auto& map : this->dirty_maps) {
+            uintptr_t offset = host_ptr - map.host_ptr;
+            if (offset < map.size) {
+                uint32_t page = uint32_t(offset >> DIRTY_PAGE_BITS);
+                return !((map.bits[page >> 6].load(std::memory_order_relaxed) >> (page & 63)) & 1);
+            }
+        }
+        return false;
+    }
+
+    // Called for each physical range whose pages became clean or dirty.
+    std::function<void(uint32_t start_addr, uint32_t size, bool is_clean)>
+        notify_dirty_change = nullptr;
+
 protected:
     bool add_mem_region(
         uint32_t start_addr, uint32_t size, uint32_t dest_addr, uint32_t type,
@@ -95,9 +156,43 @@ protected:
     bool add_mem_mirror_common(uint32_t start_addr, uint32_t dest_addr,
                                uint32_t offset=0, uint32_t size=0);
 
+    // Moves an existing memory region to a new start address.
+    void move_mem_region(AddressMapEntry* entry, uint32_t new_start);
+
+    uint32_t map_gen = 0;
+
 private:
-    std::vector<uint8_t*> mem_regions;
-    std::vector<AddressMapEntry*> address_map;
+    /** Host memory allocated for a RAM or ROM region. */
+    typedef struct MemRegion {
+        uint8_t*    host_ptr;
+        uint32_t    size;
+        int         fd; // shared memory object or -1
+    } MemRegion;
+
+    /** Part of the address space decoded by a single address map entry. */
+    typedef struct RangeIndexEntry {
+        uint32_t            start;
+        uint32_t            end;
+        AddressMapEntry*    entry;
+    } RangeIndexEntry;
+
+    void rebuild_range_index();
+    void add_dirty_page_map(uint8_t* host_ptr, uint32_t size);
+    DirtyPageMap* find_dirty_page_map(const uint8_t* host_ptr, uint32_t size);
+    void notify_dirty_aliases(const uint8_t* host_ptr, uint32_t size, bool is_clean);
+
+    std::vector<MemRegion> mem_regions;
+    std::vector<AddressMapEntry*> address_map; // in order of insertion
+
+    // Lookup structures derived from address_map by rebuild_range_index().
+    // range_index splits the address map into sorted, non-overlapping ranges.
+    // Where entries overlap (mirrors), the entry added first owns the range.
+    std::vector<RangeIndexEntry>  range_index;
+    std::vector<AddressMapEntry*> sorted_map;   // sorted by start address
+    bool                          has_overlaps = false;
+
+    std::vector<DirtyPageMap>     dirty_maps;
+    uint32_t                      num_clean_pages = 0;
 };
 
 #endif // MEMORY_CONTROLLER_BASE_H
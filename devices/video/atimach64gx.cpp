@@ -166,28 +166,40 @@ AtiMach64Gx::AtiMach64Gx()
     set_bit(regs[ATI_CRTC_GEN_CNTL], ATI_CRTC_DISPLAY_DIS); // because blank_on is true
 }
 
-void AtiMach64Gx::change_one_bar(uint32_t &aperture, uint32_t aperture_size, uint32_t aperture_new, int bar_num) {
-    if (aperture != aperture_new) {
-        if (aperture)
-            this->host_instance->pci_unregister_mmio_region(aperture, aperture_size, this);
+void AtiMach64Gx::notify_bar_change(int bar_num)
+{
+    if (bar_num) // only BAR0 is supported
+        return;
 
-        aperture = aperture_new;
-        if (aperture)
-            this->host_instance->pci_register_mmio_region(aperture, aperture_size, this);
+    if (this->aperture_base[0] != (this->bars[0] & ~15)) {
+        if (this->aperture_base[0])
+            this->map_main_aperture(false);
 
-        LOG_F(INFO, "%s: aperture[%d] set to 0x%08X", this->name.c_str(), bar_num, aperture);
+        this->aperture_base[0] = this->bars[0] & ~15;
+        if (this->aperture_base[0])
+            this->map_main_aperture(true);
+
+        LOG_F(INFO, "%s: aperture[0] set to 0x%08X", this->name.c_str(), this->aperture_base[0]);
     }
+
+    // copy aperture address to CONFIG_CNTL:CFG_MEM_AP_LOC
+    insert_bits<uint32_t>(this->config_cntl, this->aperture_base[0] >> 22, ATI_CFG_MEM_AP_LOC, ATI_CFG_MEM_AP_LOC_size);
 }
 
-void AtiMach64Gx::notify_bar_change(int bar_num)
-{
-    if (bar_num) // only BAR0 is supported
-        return;
+// VRAM at the start of the main aperture is mapped like RAM so guest
+// accesses to the frame buffer bypass read() and write().
+void AtiMach64Gx::map_main_aperture(bool map) {
+    const uint32_t base = this->aperture_base[0];
 
-    {
-        change_one_bar(this->aperture_base[bar_num], this->aperture_size[bar_num], this->bars[bar_num] & ~15, bar_num);
-        // copy aperture address to CONFIG_CNTL:CFG_MEM_AP_LOC
-        insert_bits<uint32_t>(this->config_cntl, this->aperture_base[0] >> 22, ATI_CFG_MEM_AP_LOC, ATI_CFG_MEM_AP_LOC_size);
+    if (map) {
+        this->host_instance->pci_register_mem_aperture(base, this->vram_size,
+                                                       this->vram_ptr.get(), this);
+        this->host_instance->pci_register_mmio_region(base + this->vram_size,
+            this->aperture_size[0] - this->vram_size, this);
+    } else {
+        this->host_instance->pci_unregister_mem_aperture(base, this->vram_size, this);
+        this->host_instance->pci_unregister_mmio_region(base + this->vram_size,
+            this->aperture_size[0] - this->vram_size, this);
     }
 }
 
@@ -521,6 +533,12 @@ void AtiMach64Gx::write_reg(uint32_t reg_offset, uint32_t value, uint32_t size)
 
 uint32_t AtiMach64Gx::read(uint32_t rgn_start, uint32_t offset, int size)
 {
+    // register part of the main aperture is mapped as a separate region
+    if (rgn_start == this->aperture_base[0] + this->vram_size) {
+        offset   += this->vram_size;
+        rgn_start = this->aperture_base[0];
+    }
+
     if (rgn_start == this->aperture_base[0]) {
         if (offset < this->vram_size) {
             return read_mem(&this->vram_ptr[offset], size);
@@ -543,6 +561,12 @@ uint32_t AtiMach64Gx::read(uint32_t rgn_start, uint32_t offset, int size)
 
 void AtiMach64Gx::write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size)
 {
+    // register part of the main aperture is mapped as a separate region
+    if (rgn_start == this->aperture_base[0] + this->vram_size) {
+        offset   += this->vram_size;
+        rgn_start = this->aperture_base[0];
+    }
+
     if (rgn_start == this->aperture_base[0]) {
         if (offset < this->vram_size) {
             return write_mem(&this->vram_ptr[offset], value, size);
@@ -71,7 +71,7 @@ protected:
     void get_cursor_position(int& x, int& y);
 
 private:
-    void change_one_bar(uint32_t &aperture, uint32_t aperture_size, uint32_t aperture_new, int bar_num);
+    void map_main_aperture(bool map);
 
     uint32_t    regs[256] = {}; // internal registers
 
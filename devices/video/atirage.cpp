@@ -29,6 +29,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <loguru.hpp>
 #include <memaccess.h>
 
+#include <algorithm>
 #include <map>
 
 /* Mach64 post dividers. */
@@ -162,13 +163,60 @@ void ATIRage::change_one_bar(uint32_t &aperture, uint32_t aperture_size,
     }
 }
 
+void ATIRage::change_main_aperture(uint32_t aperture_new) {
+    if (this->aperture_base[0] != aperture_new) {
+        if (this->aperture_base[0])
+            this->map_main_aperture(false);
+
+        this->aperture_base[0] = aperture_new;
+        if (this->aperture_base[0])
+            this->map_main_aperture(true);
+
+        LOG_F(INFO, "%s: aperture[0] set to 0x%08X", this->name.c_str(),
+              this->aperture_base[0]);
+    }
+}
+
+// The little-endian and big-endian VRAM windows of the main aperture are
+// mapped like RAM so guest accesses to the frame buffer bypass read() and
+// write(). The rest of the aperture holds the memory-mapped registers.
+void ATIRage::map_main_aperture(bool map) {
+    const uint32_t base    = this->aperture_base[0];
+    const uint32_t be_offs = BE_FB_OFFSET;
+    const uint32_t decoded = this->aperture_size[0] - this->vram_size;
+    const uint32_t be_size = std::min(this->vram_size, decoded - be_offs);
+
+    const struct {
+        uint32_t offset;
+        uint32_t size;
+        bool     is_vram;
+    } spans[] = {
+        {0,                 this->vram_size,              true},
+        {this->vram_size,   be_offs - this->vram_size,    false},
+        {be_offs,           be_size,                      true},
+        {be_offs + be_size, decoded - be_offs - be_size,  false},
+    };
+
+    for (const auto& span : spans) {
+        if (!span.size)
+            continue;
+        if (span.is_vram && map)
+            this->host_instance->pci_register_mem_aperture(base + span.offset, span.size,
+                                                           this->vram_ptr.get(), this);
+        else if (span.is_vram)
+            this->host_instance->pci_unregister_mem_aperture(base + span.offset, span.size, this);
+        else if (map)
+            this->host_instance->pci_register_mmio_region(base + span.offset, span.size, this);
+        else
+            this->host_instance->pci_unregister_mmio_region(base + span.offset, span.size, this);
+    }
+}
+
 void ATIRage::notify_bar_change(int bar_num)
 {
     switch (bar_num) {
     case 0:
-        change_one_bar(this->aperture_base[bar_num],
-                       this->aperture_size[bar_num] - this->vram_size,
-                       this->bars[bar_num] & ~15, bar_num);
+        change_main_aperture(this->bars[bar_num] & ~15);
         break;
     case 2:
         change_one_bar(this->aperture_base[bar_num],
@@ -401,7 +449,6 @@ void ATIRage::write_reg(uint32_t reg_offset, uint32_t value, uint32_t size) {
     case ATI_CUR_HORZ_VERT_POSN:
     case ATI_CUR_HORZ_VERT_OFF:
         new_value = value;
-        draw_fb = true;
         break;
     case ATI_GP_IO:
         new_value = value;
@@ -466,7 +513,6 @@ void ATIRage::write_reg(uint32_t reg_offset, uint32_t value, uint32_t size) {
                 this->setup_hw_cursor();
             else
                 this->cursor_on = false;
-            draw_fb = true;
         }
         if (bit_changed(old_value, new_value, ATI_GEN_GUI_RESETB)) {
             if (!bit_set(new_value, ATI_GEN_GUI_RESETB))
@@ -536,6 +582,12 @@ bool ATIRage::pci_io_write(uint32_t offset, uint32_t value, uint32_t size) {
 
 uint32_t ATIRage::read(uint32_t rgn_start, uint32_t offset, int size)
 {
+    // register parts of the main aperture are mapped as separate regions
+    if (this->aperture_base[0] && rgn_start - this->aperture_base[0] < this->aperture_size[0]) {
+        offset   += rgn_start - this->aperture_base[0];
+        rgn_start = this->aperture_base[0];
+    }
+
     if (rgn_start == this->aperture_base[0] && offset < this->aperture_size[0]) {
         if (offset < this->vram_size) { // little-endian VRAM region
             return read_mem(&this->vram_ptr[offset], size);
@@ -571,6 +623,12 @@ uint32_t ATIRage::read(uint32_t rgn_start, uint32_t offset, int size)
 
 void ATIRage::write(uint32_t rgn_start, uint32_t offset, uint32_t value, int size)
 {
+    // register parts of the main aperture are mapped as separate regions
+    if (this->aperture_base[0] && rgn_start - this->aperture_base[0] < this->aperture_size[0]) {
+        offset   += rgn_start - this->aperture_base[0];
+        rgn_start = this->aperture_base[0];
+    }
+
     if (rgn_start == this->aperture_base[0] && offset < this->aperture_size[0]) {
         if (offset < this->vram_size) { // little-endian VRAM region
             draw_fb = true;
@@ -735,45 +793,38 @@ void ATIRage::crtc_update() {
     switch (this->pixel_format) {
     case 1:
         this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-            draw_fb = false;
             this->convert_frame_4bpp_indexed(dst_buf, dst_pitch);
         };
         break;
     case 2:
         if (bit_set(this->regs[ATI_DAC_CNTL], ATI_DAC_DIRECT)) {
             this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-                draw_fb = false;
                 this->convert_frame_8bpp(dst_buf, dst_pitch);
             };
         }
         else {
             this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-                draw_fb = false;
                 this->convert_frame_8bpp_indexed(dst_buf, dst_pitch);
             };
         }
         break;
     case 3:
         this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-            draw_fb = false;
             this->convert_frame_15bpp_BE(dst_buf, dst_pitch);
         };
         break;
     case 4:
         this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-            draw_fb = false;
             this->convert_frame_16bpp(dst_buf, dst_pitch);
         };
         break;
     case 5:
         this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-            draw_fb = false;
             this->convert_frame_24bpp(dst_buf, dst_pitch);
         };
         break;
     case 6:
         this->convert_fb_cb = [this](uint8_t *dst_buf, int dst_pitch) {
-            draw_fb = false;
             this->convert_frame_32bpp_BE(dst_buf, dst_pitch);
         };
         break;
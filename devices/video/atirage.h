@@ -85,6 +85,8 @@ protected:
 private:
     void change_one_bar(uint32_t &aperture, uint32_t aperture_size,
                         uint32_t aperture_new, int bar_num);
+    void change_main_aperture(uint32_t aperture_new);
+    void map_main_aperture(bool map);
 
     uint32_t    regs[512] = {}; // internal registers
     uint8_t     plls[64]  = {}; // internal PLL registers
@@ -45,6 +45,18 @@ public:
                 std::function<void(uint8_t *dst_buf, int dst_pitch)> cursor_ovl_cb,
                 bool draw_hw_cursor, int cursor_x, int cursor_y);
 
+    // Converts num_rows rows of the guest framebuffer starting at first_row.
+    // The callback receives the texture position of first_row.
+    void update_rows(std::function<void(uint8_t *dst_buf, int dst_pitch)> convert_fb_cb,
+                     int first_row, int num_rows);
+
+    // Shows the converted frame, HW cursor included.
+    void present(bool draw_hw_cursor, int cursor_x, int cursor_y);
+
+    // Returns true if the window contents were lost and need to be presented.
+    bool needs_present();
+
+    // Window event handler, called on the host thread.
     void handle_events(const WindowEvent& wnd_event);
     void setup_hw_cursor(std::function<void(uint8_t *dst_buf, int dst_pitch)> draw_hw_cursor,
                          int cursor_width, int cursor_height);
@@ -23,9 +23,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <SDL.h>
 #include <loguru.hpp>
 
+#include <atomic>
+
 class Display::Impl {
 public:
     bool            resizing = false;
+    std::atomic<bool> exposed{false}; // written on the host thread only
+    int             width = 0;
     uint32_t        disp_wnd_id = 0;
     SDL_Window*     display_wnd = 0;
     SDL_Renderer*   renderer = 0;
@@ -37,131 +41,185 @@ public:
 Display::Display(): impl(std::make_unique<Impl>()) {
 }
 
+// SDL windows belong to the host thread, so every method below
+// hands its SDL work over to it.
+
 Display::~Display() {
-    if (impl->cursor_texture)
-        SDL_DestroyTexture(impl->cursor_texture);
+    EventManager::get_instance()->call_on_host([this]() {
+        if (impl->cursor_texture)
+            SDL_DestroyTexture(impl->cursor_texture);
 
-    if (impl->disp_texture)
-        SDL_DestroyTexture(impl->disp_texture);
+        if (impl->disp_texture)
+            SDL_DestroyTexture(impl->disp_texture);
 
-    if (impl->renderer)
-        SDL_DestroyRenderer(impl->renderer);
+        if (impl->renderer)
+            SDL_DestroyRenderer(impl->renderer);
 
-    if (impl->display_wnd)
-        SDL_DestroyWindow(impl->display_wnd);
+        if (impl->display_wnd)
+            SDL_DestroyWindow(impl->display_wnd);
+    });
 }
 
 bool Display::configure(int width, int height) {
     bool is_initialization = false;
 
-    if (!impl->display_wnd) { // create display window
-        impl->display_wnd = SDL_CreateWindow(
-            SDL_GetRelativeMouseMode() ?
-                "DingusPPC Display (Mouse Grabbed)" : "DingusPPC Display",
-            SDL_WINDOWPOS_UNDEFINED,
-            SDL_WINDOWPOS_UNDEFINED,
-            width, height,
-            SDL_WINDOW_OPENGL
+    EventManager::get_instance()->call_on_host([&]() {
+        if (!impl->display_wnd) { // create display window
+            impl->display_wnd = SDL_CreateWindow(
+                SDL_GetRelativeMouseMode() ?
+                    "DingusPPC Display (Mouse Grabbed)" : "DingusPPC Display",
+                SDL_WINDOWPOS_UNDEFINED,
+                SDL_WINDOWPOS_UNDEFINED,
+                width, height,
+                SDL_WINDOW_OPENGL
+            );
+
+            impl->disp_wnd_id = SDL_GetWindowID(impl->display_wnd);
+            if (impl->display_wnd == NULL)
+                ABORT_F("Display: SDL_CreateWindow failed with %s", SDL_GetError());
+
+            impl->renderer = SDL_CreateRenderer(impl->display_wnd, -1, SDL_RENDERER_ACCELERATED);
+            if (impl->renderer == NULL)
+                ABORT_F("Display: SDL_CreateRenderer failed with %s", SDL_GetError());
+
+            is_initialization = true;
+        } else { // resize display window
+            SDL_SetWindowSize(impl->display_wnd, width, height);
+        }
+
+        if (impl->disp_texture)
+            SDL_DestroyTexture(impl->disp_texture);
+
+        impl->disp_texture = SDL_CreateTexture(
+            impl->renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            width, height
         );
 
-        impl->disp_wnd_id = SDL_GetWindowID(impl->display_wnd);
-        if (impl->display_wnd == NULL)
-            ABORT_F("Display: SDL_CreateWindow failed with %s", SDL_GetError());
-
-        impl->renderer = SDL_CreateRenderer(impl->display_wnd, -1, SDL_RENDERER_ACCELERATED);
-        if (impl->renderer == NULL)
-            ABORT_F("Display: SDL_CreateRenderer failed with %s", SDL_GetError());
-
-        is_initialization = true;
-    } else { // resize display window
-        SDL_SetWindowSize(impl->display_wnd, width, height);
-    }
-
-    if (impl->disp_texture)
-        SDL_DestroyTexture(impl->disp_texture);
-
-    impl->disp_texture = SDL_CreateTexture(
-        impl->renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        width, height
-    );
+        if (impl->disp_texture == NULL)
+            ABORT_F("Display: SDL_CreateTexture failed with %s", SDL_GetError());
 
-    if (impl->disp_texture == NULL)
-        ABORT_F("Display: SDL_CreateTexture failed with %s", SDL_GetError());
+        impl->width = width;
+    });
 
     return is_initialization;
 }
 
+// called on the host thread
 void Display::handle_events(const WindowEvent& wnd_event) {
-    if (wnd_event.sub_type == SDL_WINDOWEVENT_SIZE_CHANGED &&
-        wnd_event.window_id == impl->disp_wnd_id)
+    if (wnd_event.window_id != impl->disp_wnd_id)
+        return;
+
+    if (wnd_event.sub_type == SDL_WINDOWEVENT_SIZE_CHANGED)
         impl->resizing = false;
+    else if (wnd_event.sub_type == SDL_WINDOWEVENT_EXPOSED)
+        impl->exposed = true;
 }
 
 void Display::blank() {
-    SDL_SetRenderDrawColor(impl->renderer, 0, 0, 0, 255);
-    SDL_RenderClear(impl->renderer);
-    SDL_RenderPresent(impl->renderer);
+    EventManager::get_instance()->call_on_host([this]() {
+        SDL_SetRenderDrawColor(impl->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(impl->renderer);
+        SDL_RenderPresent(impl->renderer);
+    });
 }
 
 void Display::update(std::function<void(uint8_t *dst_buf, int dst_pitch)> convert_fb_cb,
                      std::function<void(uint8_t *dst_buf, int dst_pitch)> cursor_ovl_cb,
                      bool draw_hw_cursor, int cursor_x, int cursor_y) {
-    if (impl->resizing)
-        return;
+    EventManager::get_instance()->call_on_host([&]() {
+        if (impl->resizing)
+            return;
+
+        uint8_t*    dst_buf;
+        int         dst_pitch;
+
+        SDL_LockTexture(impl->disp_texture, NULL, (void **)&dst_buf, &dst_pitch);
 
-    uint8_t*    dst_buf;
-    int         dst_pitch;
+        // texture update callback to get ARGB data from guest framebuffer
+        convert_fb_cb(dst_buf, dst_pitch);
 
-    SDL_LockTexture(impl->disp_texture, NULL, (void **)&dst_buf, &dst_pitch);
+        // overlay cursor data if requested
+        if (cursor_ovl_cb != nullptr)
+            cursor_ovl_cb(dst_buf, dst_pitch);
 
-    // texture update callback to get ARGB data from guest framebuffer
-    convert_fb_cb(dst_buf, dst_pitch);
+        SDL_UnlockTexture(impl->disp_texture);
 
-    // overlay cursor data if requested
-    if (cursor_ovl_cb != nullptr)
-        cursor_ovl_cb(dst_buf, dst_pitch);
+        this->present(draw_hw_cursor, cursor_x, cursor_y);
+    });
+}
+
+void Display::update_rows(std::function<void(uint8_t *dst_buf, int dst_pitch)> convert_fb_cb,
+                          int first_row, int num_rows) {
+    EventManager::get_instance()->call_on_host([&]() {
+        if (impl->resizing)
+            return;
+
+        uint8_t*    dst_buf;
+        int         dst_pitch;
+        SDL_Rect    rows_rect = {0, first_row, impl->width, num_rows};
+
+        // only the locked rows get uploaded to the texture
+        SDL_LockTexture(impl->disp_texture, &rows_rect, (void **)&dst_buf, &dst_pitch);
+        convert_fb_cb(dst_buf, dst_pitch);
+        SDL_UnlockTexture(impl->disp_texture);
+    });
+}
 
-    SDL_UnlockTexture(impl->disp_texture);
-    SDL_RenderClear(impl->renderer);
-    SDL_RenderCopy(impl->renderer, impl->disp_texture, NULL, NULL);
+void Display::present(bool draw_hw_cursor, int cursor_x, int cursor_y) {
+    EventManager::get_instance()->call_on_host([&]() {
+        if (impl->resizing)
+            return;
 
-    // draw HW cursor if enabled
-    if (draw_hw_cursor) {
-        impl->cursor_rect.x = cursor_x;
-        impl->cursor_rect.y = cursor_y;
-        SDL_RenderCopy(impl->renderer, impl->cursor_texture, NULL, &impl->cursor_rect);
-    }
+        SDL_RenderClear(impl->renderer);
+        SDL_RenderCopy(impl->renderer, impl->disp_texture, NULL, NULL);
 
-    SDL_RenderPresent(impl->renderer);
+        // draw HW cursor if enabled
+        if (draw_hw_cursor) {
+            impl->cursor_rect.x = cursor_x;
+            impl->cursor_rect.y = cursor_y;
+            SDL_RenderCopy(impl->renderer, impl->cursor_texture, NULL, &impl->cursor_rect);
+        }
+
+        SDL_RenderPresent(impl->renderer);
+
+        impl->exposed = false;
+    });
+}
+
+bool Display::needs_present() {
+    // read directly so that an idle refresh doesn't wait for the host thread
+    return impl->exposed.load(std::memory_order_relaxed);
 }
 
 void Display::setup_hw_cursor(std::function<void(uint8_t *dst_buf, int dst_pitch)> draw_hw_cursor,
                               int cursor_width, int cursor_height) {
-    uint8_t*    dst_buf;
-    int         dst_pitch;
-
-    if (impl->cursor_texture)
-        SDL_DestroyTexture(impl->cursor_texture);
-
-    impl->cursor_texture = SDL_CreateTexture(
-        impl->renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        cursor_width, cursor_height
-    );
-
-    if (impl->cursor_texture == NULL)
-        ABORT_F("SDL_CreateTexture for HW cursor failed with %s", SDL_GetError());
-
-    SDL_LockTexture(impl->cursor_texture, NULL, (void **)&dst_buf, &dst_pitch);
-    SDL_SetTextureBlendMode(impl->cursor_texture, SDL_BLENDMODE_BLEND);
-    draw_hw_cursor(dst_buf, dst_pitch);
-    SDL_UnlockTexture(impl->cursor_texture);
-
-    impl->cursor_rect.x = 0;
-    impl->cursor_rect.y = 0;
-    impl->cursor_rect.w = cursor_width;
-    impl->cursor_rect.h = cursor_height;
+    EventManager::get_instance()->call_on_host([&]() {
+        uint8_t*    dst_buf;
+        int         dst_pitch;
+
+        if (impl->cursor_texture)
+            SDL_DestroyTexture(impl->cursor_texture);
+
+        impl->cursor_texture = SDL_CreateTexture(
+            impl->renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            cursor_width, cursor_height
+        );
+
+        if (impl->cursor_texture == NULL)
+            ABORT_F("SDL_CreateTexture for HW cursor failed with %s", SDL_GetError());
+
+        SDL_LockTexture(impl->cursor_texture, NULL, (void **)&dst_buf, &dst_pitch);
+        SDL_SetTextureBlendMode(impl->cursor_texture, SDL_BLENDMODE_BLEND);
+        draw_hw_cursor(dst_buf, dst_pitch);
+        SDL_UnlockTexture(impl->cursor_texture);
+
+        impl->cursor_rect.x = 0;
+        impl->cursor_rect.y = 0;
+        impl->cursor_rect.w = cursor_width;
+        impl->cursor_rect.h = cursor_height;
+    });
 }
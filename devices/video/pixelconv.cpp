@@ -0,0 +1,462 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Pixel row conversion kernels. */
+
+#include <devices/video/pixelconv.h>
+#include <memaccess.h>
+#include <loguru.hpp>
+
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_CONV_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && \
+      defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PIXEL_CONV_NEON
+#include <arm_neon.h>
+#endif
+
+//=========================== Scalar reference ===============================
+
+static void conv_indexed_8bpp(const uint8_t* src, uint8_t* dst, int width,
+                              const uint32_t* palette) {
+    for (int x = width; x > 0; x--) {
+        WRITE_DWORD_LE_A(dst, palette[*src++]);
+        dst += 4;
+    }
+}
+
+static void conv_rgb555(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = *((uint16_t*)(src));
+        uint32_t r = ((c << 9) & 0x00F80000) | ((c << 4) & 0x00070000);
+        uint32_t g = ((c << 6) & 0x0000F800) | ((c << 1) & 0x00000700);
+        uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
+        WRITE_DWORD_LE_A(dst, r | g | b);
+        src += 2;
+        dst += 4;
+    }
+}
+
+static void conv_rgb555_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = READ_WORD_BE_A(src);
+        uint32_t r = ((c << 9) & 0x00F80000) | ((c << 4) & 0x00070000);
+        uint32_t g = ((c << 6) & 0x0000F800) | ((c << 1) & 0x00000700);
+        uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
+        WRITE_DWORD_LE_A(dst, r | g | b);
+        src += 2;
+        dst += 4;
+    }
+}
+
+static void conv_rgb565(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = *((uint16_t*)(src));
+        uint32_t r = ((c << 8) & 0x00F80000) | ((c << 3) & 0x00070000);
+        uint32_t g = ((c << 5) & 0x0000FC00) | ((c >> 1) & 0x00000300);
+        uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
+        WRITE_DWORD_LE_A(dst, r | g | b);
+        src += 2;
+        dst += 4;
+    }
+}
+
+static void conv_rgb888(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = (src[0] << 16) | (src[1] << 8) | src[2];
+        WRITE_DWORD_LE_A(dst, c);
+        src += 3;
+        dst += 4;
+    }
+}
+
+static void conv_argb8888(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = READ_DWORD_LE_A(src);
+        WRITE_DWORD_LE_A(dst, c);
+        src += 4;
+        dst += 4;
+    }
+}
+
+static void conv_argb8888_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    for (int x = width; x > 0; x--) {
+        uint32_t c = READ_DWORD_BE_A(src);
+        WRITE_DWORD_LE_A(dst, c);
+        src += 4;
+        dst += 4;
+    }
+}
+
+const PixelConv pixel_conv_scalar = {
+    "scalar",
+    conv_indexed_8bpp,
+    conv_rgb555,
+    conv_rgb555_be,
+    conv_rgb565,
+    conv_rgb888,
+    conv_argb8888,
+    conv_argb8888_be
+};
+
+// The SIMD kernels below convert as many pixels as fit into their vectors
+// and leave the remaining ones to the scalar kernels.
+
+#ifdef PIXEL_CONV_X86
+
+//================================ SSE2 ======================================
+
+// Expand 5/6-bit components to 8 bits by replicating their upper bits.
+#define EXPAND5(v) _mm_or_si128(_mm_slli_epi16((v), 3), _mm_srli_epi16((v), 2))
+#define EXPAND6(v) _mm_or_si128(_mm_slli_epi16((v), 2), _mm_srli_epi16((v), 4))
+
+// Store eight pixels given as 16-bit R and G:B lanes.
+__attribute__((target("sse2")))
+static inline void sse2_store_rgb(uint8_t* dst, __m128i r, __m128i gb) {
+    _mm_storeu_si128((__m128i*)dst,        _mm_unpacklo_epi16(gb, r));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(gb, r));
+}
+
+__attribute__((target("sse2")))
+static inline void sse2_rgb555x8(__m128i c, uint8_t* dst) {
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+
+    __m128i r = EXPAND5(_mm_and_si128(_mm_srli_epi16(c, 10), mask5));
+    __m128i g = EXPAND5(_mm_and_si128(_mm_srli_epi16(c, 5), mask5));
+    __m128i b = EXPAND5(_mm_and_si128(c, mask5));
+
+    sse2_store_rgb(dst, r, _mm_or_si128(_mm_slli_epi16(g, 8), b));
+}
+
+__attribute__((target("sse2")))
+static void sse2_rgb555(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+        sse2_rgb555x8(_mm_loadu_si128((const __m128i*)(src + x * 2)), dst + x * 4);
+    conv_rgb555(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("sse2")))
+static void sse2_rgb555_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x * 2));
+        sse2_rgb555x8(_mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8)), dst + x * 4);
+    }
+    conv_rgb555_be(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("sse2")))
+static void sse2_rgb565(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x * 2));
+        __m128i r = EXPAND5(_mm_srli_epi16(c, 11));
+        __m128i g = EXPAND6(_mm_and_si128(_mm_srli_epi16(c, 5), mask6));
+        __m128i b = EXPAND5(_mm_and_si128(c, mask5));
+        sse2_store_rgb(dst + x * 4, r, _mm_or_si128(_mm_slli_epi16(g, 8), b));
+    }
+    conv_rgb565(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+static void sse2_argb8888(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    std::memcpy(dst, src, width * 4);
+}
+
+__attribute__((target("sse2")))
+static void sse2_argb8888_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        // swap bytes within words, then words within dwords
+        c = _mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8));
+        c = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, 0xB1), 0xB1);
+        _mm_storeu_si128((__m128i*)(dst + x * 4), c);
+    }
+    conv_argb8888_be(src + x * 4, dst + x * 4, width - x, palette);
+}
+
+static const PixelConv pixel_conv_sse2 = {
+    "SSE2",
+    conv_indexed_8bpp,
+    sse2_rgb555,
+    sse2_rgb555_be,
+    sse2_rgb565,
+    conv_rgb888,
+    sse2_argb8888,
+    sse2_argb8888_be
+};
+
+//================================ SSSE3 =====================================
+
+__attribute__((target("ssse3")))
+static void ssse3_rgb888(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m128i shuf = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+    // each 16-byte load consumes 12 bytes, stop before reading past the row
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x * 3));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(c, shuf));
+    }
+    conv_rgb888(src + x * 3, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("ssse3")))
+static void ssse3_argb8888_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m128i shuf = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(c, shuf));
+    }
+    conv_argb8888_be(src + x * 4, dst + x * 4, width - x, palette);
+}
+
+static const PixelConv pixel_conv_ssse3 = {
+    "SSSE3",
+    conv_indexed_8bpp,
+    sse2_rgb555,
+    sse2_rgb555_be,
+    sse2_rgb565,
+    ssse3_rgb888,
+    sse2_argb8888,
+    ssse3_argb8888_be
+};
+
+//================================ AVX2 ======================================
+
+#define EXPAND5_256(v) _mm256_or_si256(_mm256_slli_epi16((v), 3), _mm256_srli_epi16((v), 2))
+#define EXPAND6_256(v) _mm256_or_si256(_mm256_slli_epi16((v), 2), _mm256_srli_epi16((v), 4))
+
+// Store sixteen pixels given as 16-bit R and G:B lanes. Unpacking works
+// within 128-bit halves so the results need to be put back in order.
+__attribute__((target("avx2")))
+static inline void avx2_store_rgb(uint8_t* dst, __m256i r, __m256i gb) {
+    __m256i lo = _mm256_unpacklo_epi16(gb, r);
+    __m256i hi = _mm256_unpackhi_epi16(gb, r);
+    _mm256_storeu_si256((__m256i*)dst,        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+__attribute__((target("avx2")))
+static inline void avx2_rgb555x16(__m256i c, uint8_t* dst) {
+    const __m256i mask5 = _mm256_set1_epi16(0x1F);
+
+    __m256i r = EXPAND5_256(_mm256_and_si256(_mm256_srli_epi16(c, 10), mask5));
+    __m256i g = EXPAND5_256(_mm256_and_si256(_mm256_srli_epi16(c, 5), mask5));
+    __m256i b = EXPAND5_256(_mm256_and_si256(c, mask5));
+
+    avx2_store_rgb(dst, r, _mm256_or_si256(_mm256_slli_epi16(g, 8), b));
+}
+
+__attribute__((target("avx2")))
+static void avx2_indexed_8bpp(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+        _mm256_storeu_si256((__m256i*)(dst + x * 4),
+                            _mm256_i32gather_epi32((const int*)palette, idx, 4));
+    }
+    conv_indexed_8bpp(src + x, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("avx2")))
+static void avx2_rgb555(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+        avx2_rgb555x16(_mm256_loadu_si256((const __m256i*)(src + x * 2)), dst + x * 4);
+    sse2_rgb555(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("avx2")))
+static void avx2_rgb555_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m256i shuf = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + x * 2));
+        avx2_rgb555x16(_mm256_shuffle_epi8(c, shuf), dst + x * 4);
+    }
+    sse2_rgb555_be(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("avx2")))
+static void avx2_rgb565(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m256i mask5 = _mm256_set1_epi16(0x1F);
+    const __m256i mask6 = _mm256_set1_epi16(0x3F);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + x * 2));
+        __m256i r = EXPAND5_256(_mm256_srli_epi16(c, 11));
+        __m256i g = EXPAND6_256(_mm256_and_si256(_mm256_srli_epi16(c, 5), mask6));
+        __m256i b = EXPAND5_256(_mm256_and_si256(c, mask5));
+        avx2_store_rgb(dst + x * 4, r, _mm256_or_si256(_mm256_slli_epi16(g, 8), b));
+    }
+    sse2_rgb565(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+__attribute__((target("avx2")))
+static void avx2_argb8888_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    const __m256i shuf = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+        _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_shuffle_epi8(c, shuf));
+    }
+    ssse3_argb8888_be(src + x * 4, dst + x * 4, width - x, palette);
+}
+
+static const PixelConv pixel_conv_avx2 = {
+    "AVX2",
+    avx2_indexed_8bpp,
+    avx2_rgb555,
+    avx2_rgb555_be,
+    avx2_rgb565,
+    ssse3_rgb888,
+    sse2_argb8888,
+    avx2_argb8888_be
+};
+
+#endif // PIXEL_CONV_X86
+
+#ifdef PIXEL_CONV_NEON
+
+//================================ NEON ======================================
+
+static inline void neon_store_rgb(uint8_t* dst, uint16x8_t r, uint16x8_t g, uint16x8_t b) {
+    uint8x8x4_t px = {{vmovn_u16(b), vmovn_u16(g), vmovn_u16(r), vdup_n_u8(0)}};
+    vst4_u8(dst, px);
+}
+
+static inline void neon_rgb555x8(uint16x8_t c, uint8_t* dst) {
+    const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+
+    uint16x8_t r = vandq_u16(vshrq_n_u16(c, 10), mask5);
+    uint16x8_t g = vandq_u16(vshrq_n_u16(c, 5), mask5);
+    uint16x8_t b = vandq_u16(c, mask5);
+
+    neon_store_rgb(dst, vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)),
+                        vorrq_u16(vshlq_n_u16(g, 3), vshrq_n_u16(g, 2)),
+                        vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+}
+
+static void neon_rgb555(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+        neon_rgb555x8(vld1q_u16((const uint16_t*)(src + x * 2)), dst + x * 4);
+    conv_rgb555(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+static void neon_rgb555_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+        neon_rgb555x8(vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + x * 2))), dst + x * 4);
+    conv_rgb555_be(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+static void neon_rgb565(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t c = vld1q_u16((const uint16_t*)(src + x * 2));
+        uint16x8_t r = vshrq_n_u16(c, 11);
+        uint16x8_t g = vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x3F));
+        uint16x8_t b = vandq_u16(c, vdupq_n_u16(0x1F));
+        neon_store_rgb(dst + x * 4, vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)),
+                                    vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4)),
+                                    vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+    }
+    conv_rgb565(src + x * 2, dst + x * 4, width - x, palette);
+}
+
+static void neon_rgb888(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint8x8x3_t c = vld3_u8(src + x * 3);
+        uint8x8x4_t px = {{c.val[2], c.val[1], c.val[0], vdup_n_u8(0)}};
+        vst4_u8(dst + x * 4, px);
+    }
+    conv_rgb888(src + x * 3, dst + x * 4, width - x, palette);
+}
+
+static void neon_argb8888(const uint8_t* src, uint8_t* dst, int width, const uint32_t*) {
+    std::memcpy(dst, src, width * 4);
+}
+
+static void neon_argb8888_be(const uint8_t* src, uint8_t* dst, int width, const uint32_t* palette) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+        vst1q_u8(dst + x * 4, vrev32q_u8(vld1q_u8(src + x * 4)));
+    conv_argb8888_be(src + x * 4, dst + x * 4, width - x, palette);
+}
+
+static const PixelConv pixel_conv_neon = {
+    "NEON",
+    conv_indexed_8bpp,
+    neon_rgb555,
+    neon_rgb555_be,
+    neon_rgb565,
+    neon_rgb888,
+    neon_argb8888,
+    neon_argb8888_be
+};
+
+#endif // PIXEL_CONV_NEON
+
+std::vector<const PixelConv*> get_supported_pixel_convs() {
+    std::vector<const PixelConv*> convs = {&pixel_conv_scalar};
+
+#ifdef PIXEL_CONV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        convs.push_back(&pixel_conv_sse2);
+    if (__builtin_cpu_supports("ssse3"))
+        convs.push_back(&pixel_conv_ssse3);
+    if (__builtin_cpu_supports("avx2"))
+        convs.push_back(&pixel_conv_avx2);
+#endif
+#ifdef PIXEL_CONV_NEON
+    convs.push_back(&pixel_conv_neon);
+#endif
+
+    return convs;
+}
+
+const PixelConv* get_pixel_conv() {
+    static const PixelConv* best_conv = [] {
+        const PixelConv* conv = get_supported_pixel_convs().back();
+        LOG_F(INFO, "Using %s pixel conversion", conv->name);
+        return conv;
+    }();
+
+    return best_conv;
+}
@@ -0,0 +1,59 @@
+/*
+DingusPPC - The Experimental PowerPC Macintosh emulator
+Copyright (C) 2018-23 divingkatae and maximum
+                      (theweirdo)     spatium
+
+(Contact divingkatae#1017 or powermax#2286 on Discord for more info)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/** @file Pixel row conversion kernels.
+
+    Each kernel converts one row of framebuffer pixels to ARGB8888 stored
+    in little-endian order, the format of the display texture. The scalar
+    kernels are the reference, SIMD variants must produce identical output.
+    The fastest set supported by the host CPU is selected at runtime.
+ */
+
+#ifndef PIXEL_CONV_H
+#define PIXEL_CONV_H
+
+#include <cinttypes>
+#include <vector>
+
+typedef void (*PixelRowConv)(const uint8_t* src, uint8_t* dst, int width,
+                             const uint32_t* palette);
+
+typedef struct PixelConv {
+    const char*  name;
+    PixelRowConv indexed_8bpp;  // palette lookup
+    PixelRowConv rgb555;        // host order
+    PixelRowConv rgb555_be;
+    PixelRowConv rgb565;        // host order
+    PixelRowConv rgb888;
+    PixelRowConv argb8888;      // little-endian
+    PixelRowConv argb8888_be;
+} PixelConv;
+
+// scalar reference kernels
+extern const PixelConv pixel_conv_scalar;
+
+// Returns the kernel set best suited to the host CPU.
+extern const PixelConv* get_pixel_conv();
+
+// Returns all kernel sets the host CPU can run, scalar first.
+extern std::vector<const PixelConv*> get_supported_pixel_convs();
+
+#endif // PIXEL_CONV_H
@@ -22,10 +22,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 /** @file Video Controller base class implementation. */
 
 #include <core/timermanager.h>
+#include <cpu/ppc/ppcemu.h>
 #include <devices/common/hwinterrupt.h>
+#include <devices/memctrl/memctrlbase.h>
 #include <devices/video/videoctrl.h>
 #include <memaccess.h>
 
+#include <algorithm>
 #include <cinttypes>
 
 VideoCtrlBase::VideoCtrlBase(int width, int height)
@@ -55,6 +58,7 @@ void VideoCtrlBase::create_display_window(int width, int height)
 
     this->active_width  = width;
     this->active_height = height;
+    this->draw_fb       = true;
 }
 
 void VideoCtrlBase::blank_display() {
@@ -65,6 +69,7 @@ void VideoCtrlBase::update_screen()
 {
     if (this->blank_on) {
         this->display.blank();
+        this->draw_fb = true;
         return;
     }
 
@@ -74,19 +79,116 @@ void VideoCtrlBase::update_screen()
         this->get_cursor_position(cursor_x, cursor_y);
     }
 
-    if (draw_fb) {
-        if (this->cursor_dirty) {
-            this->setup_hw_cursor();
-            this->cursor_dirty = false;
-        }
+    if (this->cursor_dirty) {
+        this->setup_hw_cursor();
+        this->cursor_dirty = false;
+    }
+
+    // software cursors are drawn into the converted frame so moving
+    // one requires converting the whole frame again
+    bool redraw_all = this->draw_fb || this->cursor_ovl_cb != nullptr ||
+        this->fb_ptr != this->drawn_fb_ptr || this->fb_pitch != this->drawn_fb_pitch ||
+        this->active_width != this->drawn_width || this->active_height != this->drawn_height;
+
+    // fetch the framebuffer pages written since the last refresh,
+    // untracked framebuffers are converted in full every time
+    const uint8_t* fb_page = mem_ctrl_instance ?
+        mem_ctrl_instance->get_dirty_page_start(this->fb_ptr) : nullptr;
+    const uint8_t* fb_end  = this->fb_ptr + this->fb_pitch * this->active_height;
+
+    if (!fb_page || this->fb_pitch <= 0 || !mem_ctrl_instance->harvest_dirty_pages(
+            fb_page, uint32_t(fb_end - fb_page), this->dirty_pages))
+        redraw_all = true;
+
+    if (redraw_all) {
         this->display.update(
             this->convert_fb_cb, this->cursor_ovl_cb,
             this->cursor_on, cursor_x, cursor_y);
+
+        this->draw_fb        = false;
+        this->drawn_fb_ptr   = this->fb_ptr;
+        this->drawn_fb_pitch = this->fb_pitch;
+        this->drawn_width    = this->active_width;
+        this->drawn_height   = this->active_height;
+    } else if (this->update_dirty_rows(fb_page) || this->present_pending ||
+               this->display.needs_present() || this->cursor_on != this->drawn_cursor_on ||
+               (this->cursor_on && (cursor_x != this->drawn_cursor_x ||
+                                    cursor_y != this->drawn_cursor_y))) {
+        this->display.present(this->cursor_on, cursor_x, cursor_y);
+    }
+
+    this->present_pending = false;
+    this->drawn_cursor_on = this->cursor_on;
+    this->drawn_cursor_x  = cursor_x;
+    this->drawn_cursor_y  = cursor_y;
+}
+
+// Convert the rows touched by dirty framebuffer pages, fb_page being
+// the start of the page holding the first framebuffer byte.
+// Returns true if any rows were converted.
+bool VideoCtrlBase::update_dirty_rows(const uint8_t* fb_page) {
+    const int page_size = 1 << DIRTY_PAGE_BITS;
+    const int num_pages = int(this->dirty_pages.size() * 64);
+
+    int first_row = -1;
+    int last_row  = -1;
+    bool updated  = false;
+
+    for (int page = 0; page < num_pages; page++) {
+        if (!this->dirty_pages[page >> 6]) {
+            page |= 63;
+            continue;
+        }
+        if (!((this->dirty_pages[page >> 6] >> (page & 63)) & 1))
+            continue;
+
+        // rows overlapping this page
+        ptrdiff_t start = std::max<ptrdiff_t>(fb_page + page * page_size - this->fb_ptr, 0);
+        ptrdiff_t end   = fb_page + (page + 1) * page_size - this->fb_ptr;
+        int row_first   = int(start / this->fb_pitch);
+        int row_last    = std::min(int((end - 1) / this->fb_pitch), this->active_height - 1);
+
+        if (row_first > row_last)
+            break;
+
+        // merge adjacent pages into one band of rows
+        if (first_row >= 0 && row_first <= last_row + 1) {
+            last_row = std::max(last_row, row_last);
+            continue;
+        }
+        if (first_row >= 0) {
+            this->convert_rows(first_row, last_row);
+            updated = true;
+        }
+        first_row = row_first;
+        last_row  = row_last;
+    }
+
+    if (first_row >= 0) {
+        this->convert_rows(first_row, last_row);
+        updated = true;
     }
+
+    return updated;
+}
+
+void VideoCtrlBase::convert_rows(int first_row, int last_row) {
+    uint8_t* fb_start = this->fb_ptr;
+    int      height   = this->active_height;
+
+    // frame converters process active_height rows starting at fb_ptr
+    this->fb_ptr        = fb_start + first_row * this->fb_pitch;
+    this->active_height = last_row - first_row + 1;
+
+    this->display.update_rows(this->convert_fb_cb, first_row, this->active_height);
+
+    this->fb_ptr        = fb_start;
+    this->active_height = height;
 }
 
 void VideoCtrlBase::start_refresh_task() {
     this->display.configure(this->active_width, this->active_height);
+    this->draw_fb = true;
 
     uint64_t refresh_interval = static_cast<uint64_t>(1.0f / refresh_rate * NS_PER_SEC + 0.5);
     this->refresh_task_id = TimerManager::get_instance()->add_cyclic_timer(
@@ -137,6 +239,7 @@ void VideoCtrlBase::get_palette_color(uint8_t index, uint8_t& r, uint8_t& g,
 void VideoCtrlBase::set_palette_color(uint8_t index, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
     this->palette[index] = (a << 24) | (r << 16) | (g << 8) | b;
+    this->draw_fb = true;
 }
 
 void VideoCtrlBase::setup_hw_cursor(int cursor_width, int cursor_height)
@@ -147,6 +250,7 @@ void VideoCtrlBase::setup_hw_cursor(int cursor_width, int cursor_height)
         },
         cursor_width, cursor_height);
     this->cursor_on = true;
+    this->present_pending = true;
 }
 
 void VideoCtrlBase::convert_frame_1bpp_indexed(uint8_t *dst_buf, int dst_pitch)
@@ -233,20 +337,12 @@ void VideoCtrlBase::convert_frame_4bpp_indexed(uint8_t *dst_buf, int dst_pitch)
 
 void VideoCtrlBase::convert_frame_8bpp_indexed(uint8_t *dst_buf, int dst_pitch)
 {
-    uint8_t *src_row, *dst_row;
-    int     src_pitch;
-
-    src_pitch = this->fb_pitch - this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_row = this->fb_ptr;
-    dst_row = dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            WRITE_DWORD_LE_A(dst_row, this->palette[*src_row++]);
-            dst_row += 4;
-        }
-        src_row += src_pitch;
+        this->pixel_conv->indexed_8bpp(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
         dst_row += dst_pitch;
     }
 }
@@ -307,25 +403,12 @@ void VideoCtrlBase::convert_frame_8bpp(uint8_t *dst_buf, int dst_pitch)
 // RGB555
 void VideoCtrlBase::convert_frame_15bpp(uint8_t *dst_buf, int dst_pitch)
 {
-    uint8_t *src_row, *dst_row;
-    int     src_pitch;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_pitch = this->fb_pitch - 2 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
-
-    src_row = this->fb_ptr;
-    dst_row = dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = *((uint16_t*)(src_row));
-            uint32_t r = ((c << 9) & 0x00F80000) | ((c << 4) & 0x00070000);
-            uint32_t g = ((c << 6) & 0x0000F800) | ((c << 1) & 0x00000700);
-            uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
-            WRITE_DWORD_LE_A(dst_row, r | g | b);
-            src_row += 2;
-            dst_row += 4;
-        }
-        src_row += src_pitch;
+        this->pixel_conv->rgb555(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
         dst_row += dst_pitch;
     }
 }
@@ -333,25 +416,12 @@ void VideoCtrlBase::convert_frame_15bpp(uint8_t *dst_buf, int dst_pitch)
 // RGB555_BE
 void VideoCtrlBase::convert_frame_15bpp_BE(uint8_t *dst_buf, int dst_pitch)
 {
-    uint8_t *src_row, *dst_row;
-    int     src_pitch;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_pitch = this->fb_pitch - 2 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
-
-    src_row = this->fb_ptr;
-    dst_row = dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = READ_WORD_BE_A(src_row);
-            uint32_t r = ((c << 9) & 0x00F80000) | ((c << 4) & 0x00070000);
-            uint32_t g = ((c << 6) & 0x0000F800) | ((c << 1) & 0x00000700);
-            uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
-            WRITE_DWORD_LE_A(dst_row, r | g | b);
-            src_row += 2;
-            dst_row += 4;
-        }
-        src_row += src_pitch;
+        this->pixel_conv->rgb555_be(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
         dst_row += dst_pitch;
     }
 }
@@ -359,25 +429,12 @@ void VideoCtrlBase::convert_frame_15bpp_BE(uint8_t *dst_buf, int dst_pitch)
 // RGB565
 void VideoCtrlBase::convert_frame_16bpp(uint8_t *dst_buf, int dst_pitch)
 {
-    uint8_t *src_row, *dst_row;
-    int     src_pitch;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_pitch = this->fb_pitch - 2 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
-
-    src_row = this->fb_ptr;
-    dst_row = dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = *((uint16_t*)(src_row));
-            uint32_t r = ((c << 8) & 0x00F80000) | ((c << 3) & 0x00070000);
-            uint32_t g = ((c << 5) & 0x0000FC00) | ((c >> 1) & 0x00000300);
-            uint32_t b = ((c << 3) & 0x000000F8) | ((c >> 2) & 0x00000007);
-            WRITE_DWORD_LE_A(dst_row, r | g | b);
-            src_row += 2;
-            dst_row += 4;
-        }
-        src_row += src_pitch;
+        this->pixel_conv->rgb565(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
         dst_row += dst_pitch;
     }
 }
@@ -385,22 +442,12 @@ void VideoCtrlBase::convert_frame_16bpp(uint8_t *dst_buf, int dst_pitch)
 // RGB888
 void VideoCtrlBase::convert_frame_24bpp(uint8_t *dst_buf, int dst_pitch)
 {
-    uint8_t *src_row, *dst_row;
-    int     src_pitch;
-
-    src_pitch = this->fb_pitch - 3 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_row = this->fb_ptr;
-    dst_row = dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = (src_row[0] << 16) | (src_row[1] << 8) | src_row[2];
-            WRITE_DWORD_LE_A(dst_row, c);
-            src_row += 3;
-            dst_row += 4;
-        }
-        src_row += src_pitch;
+        this->pixel_conv->rgb888(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
         dst_row += dst_pitch;
     }
 }
@@ -408,45 +455,25 @@ void VideoCtrlBase::convert_frame_24bpp(uint8_t *dst_buf, int dst_pitch)
 // ARGB8888
 void VideoCtrlBase::convert_frame_32bpp(uint8_t *dst_buf, int dst_pitch)
 {
-    uint32_t *src_row, *dst_row;
-    int     src_pitch;
-
-    src_pitch = this->fb_pitch - 4 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_row = (uint32_t*)this->fb_ptr;
-    dst_row = (uint32_t*)dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = READ_DWORD_LE_A(src_row);
-            WRITE_DWORD_LE_A(dst_row, c);
-            src_row++;
-            dst_row++;
-        }
-        src_row = (uint32_t*)((uint8_t*)src_row + src_pitch);
-        dst_row = (uint32_t*)((uint8_t*)dst_row + dst_pitch);
+        this->pixel_conv->argb8888(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
+        dst_row += dst_pitch;
     }
 }
 
 // ARGB8888_BE
 void VideoCtrlBase::convert_frame_32bpp_BE(uint8_t *dst_buf, int dst_pitch)
 {
-    uint32_t *src_row, *dst_row;
-    int     src_pitch;
-
-    src_pitch = this->fb_pitch - 4 * this->active_width;
-    dst_pitch = dst_pitch - 4 * this->active_width;
+    uint8_t *src_row = this->fb_ptr;
+    uint8_t *dst_row = dst_buf;
 
-    src_row = (uint32_t*)this->fb_ptr;
-    dst_row = (uint32_t*)dst_buf;
     for (int h = this->active_height; h > 0; h--) {
-        for (int x = this->active_width; x > 0; x--) {
-            uint32_t c = READ_DWORD_BE_A(src_row);
-            WRITE_DWORD_LE_A(dst_row, c);
-            src_row++;
-            dst_row++;
-        }
-        src_row = (uint32_t*)((uint8_t*)src_row + src_pitch);
-        dst_row = (uint32_t*)((uint8_t*)dst_row + dst_pitch);
+        this->pixel_conv->argb8888_be(src_row, dst_row, this->active_width, this->palette);
+        src_row += this->fb_pitch;
+        dst_row += dst_pitch;
     }
 }
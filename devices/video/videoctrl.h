@@ -26,9 +26,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <devices/common/hwinterrupt.h>
 #include <devices/video/display.h>
+#include <devices/video/pixelconv.h>
 
 #include <cinttypes>
 #include <functional>
+#include <vector>
 
 class WindowEvent;
 
@@ -86,10 +88,12 @@ protected:
     int         pixel_format;
     float       pixel_clock;
     float       refresh_rate;
-    bool        draw_fb = true;
+    bool        draw_fb = true; // convert the whole frame on the next refresh
 
     uint32_t    palette[256]; // internal DAC palette in RGBA format
 
+    const PixelConv* pixel_conv = get_pixel_conv(); // row conversion kernels
+
     // Framebuffer parameters
     uint8_t*    fb_ptr = nullptr;
     int         fb_pitch = 0;
@@ -108,7 +112,22 @@ protected:
     std::function<void(uint8_t *dst_buf, int dst_pitch)> cursor_ovl_cb = nullptr;
 
 private:
+    bool update_dirty_rows(const uint8_t* fb_page);
+    void convert_rows(int first_row, int last_row);
+
     Display display;
+
+    // state of the last presented frame
+    uint8_t*    drawn_fb_ptr = nullptr;
+    int         drawn_fb_pitch = 0;
+    int         drawn_width = 0;
+    int         drawn_height = 0;
+    bool        drawn_cursor_on = false;
+    int         drawn_cursor_x = 0;
+    int         drawn_cursor_y = 0;
+    bool        present_pending = false;
+
+    std::vector<uint64_t> dirty_pages;
 };
 
 #endif // VIDEO_CTRL_H
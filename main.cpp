@@ -41,8 +41,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 using namespace std;
 
 void sigint_handler(int signum) {
-    power_on = false;
     power_off_reason = po_signal_interrupt;
+    power_on.store(false, std::memory_order_release);
 }
 
 void sigabrt_handler(int signum) {
@@ -61,7 +61,8 @@ static string appDescription = string(
     "\n"
 );
 
-void run_machine(std::string machine_str, std::string bootrom_path, uint32_t execution_mode);
+void run_machine(std::string machine_str, std::string bootrom_path, uint32_t execution_mode,
+                 bool realtime, bool adaptive);
 
 int main(int argc, char** argv) {
 
@@ -71,16 +72,30 @@ int main(int argc, char** argv) {
     app.allow_windows_style_options(); /* we want Windows-style options */
     app.allow_extras();
 
-    bool   realtime_enabled, debugger_enabled;
+    bool   realtime_enabled, adaptive_enabled, debugger_enabled, threaded_enabled, jit_enabled;
+    uint32_t max_latency_us = PPC_DEF_MAX_LATENCY_NS / 1000;
     string machine_str;
     string bootrom_path("bootrom.bin");
 
     app.add_flag("-r,--realtime", realtime_enabled,
         "Run the emulator in real-time");
 
+    app.add_flag("--adaptive", adaptive_enabled,
+        "Scale virtual time to the measured host speed");
+
+    app.add_option("--max-latency", max_latency_us,
+        "Max time between event checks in adaptive mode, in microseconds")
+        ->check(CLI::Range(10, 100000));
+
     app.add_flag("-d,--debugger", debugger_enabled,
         "Enter the built-in debugger");
 
+    app.add_flag("-t,--threaded", threaded_enabled,
+        "Use the threaded interpreter");
+
+    app.add_flag("-j,--jit", jit_enabled,
+        "Use the dynamic recompiler");
+
     app.add_option("-b,--bootrom", bootrom_path, "Specifies BootROM path")
         ->check(CLI::ExistingFile);
 
@@ -112,14 +127,23 @@ int main(int argc, char** argv) {
         if (realtime_enabled)
             cout << "Both realtime and debugger enabled! Using debugger" << endl;
         execution_mode = 1;
+    } else if (jit_enabled) {
+        execution_mode = jit;
+    } else if (threaded_enabled) {
+        execution_mode = threaded_int;
     }
 
+    if (realtime_enabled && adaptive_enabled)
+        cout << "Both realtime and adaptive timing enabled! Using realtime" << endl;
+
+    g_max_latency_ns = USECS_TO_NSECS(max_latency_us);
+
     /* initialize logging */
     loguru::g_preamble_date    = false;
     loguru::g_preamble_time    = false;
     loguru::g_preamble_thread  = false;
 
-    if (!execution_mode) {
+    if (execution_mode != debugger) {
         loguru::g_stderr_verbosity = loguru::Verbosity_OFF;
         loguru::init(argc, argv);
         loguru::add_file("dingusppc.log", loguru::Append, 0);
@@ -187,7 +211,9 @@ int main(int argc, char** argv) {
     signal(SIGABRT, sigabrt_handler);
 
     while (true) {
-        run_machine(machine_str, bootrom_path, execution_mode);
+        run_machine(machine_str, bootrom_path, execution_mode,
+                    realtime_enabled && execution_mode != debugger,
+                    adaptive_enabled && !realtime_enabled && execution_mode != debugger);
         if (power_off_reason == po_restarting) {
             LOG_F(INFO, "Restarting...");
             power_on = true;
@@ -201,33 +227,54 @@ int main(int argc, char** argv) {
     return 0;
 }
 
-void run_machine(std::string machine_str, std::string bootrom_path, uint32_t execution_mode) {
+void run_machine(std::string machine_str, std::string bootrom_path, uint32_t execution_mode,
+                 bool realtime, bool adaptive) {
     if (MachineFactory::create_machine_for_id(machine_str, bootrom_path) < 0) {
         return;
     }
 
-    // set up system wide event polling using
+    // let virtual time follow the host clock
+    g_realtime = realtime;
+    g_adaptive = adaptive;
+
+    // deliver host input to the emulated devices using
     // default Macintosh polling rate of 11 ms
     uint32_t event_timer = TimerManager::get_instance()->add_cyclic_timer(MSECS_TO_NSECS(11), [] {
-        EventManager::get_instance()->poll_events();
+        EventManager::get_instance()->deliver_input();
     });
 
     switch (execution_mode) {
     case interpreter:
         power_off_reason = po_starting_up;
-        enter_debugger();
+        break;
+    case threaded_int:
+        exec_mode = threaded_int;
+        power_off_reason = po_starting_up;
+        break;
+    case jit:
+        exec_mode = jit;
+        power_off_reason = po_starting_up;
         break;
     case debugger:
         power_off_reason = po_enter_debugger;
-        enter_debugger();
         break;
     default:
         LOG_F(ERROR, "Invalid EXECUTION MODE");
         return;
     }
 
+    // the emulated CPU runs on its own thread, this one keeps
+    // pumping host events and drawing the display windows
+    EventManager::get_instance()->run_host_loop([] {
+        enter_debugger();
+    });
+
     LOG_F(INFO, "Cleaning up...");
     TimerManager::get_instance()->cancel_timer(event_timer);
     EventManager::get_instance()->disconnect_handlers();
     delete gMachineObj.release();
+
+    // posted callbacks refer to the devices just freed, drop them
+    // now that the audio stream is stopped
+    TimerManager::get_instance()->discard_posted_events();
 }